@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+#
+# Compare two JSON result files written by openscad-bench and report
+# benchmarks whose median time changed by more than a threshold.
+#
+# Usage: bench-compare.py [--threshold PERCENT] baseline.json candidate.json
+#
+# Exits with status 1 if any benchmark got slower than the threshold.
+
+import argparse
+import json
+import sys
+
+
+def load(filename):
+    with open(filename) as f:
+        data = json.load(f)
+    return {b['name']: b for b in data['benchmarks']}
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare openscad-bench results.')
+    parser.add_argument('--threshold', type=float, default=10.0,
+                        help='Relative change in percent to report (default: 10)')
+    parser.add_argument('baseline')
+    parser.add_argument('candidate')
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    candidate = load(args.candidate)
+
+    regressions = 0
+    print(f"{'benchmark':50} {'baseline ms':>12} {'candidate ms':>12} {'change':>8}")
+    for name in sorted(set(baseline) | set(candidate)):
+        old = baseline.get(name, {})
+        new = candidate.get(name, {})
+        if 'median_ms' not in old or 'median_ms' not in new:
+            status = new.get('error') or old.get('error') or ('new' if not old else 'removed')
+            print(f"{name:50} {'':>12} {'':>12} {status}")
+            continue
+        change = (new['median_ms'] - old['median_ms']) / old['median_ms'] * 100 if old['median_ms'] else 0
+        marker = ''
+        if change > args.threshold:
+            marker = '  SLOWER'
+            regressions += 1
+        elif change < -args.threshold:
+            marker = '  faster'
+        print(f"{name:50} {old['median_ms']:12.3f} {new['median_ms']:12.3f} {change:+7.1f}%{marker}")
+
+    if regressions:
+        print(f"\n{regressions} benchmark(s) slower by more than {args.threshold}%")
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -45,6 +45,7 @@
 #pragma once
 
 #include <cstddef>
+#include <limits>
 #include <unordered_map>
 #include "utils/printutils.h"
 
@@ -52,13 +53,21 @@ template <class Key, class T>
 class Cache
 {
   struct Node {
-    inline Node() : keyPtr(nullptr), t(nullptr), c(0), p(nullptr), n(nullptr) {}
-    inline Node(T *data, size_t cost) : keyPtr(nullptr), t(data), c(cost), p(nullptr), n(nullptr) {}
+    inline Node() : keyPtr(nullptr), t(nullptr), c(0), w(0), p(nullptr), n(nullptr) {}
+    inline Node(T *data, size_t cost, double weight)
+      : keyPtr(nullptr), t(data), c(cost), w(weight), p(nullptr), n(nullptr)
+    {
+    }
     const Key *keyPtr;
     T *t;
     size_t c;
+    // Estimated recompute time; entries cheap to recompute per byte are evicted first
+    double w;
     Node *p, *n;
   };
+
+  // Number of least recently used entries considered as eviction candidates
+  static constexpr int EVICTION_CANDIDATES = 8;
   using map_type = typename std::unordered_map<Key, Node>;
   using iterator_type = typename map_type::iterator;
   using value_type = typename map_type::value_type;
@@ -79,6 +88,20 @@ class Cache
     hash.erase(*n.keyPtr);
     delete obj;
   }
+  static inline double score(const Node& n) { return n.w / static_cast<double>(n.c + 1); }
+
+  // Picks the entry cheapest to recompute per byte among the least recently used ones.
+  // With no weights given, this is the least recently used entry.
+  inline Node *victim() const
+  {
+    Node *best = nullptr;
+    int candidates = 0;
+    for (Node *n = l; n && candidates < EVICTION_CANDIDATES; n = n->p, ++candidates) {
+      if (!best || score(*n) < score(*best)) best = n;
+    }
+    return best;
+  }
+
   inline T *relink(const Key& key)
   {
     auto i = hash.find(key);
@@ -123,7 +146,7 @@ public:
     total = 0;
   }
 
-  bool insert(const Key& key, T *object, size_t cost);
+  bool insert(const Key& key, T *object, size_t cost, double weight = 0);
   T *object(const Key& key) const { return const_cast<Cache<Key, T> *>(this)->relink(key); }
   inline bool contains(const Key& key) const { return hash.find(key) != hash.end(); }
   T *operator[](const Key& key) const { return object(key); }
@@ -131,6 +154,25 @@ public:
   bool remove(const Key& key);
   T *take(const Key& key);
 
+  /*!
+     Recompute cost per byte of the entry evictOne() would remove, infinity if empty.
+   */
+  [[nodiscard]] double evictionScore() const
+  {
+    const Node *n = victim();
+    return n ? score(*n) : std::numeric_limits<double>::infinity();
+  }
+  /*!
+     Evicts one entry, returns false if the cache is empty.
+   */
+  bool evictOne()
+  {
+    Node *n = victim();
+    if (!n) return false;
+    unlink(*n);
+    return true;
+  }
+
 private:
   void trim(size_t m);
 };
@@ -161,7 +203,7 @@ inline T *Cache<Key, T>::take(const Key& key)
 }
 
 template <class Key, class T>
-bool Cache<Key, T>::insert(const Key& akey, T *aobject, size_t acost)
+bool Cache<Key, T>::insert(const Key& akey, T *aobject, size_t acost, double aweight)
 {
   remove(akey);
   if (acost > mx) {
@@ -169,7 +211,7 @@ bool Cache<Key, T>::insert(const Key& akey, T *aobject, size_t acost)
     return false;
   }
   trim(mx - acost);
-  Node node(aobject, acost);
+  Node node(aobject, acost, aweight);
   hash[akey] = node;
   auto i = hash.find(akey);
   total += acost;
@@ -185,10 +227,8 @@ bool Cache<Key, T>::insert(const Key& akey, T *aobject, size_t acost)
 template <class Key, class T>
 void Cache<Key, T>::trim(size_t m)
 {
-  Node *n = l;
-  while (n && total > m) {
-    Node *u = n;
-    n = n->p;
+  while (l && total > m) {
+    Node *u = victim();
 #ifdef DEBUG
     LOG("Trimming cache: %1$s (%2$d bytes)", u->keyPtr->substr(0, 40), u->c);
 #endif
@@ -0,0 +1,121 @@
+#include "CacheManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include "platform/PlatformUtils.h"
+
+namespace {
+
+// Available system memory is sampled at most this often
+constexpr auto PRESSURE_CHECK_INTERVAL = std::chrono::milliseconds(500);
+// Memory we try to leave to the rest of the system before shrinking the caches
+constexpr uint64_t MIN_FREE_MEMORY = 256ul * 1024ul * 1024ul;
+// Caches are never squeezed below this, otherwise evaluation degenerates to recomputing everything
+constexpr size_t MIN_BUDGET = 16ul * 1024ul * 1024ul;
+
+}  // namespace
+
+CacheManager *CacheManager::instance()
+{
+  static CacheManager inst;
+  return &inst;
+}
+
+void CacheManager::registerCache(ManagedCache *cache)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+  this->caches.push_back(cache);
+}
+
+void CacheManager::unregisterCache(ManagedCache *cache)
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+  this->caches.erase(std::remove(this->caches.begin(), this->caches.end(), cache), this->caches.end());
+}
+
+void CacheManager::setBudgetMB(size_t limit)
+{
+  this->budgetBytes = limit * 1024ul * 1024ul;
+  enforceBudget();
+}
+
+size_t CacheManager::totalCostLocked() const
+{
+  size_t total = 0;
+  for (const auto *cache : this->caches) total += cache->totalCost();
+  return total;
+}
+
+size_t CacheManager::totalCost() const
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+  return totalCostLocked();
+}
+
+size_t CacheManager::effectiveBudgetLocked(size_t total)
+{
+  const auto now = std::chrono::steady_clock::now();
+  if (now - this->lastPressureCheck >= PRESSURE_CHECK_INTERVAL) {
+    this->lastPressureCheck = now;
+    const uint64_t available = PlatformUtils::availableMemory();
+    if (available == 0) {
+      this->pressureLimit = std::numeric_limits<size_t>::max();
+    } else {
+      // Cached bytes would become available again when evicted
+      const uint64_t reclaimable = available + total;
+      this->pressureLimit =
+        reclaimable > MIN_FREE_MEMORY + MIN_BUDGET ? reclaimable - MIN_FREE_MEMORY : MIN_BUDGET;
+    }
+  }
+  return std::min<size_t>(this->budgetBytes, this->pressureLimit);
+}
+
+size_t CacheManager::effectiveBudget()
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+  return effectiveBudgetLocked(totalCostLocked());
+}
+
+void CacheManager::enforceBudget()
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+  auto total = totalCostLocked();
+  const auto limit = effectiveBudgetLocked(total);
+  while (total > limit) {
+    ManagedCache *victim = nullptr;
+    double best = std::numeric_limits<double>::infinity();
+    for (auto *cache : this->caches) {
+      if (cache->size() == 0) continue;
+      const auto score = cache->evictionScore();
+      if (!victim || score < best) {
+        victim = cache;
+        best = score;
+      }
+    }
+    if (!victim || !victim->evictOne()) break;
+    total = totalCostLocked();
+  }
+}
+
+void CacheManager::clear()
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+  for (auto *cache : this->caches) cache->clear();
+}
+
+std::vector<CacheOccupancy> CacheManager::occupancy() const
+{
+  const std::lock_guard<std::mutex> lock(this->mutex);
+  std::vector<CacheOccupancy> result;
+  for (const auto *cache : this->caches) {
+    result.push_back(
+      {cache->name(), cache->size(), cache->totalCost(), cache->maxCost(), cache->evictions()});
+  }
+  return result;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*!
+   Interface of a cache whose memory is accounted against the global budget
+   of the CacheManager.
+ */
+class ManagedCache
+{
+public:
+  virtual ~ManagedCache() = default;
+
+  [[nodiscard]] virtual const std::string& name() const = 0;
+  [[nodiscard]] virtual size_t size() const = 0;
+  [[nodiscard]] virtual size_t totalCost() const = 0;
+  [[nodiscard]] virtual size_t maxCost() const = 0;
+  [[nodiscard]] virtual size_t evictions() const = 0;
+
+  /*!
+     Estimated recompute time per byte (in microseconds) of the entry which
+     evictOne() would remove next, or infinity if the cache is empty.
+   */
+  [[nodiscard]] virtual double evictionScore() const = 0;
+  virtual bool evictOne() = 0;
+  virtual void clear() = 0;
+};
+
+struct CacheOccupancy {
+  std::string name;
+  size_t entries;
+  size_t bytes;
+  size_t max_bytes;
+  size_t evictions;
+};
+
+/*!
+   Owns the single memory budget shared by all registered caches.
+
+   Whenever a cache grows, enforceBudget() evicts entries across all caches,
+   always picking the entry that is cheapest to recompute relative to the
+   memory it occupies, until the total fits the budget again. The effective
+   budget shrinks when the system runs low on available memory.
+ */
+class CacheManager
+{
+public:
+  static CacheManager *instance();
+
+  void registerCache(ManagedCache *cache);
+  void unregisterCache(ManagedCache *cache);
+
+  [[nodiscard]] size_t budget() const { return this->budgetBytes; }
+  void setBudgetMB(size_t limit);
+  [[nodiscard]] size_t budgetMB() const { return this->budgetBytes / (1024ul * 1024ul); }
+  // The budget after adjusting for memory pressure
+  [[nodiscard]] size_t effectiveBudget();
+  [[nodiscard]] size_t totalCost() const;
+
+  void enforceBudget();
+  void clear();
+  [[nodiscard]] std::vector<CacheOccupancy> occupancy() const;
+
+private:
+  CacheManager() = default;
+
+  size_t totalCostLocked() const;
+  size_t effectiveBudgetLocked(size_t total);
+
+  mutable std::mutex mutex;
+  std::vector<ManagedCache *> caches;
+  std::atomic<size_t> budgetBytes{512ul * 1024ul * 1024ul};
+  size_t pressureLimit{~size_t(0)};
+  std::chrono::steady_clock::time_point lastPressureCheck;
+};
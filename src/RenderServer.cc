@@ -0,0 +1,404 @@
+#include "RenderServer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "json/json.hpp"
+
+#include "CacheManager.h"
+#include "core/progress.h"
+#include "core/SourceFileCache.h"
+#include "utils/exceptions.h"
+#include "utils/printutils.h"
+#include "utils/StackCheck.h"
+
+namespace {
+
+// JSON-RPC 2.0 error codes
+constexpr int RPC_PARSE_ERROR = -32700;
+constexpr int RPC_INVALID_REQUEST = -32600;
+constexpr int RPC_METHOD_NOT_FOUND = -32601;
+constexpr int RPC_INVALID_PARAMS = -32602;
+
+nlohmann::json rpcError(const nlohmann::json& id, int code, const std::string& message)
+{
+  return {{"jsonrpc", "2.0"}, {"id", id}, {"error", {{"code", code}, {"message", message}}}};
+}
+
+nlohmann::json rpcResult(const nlohmann::json& id, const nlohmann::json& result)
+{
+  return {{"jsonrpc", "2.0"}, {"id", id}, {"result", result}};
+}
+
+nlohmann::json currentCacheStatistics()
+{
+  nlohmann::json json;
+  auto manager = CacheManager::instance();
+  for (const auto& cache : manager->occupancy()) {
+    json[cache.name] = {{"entries", cache.entries},
+                        {"bytes", cache.bytes},
+                        {"max_size", cache.max_bytes},
+                        {"evictions", cache.evictions}};
+  }
+  json["budget"] = {{"bytes", manager->totalCost()}, {"max_size", manager->budget()}};
+  json["source_files"] = SourceFileCache::instance()->size();
+  return json;
+}
+
+// Runs work on a thread with a STACKSIZE stack, like the main thread gets from the linker. On
+// Windows, threads already get the executable's stack size, which is set to STACKSIZE when linking.
+class StackSizedThread
+{
+public:
+  explicit StackSizedThread(std::function<void()> work) : work(std::move(work))
+  {
+#ifndef _WIN32
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, STACKSIZE);
+    const int err = pthread_create(&thread, &attr, &StackSizedThread::run, this);
+    pthread_attr_destroy(&attr);
+    if (err != 0) throw std::system_error(err, std::generic_category(), "Can't create render thread");
+#else
+    thread = std::thread(this->work);
+#endif
+  }
+  StackSizedThread(const StackSizedThread&) = delete;
+  StackSizedThread& operator=(const StackSizedThread&) = delete;
+
+  void join()
+  {
+#ifndef _WIN32
+    pthread_join(thread, nullptr);
+#else
+    thread.join();
+#endif
+  }
+
+private:
+#ifndef _WIN32
+  static void *run(void *self)
+  {
+    static_cast<StackSizedThread *>(self)->work();
+    return nullptr;
+  }
+  pthread_t thread;
+#else
+  std::thread thread;
+#endif
+  std::function<void()> work;
+};
+
+#ifndef _WIN32
+// Minimal unbuffered-output / buffered-input streambuf over a socket descriptor
+class SocketStreamBuf : public std::streambuf
+{
+public:
+  SocketStreamBuf(int fd) : fd(fd) { setg(buffer, buffer, buffer); }
+
+protected:
+  int_type underflow() override
+  {
+    const auto n = ::read(fd, buffer, sizeof(buffer));
+    if (n <= 0) return traits_type::eof();
+    setg(buffer, buffer, buffer + n);
+    return traits_type::to_int_type(*gptr());
+  }
+  std::streamsize xsputn(const char *s, std::streamsize count) override
+  {
+    std::streamsize written = 0;
+    while (written < count) {
+#ifdef MSG_NOSIGNAL
+      const auto n = ::send(fd, s + written, count - written, MSG_NOSIGNAL);
+#else
+      const auto n = ::send(fd, s + written, count - written, 0);
+#endif
+      if (n <= 0) break;
+      written += n;
+    }
+    return written;
+  }
+  int_type overflow(int_type ch) override
+  {
+    if (traits_type::eq_int_type(ch, traits_type::eof())) return traits_type::not_eof(ch);
+    const char c = traits_type::to_char_type(ch);
+    return xsputn(&c, 1) == 1 ? ch : traits_type::eof();
+  }
+
+private:
+  int fd;
+  char buffer[4096];
+};
+#endif  // ifndef _WIN32
+
+}  // namespace
+
+RenderServer::RenderServer(RenderFunction render) : render(std::move(render)) {}
+
+void RenderServer::respond(std::ostream& output, const nlohmann::json& response)
+{
+  const std::lock_guard<std::mutex> lock(outputMutex);
+  output << response.dump() << "\n";
+  output.flush();
+}
+
+nlohmann::json RenderServer::statistics()
+{
+  const std::lock_guard<std::mutex> lock(mutex);
+  nlohmann::json json;
+  json["jobs"] = {{"completed", completed},
+                  {"failed", failed},
+                  {"canceled", canceled},
+                  {"queued", queue.size()}};
+  if (!latencies.empty()) {
+    auto sorted = latencies;  // at most LATENCY_SAMPLES
+    std::sort(sorted.begin(), sorted.end());
+    std::chrono::milliseconds total{0};
+    for (const auto& ms : sorted) total += ms;
+    const auto percentile = [&sorted](double p) {
+      return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))].count();
+    };
+    json["latency_ms"] = {{"mean", total.count() / static_cast<double>(sorted.size())},
+                          {"p50", percentile(0.5)},
+                          {"p95", percentile(0.95)},
+                          {"max", sorted.back().count()}};
+  }
+  // Caches are only touched by the worker thread; report the snapshot taken after the last job
+  json["cache"] = cacheStatistics;
+  return json;
+}
+
+void RenderServer::worker(std::ostream& output)
+{
+  StackCheck::inst().reset(STACKSIZE);
+  while (true) {
+    RenderRequest request;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      queueChanged.wait(lock, [this] { return stopping || !queue.empty(); });
+      if (queue.empty()) return;
+      request = std::move(queue.front());
+      queue.pop_front();
+    }
+
+    std::string status = "ok";
+    std::string message;
+    int exitCode = 0;
+    const auto begin = std::chrono::steady_clock::now();
+    if (request.canceled->load()) {
+      status = "canceled";
+    } else {
+      try {
+        exitCode = render(request);
+        if (exitCode != 0) status = "failed";
+      } catch (const ProgressCancelException&) {
+        status = "canceled";
+      } catch (const HardWarningException& e) {
+        status = "failed";
+        message = e.what();
+      } catch (const std::exception& e) {
+        status = "failed";
+        message = e.what();
+      }
+    }
+    const auto ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+
+    {
+      const std::lock_guard<std::mutex> lock(mutex);
+      if (status == "canceled") {
+        ++canceled;
+      } else {
+        // Keep the latencies of the last LATENCY_SAMPLES jobs
+        if (latencies.size() < LATENCY_SAMPLES) latencies.push_back(ms);
+        else latencies[nextLatency] = ms;
+        nextLatency = (nextLatency + 1) % LATENCY_SAMPLES;
+        if (status == "ok") ++completed;
+        else ++failed;
+      }
+      cancelable.erase(std::remove_if(cancelable.begin(), cancelable.end(),
+                                      [&request](const auto& entry) {
+                                        return entry.second == request.canceled;
+                                      }),
+                       cancelable.end());
+      cacheStatistics = currentCacheStatistics();
+    }
+
+    nlohmann::json result = {{"status", status}, {"exit_code", exitCode}, {"milliseconds", ms.count()}};
+    if (!message.empty()) result["message"] = message;
+    respond(output, rpcResult(request.id, result));
+  }
+}
+
+bool RenderServer::handleLine(const std::string& line, std::ostream& output)
+{
+  if (line.find_first_not_of(" \t\r") == std::string::npos) return true;
+
+  nlohmann::json json;
+  try {
+    json = nlohmann::json::parse(line);
+  } catch (const nlohmann::json::exception& e) {
+    respond(output, rpcError(nullptr, RPC_PARSE_ERROR, e.what()));
+    return true;
+  }
+  const auto id = json.is_object() ? json.value("id", nlohmann::json()) : nlohmann::json();
+  if (!json.is_object() || !json.contains("method") || !json["method"].is_string()) {
+    respond(output, rpcError(id, RPC_INVALID_REQUEST, "Invalid request"));
+    return true;
+  }
+
+  const auto method = json["method"].get<std::string>();
+  const auto params = json.value("params", nlohmann::json::object());
+  if (!params.is_object()) {
+    respond(output, rpcError(id, RPC_INVALID_PARAMS, "'params' must be an object"));
+    return true;
+  }
+
+  if (method == "render") {
+    RenderRequest request;
+    try {
+      request.id = id;
+      request.cancelId = params.value("cancel_id", "");
+      request.file = params.value("file", "");
+      request.source = params.value("source", "");
+      request.defines = params.value("defines", std::vector<std::string>{});
+      request.outputs = params.value("outputs", std::vector<std::string>{});
+    } catch (const nlohmann::json::exception& e) {
+      respond(output, rpcError(id, RPC_INVALID_PARAMS, e.what()));
+      return true;
+    }
+    if (request.file.empty() == request.source.empty()) {
+      respond(output, rpcError(id, RPC_INVALID_PARAMS, "Exactly one of 'file' or 'source' is required"));
+      return true;
+    }
+    if (request.outputs.empty()) {
+      respond(output, rpcError(id, RPC_INVALID_PARAMS, "No 'outputs' given"));
+      return true;
+    }
+    request.canceled = std::make_shared<std::atomic<bool>>(false);
+    {
+      const std::lock_guard<std::mutex> lock(mutex);
+      if (!request.cancelId.empty()) cancelable.emplace_back(request.cancelId, request.canceled);
+      queue.push_back(std::move(request));
+    }
+    queueChanged.notify_one();
+  } else if (method == "cancel") {
+    if (!params.contains("cancel_id") || !params["cancel_id"].is_string()) {
+      respond(output, rpcError(id, RPC_INVALID_PARAMS, "'cancel_id' must be a string"));
+      return true;
+    }
+    const auto cancelId = params["cancel_id"].get<std::string>();
+    size_t matched = 0;
+    {
+      const std::lock_guard<std::mutex> lock(mutex);
+      for (const auto& [entryId, flag] : cancelable) {
+        if (entryId == cancelId) {
+          flag->store(true);
+          ++matched;
+        }
+      }
+    }
+    respond(output, rpcResult(id, {{"canceled", matched}}));
+  } else if (method == "stats") {
+    respond(output, rpcResult(id, statistics()));
+  } else if (method == "shutdown") {
+    respond(output, rpcResult(id, {{"status", "ok"}}));
+    const std::lock_guard<std::mutex> lock(mutex);
+    shutdownRequested = true;
+    return false;
+  } else {
+    respond(output, rpcError(id, RPC_METHOD_NOT_FOUND, "Unknown method '" + method + "'"));
+  }
+  return true;
+}
+
+int RenderServer::serve(std::istream& input, std::ostream& output)
+{
+#ifndef _WIN32
+  // A client going away mid-reply must not kill the server; writes just fail instead
+  std::signal(SIGPIPE, SIG_IGN);
+#endif
+  {
+    const std::lock_guard<std::mutex> lock(mutex);
+    stopping = false;
+    cacheStatistics = currentCacheStatistics();
+  }
+  StackSizedThread renderThread([this, &output] { worker(output); });
+
+  std::string line;
+  while (std::getline(input, line)) {
+    if (!handleLine(line, output)) break;
+  }
+
+  // Finish queued jobs before returning
+  {
+    const std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  queueChanged.notify_all();
+  renderThread.join();
+  return 0;
+}
+
+int RenderServer::serveSocket(const std::string& path)
+{
+#ifndef _WIN32
+  sockaddr_un addr{};
+  if (path.size() >= sizeof(addr.sun_path)) {
+    LOG(message_group::Error, "Socket path '%1$s' is too long", path);
+    return 1;
+  }
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    LOG(message_group::Error, "Can't create socket '%1$s'", path);
+    return 1;
+  }
+  addr.sun_family = AF_UNIX;
+  path.copy(addr.sun_path, path.size());
+  ::unlink(path.c_str());
+  if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(fd, 4) != 0) {
+    LOG(message_group::Error, "Can't listen on socket '%1$s'", path);
+    ::close(fd);
+    return 1;
+  }
+  LOG("Listening on %1$s", path);
+
+  while (!shutdownRequested) {
+    const int conn = ::accept(fd, nullptr, nullptr);
+    if (conn < 0) break;
+    SocketStreamBuf buf(conn);
+    std::iostream stream(&buf);
+    serve(stream, stream);
+    ::close(conn);
+  }
+  ::close(fd);
+  ::unlink(path.c_str());
+  return 0;
+#else
+  LOG(message_group::Error, "Unix domain sockets are not supported on this platform");
+  return 1;
+#endif
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "json/json.hpp"
+
+/**
+ * A single render job received by the @ref RenderServer.
+ */
+struct RenderRequest {
+  nlohmann::json id;
+  // Optional client chosen id which can be passed to the "cancel" method
+  std::string cancelId;
+  // Either a path to a .scad file or inline source code
+  std::string file;
+  std::string source;
+  // Variable assignments as given to -D
+  std::vector<std::string> defines;
+  // Output files, the format is derived from the suffix
+  std::vector<std::string> outputs;
+  std::shared_ptr<std::atomic<bool>> canceled;
+};
+
+/**
+ * Long-running render daemon used by "openscad --serve".
+ *
+ * Reads newline delimited JSON-RPC 2.0 requests from a stream (stdin or a
+ * Unix domain socket connection) and writes one JSON response line per
+ * request. Supported methods:
+ *
+ *  - render {file|source, defines, outputs, cancel_id}
+ *  - cancel {cancel_id}
+ *  - stats
+ *  - shutdown
+ *
+ * Since the process stays alive, parsed libraries (SourceFileCache) and the
+ * geometry caches stay warm between jobs. Evaluation relies on process wide
+ * state (current directory, caches, builtins), so jobs are executed one at a
+ * time on a worker thread while the reading thread stays responsive to
+ * "cancel" and "stats" requests.
+ */
+class RenderServer
+{
+public:
+  using RenderFunction = std::function<int(const RenderRequest&)>;
+
+  RenderServer(RenderFunction render);
+
+  /**
+   * Serve requests from the given streams until EOF or "shutdown".
+   */
+  int serve(std::istream& input, std::ostream& output);
+
+  /**
+   * Listen on a Unix domain socket, serving one connection at a time.
+   */
+  int serveSocket(const std::string& path);
+
+private:
+  bool handleLine(const std::string& line, std::ostream& output);
+  void respond(std::ostream& output, const nlohmann::json& response);
+  void worker(std::ostream& output);
+  nlohmann::json statistics();
+
+  RenderFunction render;
+  std::mutex mutex;
+  std::mutex outputMutex;
+  std::condition_variable queueChanged;
+  std::deque<RenderRequest> queue;
+  std::vector<std::pair<std::string, std::shared_ptr<std::atomic<bool>>>> cancelable;
+  // Latencies of the most recent jobs, used as a ring buffer once full
+  static constexpr size_t LATENCY_SAMPLES = 1024;
+  std::vector<std::chrono::milliseconds> latencies;
+  size_t nextLatency{0};
+  nlohmann::json cacheStatistics;
+  size_t completed{0};
+  size_t failed{0};
+  size_t canceled{0};
+  bool stopping{false};
+  std::atomic<bool> shutdownRequested{false};
+};
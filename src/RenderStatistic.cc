@@ -33,12 +33,14 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <boost/range/algorithm/find.hpp>
 
 #include "json/json.hpp"
 
+#include "CacheManager.h"
 #include "geometry/Geometry.h"
 #include "geometry/GeometryCache.h"
 #include "geometry/linalg.h"
@@ -59,6 +61,8 @@ class GeometryList;
 
 namespace {
 
+using ExportTimes = std::vector<std::pair<std::string, std::chrono::milliseconds>>;
+
 struct StatisticVisitor : public GeometryVisitor {
   StatisticVisitor(const std::vector<std::string>& options)
     : all(std::find(options.begin(), options.end(), "all") != options.end()), options(options)
@@ -67,6 +71,7 @@ struct StatisticVisitor : public GeometryVisitor {
   virtual void printCamera(const Camera& camera) = 0;
   virtual void printCacheStatistic() = 0;
   virtual void printRenderingTime(std::chrono::milliseconds) = 0;
+  virtual void printExportTimes(const ExportTimes&) = 0;
   virtual void finish() = 0;
 
 protected:
@@ -94,6 +99,7 @@ struct LogVisitor : public StatisticVisitor {
   void printCamera(const Camera& camera) override;
   void printCacheStatistic() override;
   void printRenderingTime(std::chrono::milliseconds) override;
+  void printExportTimes(const ExportTimes&) override;
   void finish() override;
 
 private:
@@ -125,6 +131,7 @@ struct StreamVisitor : public StatisticVisitor {
   void printCamera(const Camera& camera) override;
   void printCacheStatistic() override;
   void printRenderingTime(std::chrono::milliseconds) override;
+  void printExportTimes(const ExportTimes&) override;
   void finish() override;
 
 private:
@@ -160,13 +167,19 @@ static nlohmann::json getBoundingBox3d(const Geometry& geometry)
   return bbJson;
 }
 
-template <typename C>
-static nlohmann::json getCache(C cache)
+static nlohmann::json getCacheStatistic()
 {
   nlohmann::json cacheJson;
-  cacheJson["entries"] = cache->size();
-  cacheJson["bytes"] = cache->totalCost();
-  cacheJson["max_size"] = cache->maxSizeMB() * 1024 * 1024;
+  auto manager = CacheManager::instance();
+  for (const auto& cache : manager->occupancy()) {
+    cacheJson[cache.name] = {{"entries", cache.entries},
+                             {"bytes", cache.bytes},
+                             {"max_size", cache.max_bytes},
+                             {"evictions", cache.evictions}};
+  }
+  cacheJson["budget"] = {{"bytes", manager->totalCost()},
+                         {"max_size", manager->budget()},
+                         {"effective_max_size", manager->effectiveBudget()}};
   return cacheJson;
 }
 
@@ -174,13 +187,30 @@ static nlohmann::json getCache(C cache)
 
 RenderStatistic::RenderStatistic() : begin(std::chrono::steady_clock::now()) {}
 
-void RenderStatistic::start() { begin = std::chrono::steady_clock::now(); }
+void RenderStatistic::start()
+{
+  begin = std::chrono::steady_clock::now();
+  elapsed = {};
+  running = true;
+}
+
+void RenderStatistic::stop()
+{
+  if (running) elapsed += std::chrono::steady_clock::now() - begin;
+  running = false;
+}
+
+void RenderStatistic::resume()
+{
+  if (!running) begin = std::chrono::steady_clock::now();
+  running = true;
+}
 
 std::chrono::milliseconds RenderStatistic::ms()
 {
-  const std::chrono::steady_clock::time_point end{std::chrono::steady_clock::now()};
-  const std::chrono::milliseconds ms{std::chrono::duration_cast<std::chrono::milliseconds>(end - begin)};
-  return ms;
+  auto total = elapsed;
+  if (running) total += std::chrono::steady_clock::now() - begin;
+  return std::chrono::duration_cast<std::chrono::milliseconds>(total);
 }
 
 void RenderStatistic::printCacheStatistic()
@@ -195,6 +225,11 @@ void RenderStatistic::printRenderingTime()
   visitor.printRenderingTime(ms());
 }
 
+void RenderStatistic::addExportTime(const std::string& name, std::chrono::milliseconds ms)
+{
+  exportTimes.emplace_back(name, ms);
+}
+
 void RenderStatistic::printAll(const std::shared_ptr<const Geometry>& geom, const Camera& camera,
                                const std::vector<std::string>& options, const std::string& filename)
 {
@@ -211,6 +246,7 @@ void RenderStatistic::printAll(const std::shared_ptr<const Geometry>& geom, cons
 
   visitor->printCacheStatistic();
   visitor->printRenderingTime(ms());
+  visitor->printExportTimes(exportTimes);
   if (geom && !geom->isEmpty()) {
     geom->accept(*visitor);
   }
@@ -320,6 +356,9 @@ void LogVisitor::printCacheStatistic()
 #ifdef ENABLE_CGAL
   CGALCache::instance()->print();
 #endif
+  auto manager = CacheManager::instance();
+  LOG("Cache budget: %1$d of %2$d bytes used (%3$d MB configured)", manager->totalCost(),
+      manager->effectiveBudget(), manager->budgetMB());
 }
 
 void LogVisitor::printRenderingTime(const std::chrono::milliseconds ms)
@@ -329,6 +368,16 @@ void LogVisitor::printRenderingTime(const std::chrono::milliseconds ms)
       (ms.count() / 1000 / 60 % 60), (ms.count() / 1000 % 60), (ms.count() % 1000));
 }
 
+void LogVisitor::printExportTimes(const ExportTimes& times)
+{
+  if (is_enabled(RenderStatistic::TIME)) {
+    for (const auto& [name, ms] : times) {
+      LOG("   Export %1$s: %2$d:%3$02d:%4$02d.%5$03d", name, (ms.count() / 1000 / 60 / 60),
+          (ms.count() / 1000 / 60 % 60), (ms.count() / 1000 % 60), (ms.count() % 1000));
+    }
+  }
+}
+
 void LogVisitor::finish() {}
 
 void StreamVisitor::visit(const GeometryList& geomlist) {}
@@ -418,12 +467,7 @@ void StreamVisitor::printCamera(const Camera& camera)
 void StreamVisitor::printCacheStatistic()
 {
   if (is_enabled(RenderStatistic::CACHE)) {
-    nlohmann::json cacheJson;
-    cacheJson["geometry_cache"] = getCache(GeometryCache::instance());
-#ifdef ENABLE_CGAL
-    cacheJson["cgal_cache"] = getCache(CGALCache::instance());
-#endif  // ENABLE_CGAL
-    json["cache"] = cacheJson;
+    json["cache"] = getCacheStatistic();
   }
 }
 
@@ -443,4 +487,18 @@ void StreamVisitor::printRenderingTime(const std::chrono::milliseconds ms)
   }
 }
 
+void StreamVisitor::printExportTimes(const ExportTimes& times)
+{
+  if (is_enabled(RenderStatistic::TIME) && !times.empty()) {
+    nlohmann::json exportsJson = nlohmann::json::array();
+    for (const auto& [name, ms] : times) {
+      nlohmann::json exportJson;
+      exportJson["file"] = name;
+      exportJson["total"] = ms.count();
+      exportsJson.push_back(exportJson);
+    }
+    json["time"]["exports"] = exportsJson;
+  }
+}
+
 void StreamVisitor::finish() { stream << json; }
@@ -28,6 +28,7 @@
 #include <memory>
 #include <chrono>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "glview/Camera.h"
@@ -58,6 +59,17 @@ public:
    */
   void start();
 
+  /**
+   * Stop measuring, keeping the time measured so far.
+   */
+  void stop();
+
+  /**
+   * Continue measuring after stop(), adding to the time measured so far.
+   * Several render passes can be summarized together this way.
+   */
+  void resume();
+
   /**
    * Return render time in milliseconds.
    */
@@ -74,6 +86,12 @@ public:
    */
   void printRenderingTime();
 
+  /**
+   * Record the time spent writing one export target, reported with the
+   * rendering time when the "time" summary is enabled.
+   */
+  void addExportTime(const std::string& name, std::chrono::milliseconds ms);
+
   /**
    * Print all available statistic information.
    */
@@ -82,4 +100,7 @@ public:
 
 private:
   std::chrono::steady_clock::time_point begin;
+  std::chrono::steady_clock::duration elapsed{};
+  bool running{true};
+  std::vector<std::pair<std::string, std::chrono::milliseconds>> exportTimes;
 };
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "Cache.h"
+#include "CacheManager.h"
+
+/*!
+   Thread-safe string-keyed cache participating in the CacheManager budget.
+
+   Entries are spread over independently locked shards so concurrent
+   evaluators rarely contend. Besides the global budget, each cache can
+   have its own cost limit (e.g. from the GUI preferences).
+ */
+template <class T>
+class ShardedCache : public ManagedCache
+{
+public:
+  ShardedCache(std::string name, size_t limit = std::numeric_limits<size_t>::max())
+    : cacheName(std::move(name)), limit(limit)
+  {
+    CacheManager::instance()->registerCache(this);
+  }
+  ~ShardedCache() override { CacheManager::instance()->unregisterCache(this); }
+  ShardedCache(const ShardedCache&) = delete;
+  ShardedCache& operator=(const ShardedCache&) = delete;
+
+  [[nodiscard]] bool contains(const std::string& key) const
+  {
+    const auto& s = shard(key);
+    const std::lock_guard<std::mutex> lock(s.mutex);
+    return s.cache.contains(key);
+  }
+
+  // Returns a copy of the cached object, which stays valid even if the entry is evicted
+  [[nodiscard]] std::optional<T> get(const std::string& key) const
+  {
+    auto& s = shard(key);
+    const std::lock_guard<std::mutex> lock(s.mutex);
+    if (const T *object = s.cache.object(key)) return *object;
+    return {};
+  }
+
+  /*!
+     Inserts an object with the given cost in bytes and estimated recompute time in
+     microseconds. Returns false if the object is larger than the available budget.
+   */
+  bool insert(const std::string& key, T object, size_t cost, double weight = 0)
+  {
+    if (cost > maxCost()) return false;
+    auto& s = shard(key);
+    {
+      const std::lock_guard<std::mutex> lock(s.mutex);
+      const auto before = s.cache.totalCost();
+      s.cache.insert(key, new T(std::move(object)), cost, weight);
+      this->total += s.cache.totalCost() - before;
+    }
+    trim(this->limit);
+    CacheManager::instance()->enforceBudget();
+    return true;
+  }
+
+  // Returns false if there was no entry for the key
+  bool remove(const std::string& key)
+  {
+    auto& s = shard(key);
+    const std::lock_guard<std::mutex> lock(s.mutex);
+    const auto before = s.cache.totalCost();
+    if (!s.cache.remove(key)) return false;
+    this->total -= before - s.cache.totalCost();
+    return true;
+  }
+
+  void setMaxCost(size_t cost)
+  {
+    this->limit = cost;
+    trim(cost);
+  }
+
+  [[nodiscard]] const std::string& name() const override { return this->cacheName; }
+  [[nodiscard]] size_t size() const override
+  {
+    size_t entries = 0;
+    for (const auto& s : this->shards) {
+      const std::lock_guard<std::mutex> lock(s.mutex);
+      entries += s.cache.size();
+    }
+    return entries;
+  }
+  [[nodiscard]] size_t totalCost() const override { return this->total; }
+  [[nodiscard]] size_t maxCost() const override
+  {
+    return std::min<size_t>(this->limit, CacheManager::instance()->budget());
+  }
+  [[nodiscard]] size_t evictions() const override { return this->evictionCount; }
+
+  [[nodiscard]] double evictionScore() const override
+  {
+    auto best = std::numeric_limits<double>::infinity();
+    for (const auto& s : this->shards) {
+      const std::lock_guard<std::mutex> lock(s.mutex);
+      best = std::min(best, s.cache.evictionScore());
+    }
+    return best;
+  }
+
+  bool evictOne() override
+  {
+    Shard *victim = nullptr;
+    auto best = std::numeric_limits<double>::infinity();
+    for (auto& s : this->shards) {
+      const std::lock_guard<std::mutex> lock(s.mutex);
+      const auto score = s.cache.evictionScore();
+      if (!victim || score < best) {
+        victim = &s;
+        best = score;
+      }
+    }
+    const std::lock_guard<std::mutex> lock(victim->mutex);
+    const auto before = victim->cache.totalCost();
+    if (!victim->cache.evictOne()) return false;
+    this->total -= before - victim->cache.totalCost();
+    ++this->evictionCount;
+    return true;
+  }
+
+  void clear() override
+  {
+    for (auto& s : this->shards) {
+      const std::lock_guard<std::mutex> lock(s.mutex);
+      this->total -= s.cache.totalCost();
+      s.cache.clear();
+    }
+  }
+
+private:
+  static constexpr size_t NUM_SHARDS = 16;
+
+  struct Shard {
+    mutable std::mutex mutex;
+    Cache<std::string, T> cache{std::numeric_limits<size_t>::max()};
+  };
+
+  Shard& shard(const std::string& key) const
+  {
+    return this->shards[std::hash<std::string>{}(key) % NUM_SHARDS];
+  }
+
+  void trim(size_t cost)
+  {
+    while (this->total > cost && evictOne()) {
+    }
+  }
+
+  std::string cacheName;
+  std::atomic<size_t> limit;
+  std::atomic<size_t> total{0};
+  std::atomic<size_t> evictionCount{0};
+  mutable std::array<Shard, NUM_SHARDS> shards;
+};
@@ -0,0 +1,671 @@
+/*
+   openscad-bench: micro benchmarks for hot geometry / evaluation kernels and
+   macro benchmarks rendering a small corpus of .scad files.
+
+   Results are written as JSON so two builds can be compared, e.g. with
+   scripts/bench-compare.py.
+
+   Usage: openscad-bench [--filter <substring>] [--min-time <ms>] [--max-iterations <n>]
+                         [--corpus <dir>] [--no-micro] [--no-macro] [-o <file.json>]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/dll/runtime_symbol_info.hpp>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "json/json.hpp"
+
+#include "openscad.h"
+#include "version.h"
+#include "core/Builtins.h"
+#include "core/BuiltinContext.h"
+#include "core/Context.h"
+#include "core/EvaluationSession.h"
+#include "core/SourceFile.h"
+#include "core/Tree.h"
+#include "core/Value.h"
+#include "core/node.h"
+#include "geometry/ClipperUtils.h"
+#include "geometry/Geometry.h"
+#include "geometry/GeometryCache.h"
+#include "geometry/GeometryEvaluator.h"
+#include "geometry/GeometryUtils.h"
+#include "geometry/PolySet.h"
+#include "geometry/PolySetBuilder.h"
+#include "geometry/PolySetUtils.h"
+#include "geometry/Polygon2d.h"
+#include "geometry/Reindexer.h"
+#include "glview/RenderSettings.h"
+#include "io/export.h"
+#include "io/import.h"
+#include "platform/PlatformUtils.h"
+#include "utils/printutils.h"
+#if defined(ENABLE_EXPERIMENTAL) && defined(ENABLE_CGAL)
+#include "core/CurveDiscretizer.h"
+#include "geometry/roof_ss.h"
+#include "geometry/roof_vd.h"
+#endif
+#ifdef ENABLE_CGAL
+#include "geometry/cgal/CGALCache.h"
+#include <CGAL/assertions.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct BenchOptions {
+  std::string filter;
+  double min_time_ms = 300;
+  size_t max_iterations = 1000;
+  std::string corpus = OPENSCAD_BENCH_CORPUS;
+  bool micro = true;
+  bool macro = true;
+  std::string output;
+};
+
+/*!
+   Returns how much fn grows the peak resident memory of a process, in KiB, by running it
+   in a forked child. Returns 0 where that isn't supported.
+ */
+long peakMemoryKiB(const std::function<void()>& fn)
+{
+#ifdef _WIN32
+  return 0;
+#else
+  const auto childPeak = [](const std::function<void()>& childFn) -> long {
+    const pid_t pid = fork();
+    if (pid == 0) {
+      try {
+        childFn();
+      } catch (const std::exception&) {
+        _exit(1);
+      }
+      _exit(0);
+    }
+    int status = 0;
+    struct rusage usage {};
+    if (pid < 0 || wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+      return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;  // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+  };
+  // The child starts out with the resident memory of this process
+  const long baseline = childPeak([] {});
+  const long peak = childPeak(fn);
+  return peak > baseline ? peak - baseline : 0;
+#endif
+}
+
+class BenchRunner
+{
+public:
+  BenchRunner(const BenchOptions& options) : options(options) {}
+
+  /*!
+     Runs fn repeatedly (after one warm-up call) until both min_time_ms has passed
+     and at least three samples were taken, or max_iterations is reached.
+     With peak_memory, fn also runs once more in a child process to record its peak memory use.
+   */
+  void run(const std::string& group, const std::string& name, const std::function<void()>& fn,
+           const std::string& backend = "", bool peak_memory = false)
+  {
+    auto id = group + "/" + name;
+    if (!backend.empty()) id += "@" + backend;
+    if (!options.filter.empty() && id.find(options.filter) == std::string::npos) return;
+
+    std::cerr << id << " ... " << std::flush;
+    std::vector<double> samples;
+    try {
+      fn();
+      double total = 0;
+      while (samples.size() < options.max_iterations &&
+             (samples.size() < 3 || total < options.min_time_ms)) {
+        const auto begin = std::chrono::steady_clock::now();
+        fn();
+        const std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::steady_clock::now() - begin;
+        samples.push_back(elapsed.count());
+        total += elapsed.count();
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "failed: " << e.what() << std::endl;
+      results.push_back({{"name", id}, {"group", group}, {"error", e.what()}});
+      return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    const auto mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    double variance = 0;
+    for (const auto sample : samples) variance += (sample - mean) * (sample - mean);
+    const auto mid = samples.size() / 2;
+    const auto median = samples.size() % 2 ? samples[mid] : (samples[mid - 1] + samples[mid]) / 2;
+    std::cerr << median << " ms (" << samples.size() << " iterations)" << std::endl;
+
+    nlohmann::json result = {{"name", id},
+                             {"group", group},
+                             {"iterations", samples.size()},
+                             {"median_ms", median},
+                             {"mean_ms", mean},
+                             {"min_ms", samples.front()},
+                             {"max_ms", samples.back()},
+                             {"stddev_ms", std::sqrt(variance / samples.size())}};
+    if (!backend.empty()) result["backend"] = backend;
+    if (peak_memory) {
+      if (const auto kib = peakMemoryKiB(fn)) result["peak_memory_kib"] = kib;
+    }
+    results.push_back(result);
+  }
+
+  nlohmann::json json() const
+  {
+    nlohmann::json json;
+    json["version"] = openscad_detailedversionnumber;
+    json["min_time_ms"] = options.min_time_ms;
+    json["benchmarks"] = results;
+    return json;
+  }
+
+private:
+  const BenchOptions& options;
+  nlohmann::json results = nlohmann::json::array();
+};
+
+// Keeps the optimizer from discarding benchmark results
+template <typename T>
+void keep(T&& value)
+{
+  static volatile size_t sink;
+  sink = sink + reinterpret_cast<size_t>(&value);
+}
+
+std::vector<Vector3d> gridVertices(int n)
+{
+  std::vector<Vector3d> vertices;
+  vertices.reserve(static_cast<size_t>(n) * n);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) vertices.emplace_back(i, j, std::sin(i * 0.1) * std::cos(j * 0.1));
+  }
+  return vertices;
+}
+
+// Closed n-gon prism: two large non-triangular caps plus quad sides
+std::unique_ptr<PolySet> prism(int n, double r, double h)
+{
+  PolySetBuilder builder;
+  std::vector<Vector3d> bottom, top;
+  for (int i = 0; i < n; ++i) {
+    const double a = 2 * M_PI * i / n;
+    bottom.emplace_back(r * std::cos(a), r * std::sin(a), 0);
+    top.emplace_back(r * std::cos(a), r * std::sin(a), h);
+  }
+  for (int i = 0; i < n; ++i) {
+    const int j = (i + 1) % n;
+    builder.appendPolygon(std::vector<Vector3d>{bottom[i], bottom[j], top[j], top[i]});
+  }
+  builder.appendPolygon(top);
+  std::reverse(bottom.begin(), bottom.end());
+  builder.appendPolygon(bottom);
+  return builder.build();
+}
+
+// Triangulated UV sphere, used as a representative mesh for import / export
+std::unique_ptr<PolySet> sphere(int rings, int segments, double r)
+{
+  PolySetBuilder builder;
+  const auto point = [&](int ring, int segment) {
+    const double phi = M_PI * ring / rings;
+    const double theta = 2 * M_PI * segment / segments;
+    return Vector3d(r * std::sin(phi) * std::cos(theta), r * std::sin(phi) * std::sin(theta),
+                    r * std::cos(phi));
+  };
+  for (int ring = 0; ring < rings; ++ring) {
+    for (int segment = 0; segment < segments; ++segment) {
+      const int next = (segment + 1) % segments;
+      builder.appendPolygon(
+        std::vector<Vector3d>{point(ring, segment), point(ring + 1, segment), point(ring + 1, next)});
+      builder.appendPolygon(
+        std::vector<Vector3d>{point(ring, segment), point(ring + 1, next), point(ring, next)});
+    }
+  }
+  return builder.build();
+}
+
+std::shared_ptr<const Polygon2d> circle(double x, double y, double r, int n)
+{
+  Outline2d outline;
+  for (int i = 0; i < n; ++i) {
+    const double a = 2 * M_PI * i / n;
+    outline.vertices.emplace_back(x + r * std::cos(a), y + r * std::sin(a));
+  }
+  return std::make_shared<Polygon2d>(std::move(outline));
+}
+
+// The DOM to Value conversion import_json() used before it parsed JSON with a SAX handler
+Value jsonToValue(const nlohmann::json& j, EvaluationSession *session)
+{
+  if (j.is_string()) return {j.get<std::string>()};
+  if (j.is_number()) return {j.get<double>()};
+  if (j.is_boolean()) return {j.get<bool>()};
+  if (j.is_object()) {
+    ObjectType obj{session};
+    for (const auto& item : j.items()) obj.set(item.key(), jsonToValue(item.value(), session));
+    return {std::move(obj)};
+  }
+  if (j.is_array()) {
+    Value::VectorType vec{session};
+    for (const auto& elem : j) vec.emplace_back(jsonToValue(elem, session));
+    return std::move(vec);
+  }
+  return Value::undefined.clone();
+}
+
+void microBenchmarks(BenchRunner& bench)
+{
+  const auto grid = gridVertices(300);
+  bench.run("micro", "reindexer_lookup", [&] {
+    Reindexer<Vector3d> reindexer;
+    // every vertex is looked up twice to exercise both the insert and the hit path
+    for (const auto& v : grid) keep(reindexer.lookup(v));
+    for (const auto& v : grid) keep(reindexer.lookup(v));
+    keep(reindexer.getArray().size());
+  });
+
+  bench.run("micro", "polysetbuilder_grid", [&] {
+    constexpr int n = 300;
+    PolySetBuilder builder(n * n, 2 * (n - 1) * (n - 1));
+    for (int i = 0; i < n - 1; ++i) {
+      for (int j = 0; j < n - 1; ++j) {
+        builder.appendPolygon(std::vector<Vector3d>{grid[i * n + j], grid[(i + 1) * n + j],
+                                                    grid[(i + 1) * n + j + 1], grid[i * n + j + 1]});
+      }
+    }
+    keep(builder.build());
+  });
+
+  const auto prisms = prism(2048, 50, 10);
+  bench.run("micro", "tessellate_faces_prism", [&] { keep(PolySetUtils::tessellate_faces(*prisms)); });
+
+  const std::shared_ptr<const PolySet> cached = sphere(200, 400, 50);
+  bench.run("micro", "polyset_copy_transform_color", [&] {
+    // Like transforming and coloring a cached 3D result: copy it, then modify the copy
+    auto copy = cached->copy();
+    copy->transform(Transform3d(Eigen::Translation3d(1.0, 2.0, 3.0)));
+    copy->setColor(Color4f(1.0f, 0.0f, 0.0f));
+    keep(copy);
+  });
+
+  std::vector<std::shared_ptr<const Polygon2d>> circles;
+  for (int i = 0; i < 100; ++i) circles.push_back(circle((i % 10) * 7.0, (i / 10) * 7.0, 5, 64));
+  bench.run("micro", "clipper_union",
+            [&] { keep(ClipperUtils::apply(circles, Clipper2Lib::ClipType::Union)); });
+  bench.run("micro", "clipper_difference",
+            [&] { keep(ClipperUtils::apply(circles, Clipper2Lib::ClipType::Difference)); });
+  const std::shared_ptr<const Polygon2d> unioned =
+    ClipperUtils::apply(circles, Clipper2Lib::ClipType::Union);
+  bench.run("micro", "polygon2d_copy_transform", [&] {
+    // Like transforming a cached 2D result: copy it, then transform the copy
+    auto copy = std::make_unique<Polygon2d>(*unioned);
+    copy->transform(Transform2d(Eigen::Translation2d(1.0, 2.0)));
+    keep(copy);
+  });
+  bench.run("micro", "clipper_offset_round", [&] {
+    keep(ClipperUtils::applyOffset(*unioned, 1.5, Clipper2Lib::JoinType::Round, 2.0, 0.01));
+  });
+  const std::vector<std::shared_ptr<const Polygon2d>> minkowski_operands{circles[0],
+                                                                         circle(0, 0, 1, 32)};
+  bench.run("micro", "clipper_minkowski",
+            [&] { keep(ClipperUtils::applyMinkowski(minkowski_operands)); });
+  // Non-convex operands with holes take the general path
+  const std::vector<std::shared_ptr<const Polygon2d>> minkowski_concave_operands{unioned,
+                                                                                 circle(0, 0, 1, 32)};
+  bench.run("micro", "clipper_minkowski_concave",
+            [&] { keep(ClipperUtils::applyMinkowski(minkowski_concave_operands)); });
+
+#if defined(ENABLE_EXPERIMENTAL) && defined(ENABLE_CGAL)
+  // Many disjoint islands with holes, like lettering or board outlines
+  Polygon2d islands;
+  for (int i = 0; i < 400; ++i) {
+    const double x = (i % 20) * 12.0, y = (i / 20) * 12.0;
+    islands.addOutline(circle(x, y, 5, 48)->outlines()[0]);
+    auto hole = circle(x, y, 2, 24)->outlines()[0];
+    hole.positive = false;
+    islands.addOutline(std::move(hole));
+  }
+  bench.run("micro", "roof_straight_islands", [&] { keep(roof_ss::straight_skeleton_roof(islands)); });
+  const CurveDiscretizer roof_discretizer(16.0);
+  bench.run("micro", "roof_voronoi_islands",
+            [&] { keep(roof_vd::voronoi_diagram_roof(islands, roof_discretizer)); });
+#endif
+
+  EvaluationSession session{fs::current_path().string()};
+  bench.run("micro", "value_arithmetic", [&] {
+    Value sum(0.0);
+    for (int i = 0; i < 100000; ++i) sum = (sum + Value(i * 0.5)) * Value(0.999) - Value(1.0);
+    keep(sum.toDouble());
+  });
+  bench.run("micro", "value_vector_arithmetic", [&] {
+    Value sum = VectorType(&session, 0, 0, 0);
+    for (int i = 0; i < 20000; ++i) {
+      sum = sum + Value(VectorType(&session, i, i * 2.0, i * 3.0)) * Value(0.5);
+    }
+    keep(sum.toVector().size());
+  });
+
+  bench.run("micro", "context_lookup", [&] {
+    // 16 nested scopes with 32 variables each, looking up names defined at every depth
+    std::vector<ContextHandle<Context>> contexts;
+    contexts.reserve(16);
+    contexts.emplace_back(Context::create<Context>(&session));
+    for (int depth = 0; depth < 16; ++depth) {
+      if (depth > 0) contexts.emplace_back(Context::create<Context>(*contexts.back()));
+      for (int i = 0; i < 32; ++i) {
+        contexts.back()->set_variable("v" + std::to_string(depth) + "_" + std::to_string(i), Value(i));
+      }
+    }
+    const auto& innermost = contexts.back();
+    std::vector<std::string> names;
+    for (int depth = 0; depth < 16; ++depth) names.push_back("v" + std::to_string(depth) + "_7");
+    double total = 0;
+    for (int round = 0; round < 1000; ++round) {
+      for (const auto& name : names) {
+        total += innermost->lookup_variable(name, Location::NONE).toDouble();
+      }
+    }
+    keep(total);
+    while (!contexts.empty()) contexts.pop_back();
+  });
+
+  bench.run("micro", "object_member_lookup", [&] {
+    // 10000 records with the same 12 keys, then a lookup of one key in each
+    const std::vector<std::string> keys = {"id",    "name",  "x",     "y",      "z",     "width",
+                                           "depth", "height", "color", "weight", "layer", "tags"};
+    std::vector<ObjectType> records;
+    records.reserve(10000);
+    for (int i = 0; i < 10000; ++i) {
+      records.emplace_back(&session);
+      for (size_t k = 0; k < keys.size(); ++k) records.back().set(keys[k], Value(i + int(k)));
+    }
+    ObjectKeyCache cache;
+    double total = 0;
+    for (const auto& record : records) total += record.get("height", cache).toDouble();
+    keep(total);
+  });
+
+  // Nested generators with a filter, building a 45000 element list, then indexing into it
+  const std::string comprehension =
+    "v = [for (i = [0:299]) for (j = [0:299]) if ((i + j) % 2 == 0) [i, j]];\n"
+    "last = v[len(v) - 1];\n";
+  SourceFile *comprehension_file = nullptr;
+  const bool parsed =
+    parse(comprehension_file, comprehension, "comprehension.scad", "comprehension.scad", false);
+  const std::unique_ptr<SourceFile> comprehension_guard(comprehension_file);
+  if (parsed && comprehension_file) {
+    bench.run("micro", "list_comprehension_nested", [&] {
+      ContextHandle<BuiltinContext> builtin_context{Context::create<BuiltinContext>(&session)};
+      std::shared_ptr<const FileContext> file_context;
+      keep(comprehension_file->instantiate(*builtin_context, &file_context));
+    });
+  }
+
+  // len(), indexing, for and search() consuming 100000 element comprehensions without building them
+  const std::string streaming =
+    "n = len([for (i = [0:99999]) if (i % 3 == 0) i]);\n"
+    "x = [for (i = [0:99999]) i * i][99999];\n"
+    "s = [for (x = [for (i = [0:99999]) i * 2]) if (x % 7 == 0) x];\n"
+    "f = search(99998, [for (i = [0:99999]) i * 2], 0);\n";
+  SourceFile *streaming_file = nullptr;
+  const bool streaming_parsed =
+    parse(streaming_file, streaming, "streaming.scad", "streaming.scad", false);
+  const std::unique_ptr<SourceFile> streaming_guard(streaming_file);
+  if (streaming_parsed && streaming_file) {
+    bench.run("micro", "list_comprehension_streaming", [&] {
+      ContextHandle<BuiltinContext> builtin_context{Context::create<BuiltinContext>(&session)};
+      std::shared_ptr<const FileContext> file_context;
+      keep(streaming_file->instantiate(*builtin_context, &file_context));
+    });
+  }
+
+  // Non-tail recursion 100000 calls deep, and a tail recursive loop with as many calls
+  const std::string recursion =
+    "function depth(n) = n == 0 ? 0 : 1 + depth(n - 1);\n"
+    "function loop(n, acc = 0) = n == 0 ? acc : loop(n - 1, acc + n);\n"
+    "a = depth(100000);\n"
+    "b = loop(100000);\n";
+  SourceFile *recursion_file = nullptr;
+  const bool recursion_parsed =
+    parse(recursion_file, recursion, "recursion.scad", "recursion.scad", false);
+  const std::unique_ptr<SourceFile> recursion_guard(recursion_file);
+  if (recursion_parsed && recursion_file) {
+    bench.run("micro", "function_recursion", [&] {
+      ContextHandle<BuiltinContext> builtin_context{Context::create<BuiltinContext>(&session)};
+      std::shared_ptr<const FileContext> file_context;
+      keep(recursion_file->instantiate(*builtin_context, &file_context));
+    });
+  }
+
+  const std::shared_ptr<const Geometry> mesh = sphere(200, 400, 50);
+  const auto tmpdir = fs::temp_directory_path();
+  const auto stlfile = (tmpdir / "openscad-bench.stl").string();
+  const auto objfile = (tmpdir / "openscad-bench.obj").string();
+  bench.run("micro", "export_stl_binary", [&] {
+    std::ofstream stream(stlfile, std::ios::binary);
+    export_stl(mesh, stream, true);
+  });
+  bench.run("micro", "export_stl_ascii", [&] {
+    std::ostringstream stream;
+    export_stl(mesh, stream, false);
+    keep(stream.tellp());
+  });
+  bench.run("micro", "export_obj", [&] {
+    std::ofstream stream(objfile);
+    export_obj(mesh, stream);
+  });
+  if (fs::exists(stlfile)) {
+    bench.run("micro", "import_stl", [&] { keep(import_stl(stlfile, Location::NONE)); });
+  }
+  if (fs::exists(objfile)) {
+    bench.run("micro", "import_obj", [&] { keep(import_obj(objfile, Location::NONE)); });
+  }
+
+  // A point cloud with a property object per point, like GIS or scan data
+  const auto jsonfile = (tmpdir / "openscad-bench.json").string();
+  {
+    nlohmann::json points = nlohmann::json::array();
+    for (int i = 0; i < 50000; ++i) {
+      points.push_back({{"id", i}, {"pos", {i * 0.5, i * 0.25, i * 0.125}}, {"tag", "p"}});
+    }
+    std::ofstream stream(jsonfile);
+    stream << points;
+  }
+  bench.run(
+    "micro", "import_json", [&] { keep(import_json(jsonfile, &session, Location::NONE)); }, "", true);
+  // What import_json() used to do: parse into a DOM, then convert it to Values
+  bench.run(
+    "micro", "import_json_dom",
+    [&] {
+      std::ifstream stream(jsonfile);
+      nlohmann::json j;
+      stream >> j;
+      keep(jsonToValue(j, &session));
+    },
+    "", true);
+
+  std::error_code ec;
+  fs::remove(stlfile, ec);
+  fs::remove(objfile, ec);
+  fs::remove(jsonfile, ec);
+}
+
+void clearCaches()
+{
+  GeometryCache::instance()->clear();
+#ifdef ENABLE_CGAL
+  CGALCache::instance()->clear();
+#endif
+}
+
+// Parse, instantiate and render one file from scratch, like "openscad -o out.stl file.scad"
+void renderFile(const fs::path& file)
+{
+  std::ifstream ifs(file);
+  auto text = std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+  text += "\n\x03\n" + commandline_commands;
+
+  SourceFile *root_file = nullptr;
+  if (!parse(root_file, text, file.string(), file.string(), false) || !root_file) {
+    delete root_file;
+    throw std::runtime_error("Can't parse file '" + file.string() + "'");
+  }
+  std::unique_ptr<SourceFile> root_file_guard(root_file);
+
+  const auto original_path = fs::current_path();
+  fs::current_path(file.parent_path());
+  EvaluationSession session{file.parent_path().string()};
+  ContextHandle<BuiltinContext> builtin_context{Context::create<BuiltinContext>(&session)};
+  AbstractNode::resetIndexCounter();
+  std::shared_ptr<const FileContext> file_context;
+  std::shared_ptr<AbstractNode> root_node;
+  try {
+    root_node = root_file->instantiate(*builtin_context, &file_context);
+  } catch (...) {
+    fs::current_path(original_path);
+    throw;
+  }
+  fs::current_path(original_path);
+  if (!root_node) throw std::runtime_error("Empty top level object");
+
+  Tree tree(root_node, file.parent_path().string());
+  GeometryEvaluator geomevaluator(tree);
+  auto geom = geomevaluator.evaluateGeometry(*tree.root(), true);
+  if (geom && geom->getDimension() == 3) geom = GeometryUtils::getBackendSpecificGeometry(geom);
+  keep(geom);
+}
+
+void macroBenchmarks(BenchRunner& bench, const BenchOptions& options)
+{
+  std::vector<fs::path> files;
+  if (fs::is_directory(options.corpus)) {
+    for (const auto& entry : fs::directory_iterator(options.corpus)) {
+      if (entry.path().extension() == ".scad") files.push_back(fs::absolute(entry.path()));
+    }
+  }
+  if (files.empty()) {
+    std::cerr << "No .scad files found in corpus '" << options.corpus << "'" << std::endl;
+    return;
+  }
+  std::sort(files.begin(), files.end());
+
+  std::vector<std::pair<std::string, RenderBackend3D>> backends;
+#ifdef ENABLE_MANIFOLD
+  backends.emplace_back("manifold", RenderBackend3D::ManifoldBackend);
+#endif
+#ifdef ENABLE_CGAL
+  backends.emplace_back("cgal", RenderBackend3D::CGALBackend);
+  backends.emplace_back("corefinement", RenderBackend3D::CorefinementBackend);
+#endif
+
+  const auto original_backend = RenderSettings::inst()->backend3D;
+  for (const auto& [backend_name, backend] : backends) {
+    RenderSettings::inst()->backend3D = backend;
+    for (const auto& file : files) {
+      // Caches are cleared each iteration so every sample measures a cold render
+      bench.run(
+        "macro", file.stem().string(),
+        [&file] {
+          clearCaches();
+          renderFile(file);
+        },
+        backend_name);
+    }
+  }
+  RenderSettings::inst()->backend3D = original_backend;
+  clearCaches();
+}
+
+// Swallow ECHO and warnings from the corpus, they would only add noise to the timings
+void quietOutput(const Message&, void *) {}
+
+int usage(const char *progname)
+{
+  std::cerr << "Usage: " << progname
+            << " [--filter <substring>] [--min-time <ms>] [--max-iterations <n>]\n"
+               "       [--corpus <dir>] [--no-micro] [--no-macro] [-o <file.json>]"
+            << std::endl;
+  return 1;
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+  BenchOptions options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--filter" && has_value) options.filter = argv[++i];
+    else if (arg == "--min-time" && has_value) options.min_time_ms = std::atof(argv[++i]);
+    else if (arg == "--max-iterations" && has_value) options.max_iterations = std::atoi(argv[++i]);
+    else if (arg == "--corpus" && has_value) options.corpus = argv[++i];
+    else if (arg == "--no-micro") options.micro = false;
+    else if (arg == "--no-macro") options.macro = false;
+    else if (arg == "-o" && has_value) options.output = argv[++i];
+    else return usage(argv[0]);
+  }
+  if (options.max_iterations == 0) return usage(argv[0]);
+
+  PlatformUtils::registerApplicationPath(
+    weakly_canonical(boost::dll::program_location()).parent_path().generic_string());
+#ifdef ENABLE_CGAL
+  CGAL::set_error_behaviour(CGAL::THROW_EXCEPTION);
+  CGAL::set_warning_behaviour(CGAL::THROW_EXCEPTION);
+#endif
+  Builtins::instance()->initialize();
+  set_output_handler(&quietOutput, nullptr, nullptr);
+
+  BenchRunner bench(options);
+  if (options.micro) microBenchmarks(bench);
+  if (options.macro) macroBenchmarks(bench, options);
+
+  set_output_handler(nullptr, nullptr, nullptr);
+  const auto json = bench.json();
+  if (options.output.empty()) {
+    std::cout << json.dump(2) << std::endl;
+  } else {
+    std::ofstream stream(options.output);
+    if (!stream.is_open()) {
+      std::cerr << "Can't open output file '" << options.output << "'" << std::endl;
+      return 1;
+    }
+    stream << json.dump(2) << std::endl;
+  }
+  Builtins::instance(true);
+  return 0;
+}
@@ -0,0 +1,710 @@
+#include "core/ASTSnapshot.h"
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "FontCache.h"
+#include "core/AST.h"
+#include "core/Assignment.h"
+#include "core/Expression.h"
+#include "core/LocalScope.h"
+#include "core/ModuleInstantiation.h"
+#include "core/SourceFile.h"
+#include "core/UserModule.h"
+#include "core/Value.h"
+#include "core/function.h"
+#include "handle_dep.h"
+#include "utils/printutils.h"
+#include "version.h"
+
+namespace {
+
+constexpr char MAGIC[8] = {'O', 'S', 'C', 'A', 'D', 'A', 'S', 'T'};
+// Bump whenever the layout below or the AST classes change
+constexpr uint32_t FORMAT_VERSION = 1;
+// Written in native byte order to reject snapshots from other architectures
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+constexpr uint64_t FNV_PRIME = 0x100000001b3ull;
+
+enum class Tag : uint8_t {
+  Null,
+  UnaryOp,
+  BinaryOp,
+  TernaryOp,
+  ArrayLookup,
+  Literal,
+  Range,
+  Vector,
+  Lookup,
+  MemberLookup,
+  FunctionCall,
+  FunctionDefinition,
+  Assert,
+  Echo,
+  Let,
+  LcIf,
+  LcFor,
+  LcForC,
+  LcEach,
+  LcLet
+};
+
+enum class LiteralType : uint8_t { Undefined, Bool, Number, String };
+
+// The AST contains something we don't know how to store; the file is simply not snapshotted
+class UnsupportedError : public std::runtime_error
+{
+public:
+  UnsupportedError(const std::string& what) : std::runtime_error(what) {}
+};
+
+// Truncated or otherwise corrupt snapshot
+class CorruptError : public std::runtime_error
+{
+public:
+  CorruptError() : std::runtime_error("corrupt AST snapshot") {}
+};
+
+std::string snapshot_directory;
+
+bool read_file(const std::string& filename, std::string& contents)
+{
+  std::ifstream ifs(fs::u8path(filename), std::ios::binary);
+  if (!ifs.is_open()) return false;
+  contents.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+  return true;
+}
+
+}  // namespace
+
+class ASTSnapshot::Writer
+{
+public:
+  void u8(uint8_t v) { data.push_back(static_cast<char>(v)); }
+  void u32(uint32_t v) { raw(&v, sizeof(v)); }
+  void i32(int32_t v) { raw(&v, sizeof(v)); }
+  void u64(uint64_t v) { raw(&v, sizeof(v)); }
+  void f64(double v) { raw(&v, sizeof(v)); }
+  void str(const std::string& s)
+  {
+    u32(static_cast<uint32_t>(s.size()));
+    data.append(s);
+  }
+  void raw(const void *src, size_t size) { data.append(static_cast<const char *>(src), size); }
+
+  uint32_t pathIndex(const std::string& path)
+  {
+    auto it = pathIndices.find(path);
+    if (it != pathIndices.end()) return it->second;
+    const auto index = static_cast<uint32_t>(paths.size());
+    paths.push_back(path);
+    pathIndices.emplace(path, index);
+    return index;
+  }
+
+  std::string data;
+  std::vector<std::string> paths;
+
+private:
+  std::unordered_map<std::string, uint32_t> pathIndices;
+};
+
+class ASTSnapshot::Reader
+{
+public:
+  Reader(const char *begin, const char *end) : pos(begin), end(end) {}
+
+  uint8_t u8()
+  {
+    need(1);
+    return static_cast<uint8_t>(*pos++);
+  }
+  uint32_t u32() { return value<uint32_t>(); }
+  int32_t i32() { return value<int32_t>(); }
+  uint64_t u64() { return value<uint64_t>(); }
+  double f64() { return value<double>(); }
+  std::string str()
+  {
+    const auto size = u32();
+    need(size);
+    std::string s(pos, size);
+    pos += size;
+    return s;
+  }
+  // Element counts are sanity checked against the remaining data, so corrupt
+  // snapshots can't trigger huge allocations
+  uint32_t count()
+  {
+    const auto n = u32();
+    if (n > static_cast<size_t>(end - pos)) throw CorruptError();
+    return n;
+  }
+  bool atEnd() const { return pos == end; }
+
+  std::shared_ptr<fs::path> path(uint32_t index) const
+  {
+    if (index >= paths.size()) throw CorruptError();
+    return paths[index];
+  }
+
+  std::vector<std::shared_ptr<fs::path>> paths;
+
+private:
+  void need(size_t size) const
+  {
+    if (size > static_cast<size_t>(end - pos)) throw CorruptError();
+  }
+  template <typename T>
+  T value()
+  {
+    need(sizeof(T));
+    T v;
+    std::memcpy(&v, pos, sizeof(T));
+    pos += sizeof(T);
+    return v;
+  }
+
+  const char *pos;
+  const char *end;
+};
+
+void ASTSnapshot::setDirectory(const std::string& dir) { snapshot_directory = dir; }
+
+const std::string& ASTSnapshot::directory() { return snapshot_directory; }
+
+// 64-bit FNV-1a; std::hash isn't guaranteed to be stable between builds
+uint64_t ASTSnapshot::hash(const std::string& data)
+{
+  uint64_t h = FNV_OFFSET_BASIS;
+  for (const char c : data) {
+    h ^= static_cast<uint8_t>(c);
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+fs::path ASTSnapshot::snapshotPath(const std::string& filename, const std::string& text)
+{
+  const auto key =
+    hash(STR(openscad_detailedversionnumber, '\0', FORMAT_VERSION, '\0', filename, '\0', text));
+  std::ostringstream name;
+  name << std::hex << key << ".ast";
+  return fs::u8path(directory()) / name.str();
+}
+
+void ASTSnapshot::writeLocation(Writer& out, const Location& loc)
+{
+  out.i32(loc.firstLine());
+  out.i32(loc.firstColumn());
+  out.i32(loc.lastLine());
+  out.i32(loc.lastColumn());
+  out.u32(out.pathIndex(loc.fileName()));
+}
+
+Location ASTSnapshot::readLocation(Reader& in)
+{
+  const auto first_line = in.i32();
+  const auto first_col = in.i32();
+  const auto last_line = in.i32();
+  const auto last_col = in.i32();
+  return {first_line, first_col, last_line, last_col, in.path(in.u32())};
+}
+
+void ASTSnapshot::writeAssignments(Writer& out, const AssignmentList& assignments)
+{
+  out.u32(static_cast<uint32_t>(assignments.size()));
+  for (const auto& assignment : assignments) {
+    // Annotations are only attached to the main file by the customizer
+    if (assignment->hasAnnotations()) throw UnsupportedError("annotated assignment");
+    out.str(assignment->getName());
+    writeLocation(out, assignment->location());
+    writeLocation(out, assignment->locationOfOverwrite());
+    writeExpression(out, assignment->getExpr().get());
+  }
+}
+
+AssignmentList ASTSnapshot::readAssignments(Reader& in)
+{
+  AssignmentList assignments;
+  const auto n = in.count();
+  assignments.reserve(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    auto name = in.str();
+    const auto loc = readLocation(in);
+    const auto locOfOverwrite = readLocation(in);
+    std::shared_ptr<Expression> expr = readExpression(in);
+    auto assignment = std::make_shared<Assignment>(std::move(name), std::move(expr), loc);
+    assignment->setLocationOfOverwrite(locOfOverwrite);
+    assignments.push_back(std::move(assignment));
+  }
+  return assignments;
+}
+
+void ASTSnapshot::writeExpression(Writer& out, const Expression *expr)
+{
+  if (!expr) {
+    out.u8(static_cast<uint8_t>(Tag::Null));
+    return;
+  }
+  const auto tag = [&](Tag t) {
+    out.u8(static_cast<uint8_t>(t));
+    writeLocation(out, expr->location());
+  };
+
+  if (const auto *e = dynamic_cast<const UnaryOp *>(expr)) {
+    tag(Tag::UnaryOp);
+    out.u8(static_cast<uint8_t>(e->op));
+    writeExpression(out, e->expr.get());
+  } else if (const auto *e = dynamic_cast<const BinaryOp *>(expr)) {
+    tag(Tag::BinaryOp);
+    out.u8(static_cast<uint8_t>(e->op));
+    writeExpression(out, e->left.get());
+    writeExpression(out, e->right.get());
+  } else if (const auto *e = dynamic_cast<const TernaryOp *>(expr)) {
+    tag(Tag::TernaryOp);
+    writeExpression(out, e->cond.get());
+    writeExpression(out, e->ifexpr.get());
+    writeExpression(out, e->elseexpr.get());
+  } else if (const auto *e = dynamic_cast<const ArrayLookup *>(expr)) {
+    tag(Tag::ArrayLookup);
+    writeExpression(out, e->array.get());
+    writeExpression(out, e->index.get());
+  } else if (const auto *e = dynamic_cast<const Literal *>(expr)) {
+    tag(Tag::Literal);
+    if (e->isUndefined()) {
+      out.u8(static_cast<uint8_t>(LiteralType::Undefined));
+    } else if (e->isBool()) {
+      out.u8(static_cast<uint8_t>(LiteralType::Bool));
+      out.u8(e->toBool());
+    } else if (e->isDouble()) {
+      out.u8(static_cast<uint8_t>(LiteralType::Number));
+      out.f64(e->toDouble());
+    } else if (e->isString()) {
+      out.u8(static_cast<uint8_t>(LiteralType::String));
+      out.str(e->toString());
+    } else {
+      throw UnsupportedError("literal type");
+    }
+  } else if (const auto *e = dynamic_cast<const Range *>(expr)) {
+    tag(Tag::Range);
+    writeExpression(out, e->getBegin());
+    writeExpression(out, e->getStep());
+    writeExpression(out, e->getEnd());
+  } else if (const auto *e = dynamic_cast<const Vector *>(expr)) {
+    tag(Tag::Vector);
+    out.u32(static_cast<uint32_t>(e->getChildren().size()));
+    for (const auto& child : e->getChildren()) writeExpression(out, child.get());
+  } else if (const auto *e = dynamic_cast<const Lookup *>(expr)) {
+    tag(Tag::Lookup);
+    out.str(e->get_name());
+  } else if (const auto *e = dynamic_cast<const MemberLookup *>(expr)) {
+    tag(Tag::MemberLookup);
+    writeExpression(out, e->expr.get());
+    out.str(e->member);
+  } else if (const auto *e = dynamic_cast<const FunctionCall *>(expr)) {
+    tag(Tag::FunctionCall);
+    writeExpression(out, e->expr.get());
+    writeAssignments(out, e->arguments);
+  } else if (const auto *e = dynamic_cast<const FunctionDefinition *>(expr)) {
+    tag(Tag::FunctionDefinition);
+    writeAssignments(out, e->parameters);
+    writeExpression(out, e->expr.get());
+  } else if (const auto *e = dynamic_cast<const Assert *>(expr)) {
+    tag(Tag::Assert);
+    writeAssignments(out, e->arguments);
+    writeExpression(out, e->expr.get());
+  } else if (const auto *e = dynamic_cast<const Echo *>(expr)) {
+    tag(Tag::Echo);
+    writeAssignments(out, e->arguments);
+    writeExpression(out, e->expr.get());
+  } else if (const auto *e = dynamic_cast<const Let *>(expr)) {
+    tag(Tag::Let);
+    writeAssignments(out, e->arguments);
+    writeExpression(out, e->expr.get());
+  } else if (const auto *e = dynamic_cast<const LcIf *>(expr)) {
+    tag(Tag::LcIf);
+    writeExpression(out, e->cond.get());
+    writeExpression(out, e->ifexpr.get());
+    writeExpression(out, e->elseexpr.get());
+  } else if (const auto *e = dynamic_cast<const LcFor *>(expr)) {
+    tag(Tag::LcFor);
+    writeAssignments(out, e->arguments);
+    writeExpression(out, e->expr.get());
+  } else if (const auto *e = dynamic_cast<const LcForC *>(expr)) {
+    tag(Tag::LcForC);
+    writeAssignments(out, e->arguments);
+    writeAssignments(out, e->incr_arguments);
+    writeExpression(out, e->cond.get());
+    writeExpression(out, e->expr.get());
+  } else if (const auto *e = dynamic_cast<const LcEach *>(expr)) {
+    tag(Tag::LcEach);
+    writeExpression(out, e->expr.get());
+  } else if (const auto *e = dynamic_cast<const LcLet *>(expr)) {
+    tag(Tag::LcLet);
+    writeAssignments(out, e->arguments);
+    writeExpression(out, e->expr.get());
+  } else {
+    throw UnsupportedError("expression type");
+  }
+}
+
+std::unique_ptr<Expression> ASTSnapshot::readExpression(Reader& in)
+{
+  const auto tag = static_cast<Tag>(in.u8());
+  if (tag == Tag::Null) return nullptr;
+  const auto loc = readLocation(in);
+
+  // Child expressions are owned by unique_ptrs until the parent takes them,
+  // so nothing leaks when a corrupt snapshot throws halfway through.
+  switch (tag) {
+  case Tag::UnaryOp: {
+    const auto op = in.u8();
+    if (op > static_cast<uint8_t>(UnaryOp::Op::Negate)) throw CorruptError();
+    auto expr = readExpression(in);
+    return std::make_unique<UnaryOp>(static_cast<UnaryOp::Op>(op), expr.release(), loc);
+  }
+  case Tag::BinaryOp: {
+    const auto op = in.u8();
+    if (op > static_cast<uint8_t>(BinaryOp::Op::NotEqual)) throw CorruptError();
+    auto left = readExpression(in);
+    auto right = readExpression(in);
+    return std::make_unique<BinaryOp>(left.release(), static_cast<BinaryOp::Op>(op), right.release(),
+                                      loc);
+  }
+  case Tag::TernaryOp: {
+    auto cond = readExpression(in);
+    auto ifexpr = readExpression(in);
+    auto elseexpr = readExpression(in);
+    return std::make_unique<TernaryOp>(cond.release(), ifexpr.release(), elseexpr.release(), loc);
+  }
+  case Tag::ArrayLookup: {
+    auto array = readExpression(in);
+    auto index = readExpression(in);
+    return std::make_unique<ArrayLookup>(array.release(), index.release(), loc);
+  }
+  case Tag::Literal:
+    switch (static_cast<LiteralType>(in.u8())) {
+    case LiteralType::Undefined: return std::make_unique<Literal>(loc);
+    case LiteralType::Bool:      return std::make_unique<Literal>(in.u8() != 0, loc);
+    case LiteralType::Number:    return std::make_unique<Literal>(in.f64(), loc);
+    case LiteralType::String:    return std::make_unique<Literal>(in.str(), loc);
+    default:                     throw CorruptError();
+    }
+  case Tag::Range: {
+    auto begin = readExpression(in);
+    auto step = readExpression(in);
+    auto end = readExpression(in);
+    if (!begin || !end) throw CorruptError();
+    return std::make_unique<Range>(begin.release(), step.release(), end.release(), loc);
+  }
+  case Tag::Vector: {
+    auto vector = std::make_unique<Vector>(loc);
+    const auto n = in.count();
+    for (uint32_t i = 0; i < n; ++i) vector->emplace_back(readExpression(in).release());
+    return vector;
+  }
+  case Tag::Lookup: return std::make_unique<Lookup>(in.str(), loc);
+  case Tag::MemberLookup: {
+    auto expr = readExpression(in);
+    return std::make_unique<MemberLookup>(expr.release(), in.str(), loc);
+  }
+  case Tag::FunctionCall: {
+    auto expr = readExpression(in);
+    if (!expr) throw CorruptError();
+    auto arguments = readAssignments(in);
+    return std::make_unique<FunctionCall>(expr.release(), std::move(arguments), loc);
+  }
+  case Tag::FunctionDefinition: {
+    auto parameters = readAssignments(in);
+    auto expr = readExpression(in);
+    return std::make_unique<FunctionDefinition>(expr.release(), std::move(parameters), loc);
+  }
+  case Tag::Assert: {
+    auto arguments = readAssignments(in);
+    auto expr = readExpression(in);
+    return std::make_unique<Assert>(std::move(arguments), expr.release(), loc);
+  }
+  case Tag::Echo: {
+    auto arguments = readAssignments(in);
+    auto expr = readExpression(in);
+    return std::make_unique<Echo>(std::move(arguments), expr.release(), loc);
+  }
+  case Tag::Let: {
+    auto arguments = readAssignments(in);
+    auto expr = readExpression(in);
+    return std::make_unique<Let>(std::move(arguments), expr.release(), loc);
+  }
+  case Tag::LcIf: {
+    auto cond = readExpression(in);
+    auto ifexpr = readExpression(in);
+    auto elseexpr = readExpression(in);
+    return std::make_unique<LcIf>(cond.release(), ifexpr.release(), elseexpr.release(), loc);
+  }
+  case Tag::LcFor: {
+    auto arguments = readAssignments(in);
+    auto expr = readExpression(in);
+    return std::make_unique<LcFor>(std::move(arguments), expr.release(), loc);
+  }
+  case Tag::LcForC: {
+    auto arguments = readAssignments(in);
+    auto incr_arguments = readAssignments(in);
+    auto cond = readExpression(in);
+    auto expr = readExpression(in);
+    return std::make_unique<LcForC>(std::move(arguments), std::move(incr_arguments), cond.release(),
+                                    expr.release(), loc);
+  }
+  case Tag::LcEach: {
+    auto expr = readExpression(in);
+    return std::make_unique<LcEach>(expr.release(), loc);
+  }
+  case Tag::LcLet: {
+    auto arguments = readAssignments(in);
+    auto expr = readExpression(in);
+    return std::make_unique<LcLet>(std::move(arguments), expr.release(), loc);
+  }
+  default: throw CorruptError();
+  }
+}
+
+void ASTSnapshot::writeModuleInstantiation(Writer& out, const ModuleInstantiation& inst)
+{
+  const auto *ifelse = dynamic_cast<const IfElseModuleInstantiation *>(&inst);
+  out.u8(ifelse ? 1 : 0);
+  out.str(inst.name());
+  writeLocation(out, inst.location());
+  writeAssignments(out, inst.arguments);
+  out.u8(inst.tag_root);
+  out.u8(inst.tag_highlight);
+  out.u8(inst.tag_background);
+  writeScope(out, *inst.scope);
+  if (ifelse) {
+    const auto else_scope = ifelse->getElseScope();
+    out.u8(else_scope ? 1 : 0);
+    if (else_scope) writeScope(out, *else_scope);
+  }
+}
+
+std::shared_ptr<ModuleInstantiation> ASTSnapshot::readModuleInstantiation(Reader& in)
+{
+  const bool is_ifelse = in.u8() != 0;
+  auto name = in.str();
+  const auto loc = readLocation(in);
+  auto arguments = readAssignments(in);
+
+  std::shared_ptr<ModuleInstantiation> inst;
+  std::shared_ptr<IfElseModuleInstantiation> ifelse;
+  if (is_ifelse) {
+    ifelse = std::make_shared<IfElseModuleInstantiation>(nullptr, loc);
+    ifelse->arguments = std::move(arguments);
+    inst = ifelse;
+  } else {
+    inst = std::make_shared<ModuleInstantiation>(std::move(name), std::move(arguments), loc);
+  }
+  inst->tag_root = in.u8() != 0;
+  inst->tag_highlight = in.u8() != 0;
+  inst->tag_background = in.u8() != 0;
+  readScope(in, *inst->scope);
+  if (ifelse && in.u8() != 0) readScope(in, *ifelse->makeElseScope());
+  return inst;
+}
+
+void ASTSnapshot::writeScope(Writer& out, const LocalScope& scope)
+{
+  writeAssignments(out, scope.assignments);
+
+  out.u32(static_cast<uint32_t>(scope.moduleInstantiations.size()));
+  for (const auto& inst : scope.moduleInstantiations) writeModuleInstantiation(out, *inst);
+
+  // Definitions are replayed in declaration order, so later ones shadow earlier ones just as
+  // when parsing
+  out.u32(static_cast<uint32_t>(scope.astModules.size()));
+  for (const auto& [name, module] : scope.astModules) {
+    out.str(module->name);
+    writeLocation(out, module->location());
+    writeAssignments(out, module->parameters);
+    writeScope(out, *module->body);
+  }
+
+  out.u32(static_cast<uint32_t>(scope.astFunctions.size()));
+  for (const auto& [name, function] : scope.astFunctions) {
+    out.str(function->name);
+    writeLocation(out, function->location());
+    writeAssignments(out, function->parameters);
+    writeExpression(out, function->expr.get());
+  }
+}
+
+void ASTSnapshot::readScope(Reader& in, LocalScope& scope)
+{
+  scope.assignments = readAssignments(in);
+
+  auto n = in.count();
+  for (uint32_t i = 0; i < n; ++i) scope.addModuleInst(readModuleInstantiation(in));
+
+  n = in.count();
+  for (uint32_t i = 0; i < n; ++i) {
+    const auto name = in.str();
+    const auto loc = readLocation(in);
+    auto module = std::make_shared<UserModule>(name.c_str(), loc);
+    module->parameters = readAssignments(in);
+    readScope(in, *module->body);
+    scope.addModule(module);
+  }
+
+  n = in.count();
+  for (uint32_t i = 0; i < n; ++i) {
+    const auto name = in.str();
+    const auto loc = readLocation(in);
+    auto parameters = readAssignments(in);
+    std::shared_ptr<Expression> expr = readExpression(in);
+    scope.addFunction(std::make_shared<UserFunction>(name.c_str(), parameters, std::move(expr), loc));
+  }
+}
+
+bool ASTSnapshot::write(const SourceFile& file, const fs::path& snapshot)
+{
+  Writer body;
+  Writer out;
+  try {
+    body.str(file.modulePath());
+    body.str(file.getFilename());
+    body.u32(static_cast<uint32_t>(file.usedlibs.size()));
+    for (const auto& lib : file.usedlibs) body.str(lib);
+    body.u32(static_cast<uint32_t>(file.usedfonts.size()));
+    for (const auto& font : file.usedfonts) body.str(font);
+    body.u32(static_cast<uint32_t>(file.indicatorData.size()));
+    for (const auto& indicator : file.indicatorData) {
+      body.i32(indicator.first_line);
+      body.i32(indicator.first_col);
+      body.i32(indicator.last_line);
+      body.i32(indicator.last_col);
+      body.str(indicator.path);
+    }
+    writeScope(body, *file.scope);
+
+    out.raw(MAGIC, sizeof(MAGIC));
+    out.u32(FORMAT_VERSION);
+    out.u32(BYTE_ORDER_MARK);
+    out.str(openscad_detailedversionnumber);
+    out.u32(static_cast<uint32_t>(file.includes.size()));
+    for (const auto& [localpath, fullpath] : file.includes) {
+      std::string contents;
+      if (!read_file(fullpath, contents)) return false;
+      out.str(localpath);
+      out.str(fullpath);
+      out.u64(hash(contents));
+    }
+    out.u32(static_cast<uint32_t>(body.paths.size()));
+    for (const auto& path : body.paths) out.str(path);
+  } catch (const UnsupportedError& e) {
+    PRINTDB("Not writing AST snapshot of %s: %s", file.getFullpath() % e.what());
+    return false;
+  }
+
+  // Write to a unique temporary file first so concurrent processes never see partial snapshots
+  std::error_code ec;
+  fs::create_directories(snapshot.parent_path(), ec);
+  auto tmp = snapshot;
+  tmp += STR(".", std::random_device{}(), ".tmp");
+  {
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) return false;
+    ofs.write(out.data.data(), static_cast<std::streamsize>(out.data.size()));
+    ofs.write(body.data.data(), static_cast<std::streamsize>(body.data.size()));
+    if (!ofs.good()) {
+      ofs.close();
+      fs::remove(tmp, ec);
+      return false;
+    }
+  }
+  fs::rename(tmp, snapshot, ec);
+  if (ec) {
+    fs::remove(tmp, ec);
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<SourceFile> ASTSnapshot::read(const fs::path& snapshot)
+{
+  std::error_code ec;
+  if (!fs::is_regular_file(snapshot, ec) || fs::file_size(snapshot, ec) == 0) return nullptr;
+
+  try {
+    const boost::interprocess::file_mapping mapping(snapshot.string().c_str(),
+                                                    boost::interprocess::read_only);
+    const boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+    const auto *begin = static_cast<const char *>(region.get_address());
+    Reader in(begin, begin + region.get_size());
+
+    char magic[sizeof(MAGIC)];
+    for (auto& c : magic) c = static_cast<char>(in.u8());
+    if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) return nullptr;
+    if (in.u32() != FORMAT_VERSION || in.u32() != BYTE_ORDER_MARK) return nullptr;
+    if (in.str() != openscad_detailedversionnumber) return nullptr;
+
+    std::unordered_map<std::string, std::string> includes;
+    auto n = in.count();
+    for (uint32_t i = 0; i < n; ++i) {
+      auto localpath = in.str();
+      auto fullpath = in.str();
+      const auto include_hash = in.u64();
+      std::string contents;
+      if (!read_file(fullpath, contents) || hash(contents) != include_hash) return nullptr;
+      includes.emplace(std::move(localpath), std::move(fullpath));
+    }
+
+    n = in.count();
+    in.paths.reserve(n);
+    for (uint32_t i = 0; i < n; ++i) in.paths.push_back(std::make_shared<fs::path>(in.str()));
+
+    auto path = in.str();
+    auto filename = in.str();
+    auto file = std::make_unique<SourceFile>(std::move(path), std::move(filename));
+    file->includes = std::move(includes);
+    n = in.count();
+    for (uint32_t i = 0; i < n; ++i) file->usedlibs.push_back(in.str());
+    n = in.count();
+    for (uint32_t i = 0; i < n; ++i) file->usedfonts.push_back(in.str());
+    n = in.count();
+    for (uint32_t i = 0; i < n; ++i) {
+      const auto first_line = in.i32();
+      const auto first_col = in.i32();
+      const auto last_line = in.i32();
+      const auto last_col = in.i32();
+      file->indicatorData.emplace_back(first_line, first_col, last_line, last_col, in.str());
+    }
+    readScope(in, *file->scope);
+    if (!in.atEnd()) return nullptr;
+    return file;
+  } catch (const std::exception&) {
+    // Includes CorruptError and failures to map the file
+    return nullptr;
+  }
+}
+
+void ASTSnapshot::registerDependencies(const SourceFile& file)
+{
+  for (const auto& include : file.includes) handle_dep(include.second);
+  for (const auto& lib : file.usedlibs) {
+    if (fs::path(lib).is_absolute()) handle_dep(lib);
+  }
+  for (const auto& font : file.usedfonts) FontCache::instance()->register_font_file(font);
+}
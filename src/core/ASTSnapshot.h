@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include "core/Assignment.h"
+#include "core/LocalScope.h"
+
+class Expression;
+class ModuleInstantiation;
+class SourceFile;
+
+namespace fs = std::filesystem;
+
+/*!
+   Binary on-disk snapshots of parsed library files.
+
+   A snapshot holds the complete AST of a file as produced by the parser, so
+   use<>'d and include<>'d libraries don't have to be re-lexed and re-parsed
+   on every run. Snapshots are stored in the configured directory under a key
+   derived from the OpenSCAD version, the file path and the text handed to
+   the parser (which includes any -D command line assignments). Since
+   include<> files are inlined by the lexer, their content hashes are stored
+   in the snapshot and verified on load.
+
+   Snapshots are only written for files which parsed without any warnings, as
+   those would otherwise be lost when loading the snapshot.
+ */
+class ASTSnapshot
+{
+public:
+  // An empty directory disables snapshots
+  static void setDirectory(const std::string& dir);
+  static const std::string& directory();
+  static bool enabled() { return !directory().empty(); }
+
+  static uint64_t hash(const std::string& data);
+  // Location of the snapshot for a file parsed from the given text
+  static fs::path snapshotPath(const std::string& filename, const std::string& text);
+
+  static bool write(const SourceFile& file, const fs::path& snapshot);
+  // Returns nullptr if the snapshot doesn't exist, is corrupt or out of date.
+  // Only touches the AST, so multiple snapshots can be read concurrently.
+  static std::unique_ptr<SourceFile> read(const fs::path& snapshot);
+  // Replays the side effects the lexer would have had while parsing the file
+  static void registerDependencies(const SourceFile& file);
+
+private:
+  class Writer;
+  class Reader;
+
+  static void writeLocation(Writer& out, const Location& loc);
+  static void writeExpression(Writer& out, const Expression *expr);
+  static void writeAssignments(Writer& out, const AssignmentList& assignments);
+  static void writeModuleInstantiation(Writer& out, const ModuleInstantiation& inst);
+  static void writeScope(Writer& out, const LocalScope& scope);
+
+  static Location readLocation(Reader& in);
+  static std::unique_ptr<Expression> readExpression(Reader& in);
+  static AssignmentList readAssignments(Reader& in);
+  static std::shared_ptr<ModuleInstantiation> readModuleInstantiation(Reader& in);
+  static void readScope(Reader& in, LocalScope& scope);
+};
@@ -26,6 +26,7 @@
 
 #include "core/Arguments.h"
 
+#include <cassert>
 #include <ostream>
 #include <memory>
 #include "core/Context.h"
@@ -44,6 +45,22 @@ Arguments::Arguments(const AssignmentList& argument_expressions,
   }
 }
 
+Arguments::Arguments(const AssignmentList& argument_expressions, std::vector<Value>& values,
+                     EvaluationSession *session)
+  : evaluation_session(session)
+{
+  assert(values.size() >= argument_expressions.size());
+  const auto first = values.end() - argument_expressions.size();
+  auto value = first;
+  for (const auto& argument_expression : argument_expressions) {
+    emplace_back(argument_expression->getName().empty()
+                   ? boost::none
+                   : boost::optional<std::string>(argument_expression->getName()),
+                 std::move(*value++));
+  }
+  values.erase(first, values.end());
+}
+
 Arguments Arguments::clone() const
 {
   Arguments output(evaluation_session);
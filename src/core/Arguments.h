@@ -34,6 +34,9 @@ class Arguments : public std::vector<Argument>
 {
 public:
   Arguments(const AssignmentList& argument_expressions, const std::shared_ptr<const Context>& context);
+  // Takes the values of argument_expressions, already evaluated in order, from the end of values
+  Arguments(const AssignmentList& argument_expressions, std::vector<Value>& values,
+            EvaluationSession *session);
   Arguments(Arguments&& other) = default;
   Arguments& operator=(Arguments&& other) = default;
   Arguments(const Arguments& other) = delete;
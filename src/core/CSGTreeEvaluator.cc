@@ -47,9 +47,7 @@ std::shared_ptr<CSGNode> CSGTreeEvaluator::buildCSGTree(const AbstractNode& node
 
 void CSGTreeEvaluator::applyBackgroundAndHighlight(State& /*state*/, const AbstractNode& node)
 {
-  for (const auto& chnode : this->visitedchildren[node.index()]) {
-    std::shared_ptr<CSGNode> t(this->stored_term[chnode->index()]);
-    this->stored_term.erase(chnode->index());
+  for (const auto& t : this->visitedchildren[node.index()]) {
     if (t) {
       if (t->isBackground()) this->backgroundNodes.push_back(t);
       if (t->isHighlight()) this->highlightNodes.push_back(t);
@@ -66,9 +64,7 @@ void CSGTreeEvaluator::applyToChildren(State& state, const AbstractNode& node, O
   }
 
   std::shared_ptr<CSGNode> t1;
-  for (const auto& chnode : vc) {
-    std::shared_ptr<CSGNode> t2(this->stored_term[chnode->index()]);
-    this->stored_term.erase(chnode->index());
+  for (const auto& t2 : vc) {
     if (t2 && !t1) {
       t1 = t2;
     } else if (t2 && t1) {
@@ -157,9 +153,10 @@ Response CSGTreeEvaluator::visit(State& state, const class ListNode& node)
       if (node.modinst->isBackground()) state.setBackground(true);
     }
     if (state.isPostfix()) {
-      for (auto& chnode : this->visitedchildren[node.index()]) {
-        addToParent(state, *chnode);
+      for (const auto& t : this->visitedchildren[node.index()]) {
+        this->visitedchildren[state.parent()->index()].push_back(t);
       }
+      this->visitedchildren.erase(node.index());
     }
     return Response::ContinueTraversal;
   } else {
@@ -348,6 +345,14 @@ void CSGTreeEvaluator::addToParent(const State& state, const AbstractNode& node)
 {
   this->visitedchildren.erase(node.index());
   if (state.parent()) {
-    this->visitedchildren[state.parent()->index()].push_back(node.shared_from_this());
+    // The term is handed over right away, since a node shared by several parents (see children())
+    // gets a different term in each place
+    const auto term = this->stored_term.find(node.index());
+    if (term != this->stored_term.end()) {
+      this->visitedchildren[state.parent()->index()].push_back(term->second);
+      this->stored_term.erase(term);
+    } else {
+      this->visitedchildren[state.parent()->index()].push_back(nullptr);
+    }
   }
 }
@@ -53,7 +53,8 @@ private:
                                                        const AbstractNode& node);
   void applyBackgroundAndHighlight(State& state, const AbstractNode& node);
 
-  using ChildList = std::list<std::shared_ptr<const AbstractNode>>;
+  // The terms of the visited children of each node index
+  using ChildList = std::list<std::shared_ptr<CSGNode>>;
   std::map<int, ChildList> visitedchildren;
 
 protected:
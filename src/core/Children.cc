@@ -26,13 +26,53 @@
 
 #include "core/Children.h"
 
+#include <algorithm>
+#include <cassert>
 #include <memory>
 #include <cstddef>
+#include <optional>
 #include <vector>
 
 #include "core/Context.h"
+#include "core/EvaluationSession.h"
 #include "core/LocalScope.h"
+#include "core/ModuleInstantiation.h"
+#include "core/node.h"
 #include "core/ScopeContext.h"
+#include "core/UserModule.h"
+#include "utils/printutils.h"
+
+namespace {
+
+// Instantiations kept per child, e.g. for different values of $fn
+constexpr size_t MAX_CACHED_VARIANTS = 8;
+
+bool unchanged(const EvaluationSession& session, const SpecialVariableReads& reads)
+{
+  return std::all_of(reads.variables.begin(), reads.variables.end(), [&](const auto& variable) {
+    const auto current = session.try_lookup_special_variable(variable.first);
+    if (!current || !variable.second) return !current && !variable.second;
+    return (*current == *variable.second).toBool();
+  });
+}
+
+}  // namespace
+
+/*
+   Instantiations of the children of a single user module call. The children are
+   always evaluated in the same lexical context, so the resulting nodes only
+   depend on the special variables they read, and on the module call stack
+   through $parent_modules. Nodes are immutable once instantiated, so repeated
+   children() calls can share them.
+ */
+struct Children::InstantiationCache {
+  struct Variant {
+    SpecialVariableReads reads;
+    int module_depth;
+    std::shared_ptr<AbstractNode> node;
+  };
+  std::vector<std::vector<Variant>> children;
+};
 
 std::shared_ptr<AbstractNode> Children::instantiate(const std::shared_ptr<AbstractNode>& target) const
 {
@@ -42,7 +82,51 @@ std::shared_ptr<AbstractNode> Children::instantiate(const std::shared_ptr<Abstra
 std::shared_ptr<AbstractNode> Children::instantiate(const std::shared_ptr<AbstractNode>& target,
                                                     const std::vector<size_t>& indices) const
 {
-  return children_scope->instantiateModules(*scopeContext(), target, indices);
+  // Assignments in the children scope are evaluated for every call, which the cache can't track
+  if (!children_scope->assignments.empty()) {
+    return children_scope->instantiateModules(*scopeContext(), target, indices);
+  }
+  if (!cache) {
+    cache = std::make_shared<InstantiationCache>();
+    cache->children.resize(size());
+  }
+
+  auto *session = context->session();
+  const int module_depth = StaticModuleNameStack::size();
+  std::optional<ContextHandle<ScopeContext>> scope;  // only needed if something has to be evaluated
+  for (size_t index : indices) {
+    assert(index < this->size());
+    auto& variants = cache->children[index];
+    const auto cached = std::find_if(variants.begin(), variants.end(), [&](const auto& variant) {
+      return variant.module_depth == module_depth && unchanged(*session, variant.reads);
+    });
+    if (cached != variants.end()) {
+      if (cached->node) target->children.push_back(cached->node);
+      continue;
+    }
+
+    if (!scope) scope.emplace(scopeContext());
+    InstantiationCache::Variant variant{{}, module_depth, nullptr};
+    print_messages_push();
+    session->begin_recording(&variant.reads);
+    try {
+      variant.node = children_scope->moduleInstantiations[index]->evaluate(**scope);
+    } catch (...) {
+      session->end_recording();
+      print_messages_pop();
+      throw;
+    }
+    session->end_recording();
+    // Messages (e.g. from echo()) would be lost when reusing the nodes
+    const bool silent = print_messages_stack.back().empty();
+    print_messages_pop();
+
+    if (variant.node) target->children.push_back(variant.node);
+    if (silent && variant.reads.cacheable && variants.size() < MAX_CACHED_VARIANTS) {
+      variants.push_back(std::move(variant));
+    }
+  }
+  return target;
 }
 
 ContextHandle<ScopeContext> Children::scopeContext() const
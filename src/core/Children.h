@@ -29,6 +29,8 @@ public:
   // NOLINTBEGIN(modernize-use-nodiscard)
   // instantiate just returns a copy of target shared_ptr as a convenience, not crucial to use this value
   std::shared_ptr<AbstractNode> instantiate(const std::shared_ptr<AbstractNode>& target) const;
+  // Children instantiated by an earlier call which saw the same special variables are
+  // shared instead of being evaluated again, see children()
   std::shared_ptr<AbstractNode> instantiate(const std::shared_ptr<AbstractNode>& target,
                                             const std::vector<size_t>& indices) const;
   // NOLINTEND(modernize-use-nodiscard)
@@ -38,8 +40,11 @@ public:
   [[nodiscard]] const std::shared_ptr<const Context>& getContext() const { return context; }
 
 private:
+  struct InstantiationCache;
+
   std::shared_ptr<const LocalScope> children_scope;
   std::shared_ptr<const Context> context;
+  mutable std::shared_ptr<InstantiationCache> cache;
 
   [[nodiscard]] ContextHandle<ScopeContext> scopeContext() const;
 };
@@ -26,6 +26,8 @@
 
 #include "core/EvaluationSession.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <string>
@@ -34,11 +36,14 @@
 #include "core/ContextFrame.h"
 #include "core/function.h"
 #include "core/module.h"
+#include "core/progress.h"
 #include "core/Value.h"
 #include "utils/printutils.h"
 
 size_t EvaluationSession::push_frame(ContextFrame *frame)
 {
+  // Every function call and module instantiation passes through here
+  if (canceled && canceled->load(std::memory_order_relaxed)) throw ProgressCancelException();
   size_t index = stack.size();
   stack.push_back(frame);
   return index;
@@ -59,12 +64,14 @@ void EvaluationSession::pop_frame(size_t index)
 boost::optional<const Value&> EvaluationSession::try_lookup_special_variable(
   const std::string& name) const
 {
-  for (auto it = stack.crbegin(); it != stack.crend(); ++it) {
-    boost::optional<const Value&> result = (*it)->lookup_local_variable(name);
+  for (size_t i = stack.size(); i-- > 0;) {
+    boost::optional<const Value&> result = stack[i]->lookup_local_variable(name);
     if (result) {
+      if (!recordings.empty()) record_read(name, result, i);
       return result;
     }
   }
+  if (!recordings.empty()) record_read(name, boost::none, 0);
   return boost::none;
 }
 
@@ -82,6 +89,7 @@ const Value& EvaluationSession::lookup_special_variable(const std::string& name,
 boost::optional<CallableFunction> EvaluationSession::lookup_special_function(const std::string& name,
                                                                              const Location& loc) const
 {
+  mark_uncacheable();
   for (auto it = stack.crbegin(); it != stack.crend(); ++it) {
     boost::optional<CallableFunction> result = (*it)->lookup_local_function(name, loc);
     if (result) {
@@ -95,6 +103,7 @@ boost::optional<CallableFunction> EvaluationSession::lookup_special_function(con
 boost::optional<InstantiableModule> EvaluationSession::lookup_special_module(const std::string& name,
                                                                              const Location& loc) const
 {
+  mark_uncacheable();
   for (auto it = stack.crbegin(); it != stack.crend(); ++it) {
     boost::optional<InstantiableModule> result = (*it)->lookup_local_module(name, loc);
     if (result) {
@@ -104,3 +113,31 @@ boost::optional<InstantiableModule> EvaluationSession::lookup_special_module(con
   LOG(message_group::Warning, loc, documentRoot(), "Ignoring unknown module '%1$s'", name);
   return boost::none;
 }
+
+void EvaluationSession::begin_recording(SpecialVariableReads *reads)
+{
+  reads->stack_depth = stack.size();
+  recordings.push_back(reads);
+}
+
+void EvaluationSession::end_recording() { recordings.pop_back(); }
+
+void EvaluationSession::mark_uncacheable() const
+{
+  for (auto *reads : recordings) reads->cacheable = false;
+}
+
+void EvaluationSession::record_read(const std::string& name, const boost::optional<const Value&>& value,
+                                    size_t frame) const
+{
+  for (auto *reads : recordings) {
+    // Variables found in frames pushed during the recording aren't inputs
+    if (value && frame >= reads->stack_depth) continue;
+    const auto& variables = reads->variables;
+    const bool known = std::any_of(variables.begin(), variables.end(),
+                                   [&](const auto& variable) { return variable.first == name; });
+    if (!known) {
+      reads->variables.emplace_back(name, value ? boost::make_optional(value->clone()) : boost::none);
+    }
+  }
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <cstddef>
 #include <string>
 #include <utility>
@@ -8,10 +9,22 @@
 
 #include "core/callables.h"
 #include "core/ContextMemoryManager.h"  // FIXME: don't use as value type so we don't need to include header
+#include "core/Value.h"
 
-class Value;
 class ContextFrame;
 
+/*
+   The special variables read by a part of the evaluation from frames which were
+   already on the stack when it started, i.e. its dynamic inputs. Variables that
+   weren't found are recorded as none.
+ */
+struct SpecialVariableReads {
+  size_t stack_depth{0};
+  // False if the evaluation depended on anything else, e.g. printed messages or used rands()
+  bool cacheable{true};
+  std::vector<std::pair<std::string, boost::optional<Value>>> variables;
+};
+
 class EvaluationSession
 {
 public:
@@ -28,12 +41,25 @@ public:
   [[nodiscard]] boost::optional<InstantiableModule> lookup_special_module(const std::string& name,
                                                                           const Location& loc) const;
 
+  // Records into reads until the matching end_recording(). Recordings may be nested.
+  void begin_recording(SpecialVariableReads *reads);
+  void end_recording();
+  // The current evaluation can't be replayed from its special variables alone
+  void mark_uncacheable() const;
+  // Evaluation throws ProgressCancelException once *canceled becomes true
+  void setCancellationToken(const std::atomic<bool> *canceled) { this->canceled = canceled; }
+
   [[nodiscard]] const std::string& documentRoot() const { return document_root; }
   ContextMemoryManager& contextMemoryManager() { return context_memory_manager; }
   HeapSizeAccounting& accounting() { return context_memory_manager.accounting(); }
 
 private:
+  void record_read(const std::string& name, const boost::optional<const Value&>& value,
+                   size_t frame) const;
+
   std::string document_root;
   std::vector<ContextFrame *> stack;
+  std::vector<SpecialVariableReads *> recordings;
+  const std::atomic<bool> *canceled{nullptr};
   ContextMemoryManager context_memory_manager;
 };
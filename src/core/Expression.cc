@@ -32,12 +32,15 @@
 #include <cmath>
 #include <cassert>
 #include <cstddef>
+#include <deque>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <algorithm>
 #include <typeinfo>
 #include <utility>
 #include <variant>
+#include <vector>
 
 #include "Feature.h"
 #include "core/Context.h"
@@ -48,6 +51,7 @@
 
 #include "utils/compiler_specific.h"
 #include "utils/printutils.h"
+#include "utils/Profiler.h"
 #include "utils/StackCheck.h"
 #include "utils/exceptions.h"
 #include "utils/printutils.h"
@@ -65,17 +69,39 @@ Value Expression::checkUndef(Value&& val, const std::shared_ptr<const Context>&
 
 bool Expression::isLiteral() const { return false; }
 
+bool Expression::mayPrint() const { return true; }
+
+namespace {
+
+bool mayPrint(const std::shared_ptr<Expression>& expression)
+{
+  return expression && expression->mayPrint();
+}
+
+bool mayPrint(const AssignmentList& assignments)
+{
+  return std::any_of(assignments.begin(), assignments.end(),
+                     [](const auto& assignment) { return mayPrint(assignment->getExpr()); });
+}
+
+}  // namespace
+
 UnaryOp::UnaryOp(UnaryOp::Op op, Expression *expr, const Location& loc)
   : Expression(loc), op(op), expr(expr)
 {
 }
 
 Value UnaryOp::evaluate(const std::shared_ptr<const Context>& context) const
+{
+  return apply(this->expr->evaluate(context), context);
+}
+
+Value UnaryOp::apply(Value&& operand, const std::shared_ptr<const Context>& context) const
 {
   switch (this->op) {
-  case (Op::Not):       return !this->expr->evaluate(context).toBool();
-  case (Op::Negate):    return checkUndef(-this->expr->evaluate(context), context);
-  case (Op::BinaryNot): return checkUndef(~this->expr->evaluate(context), context);
+  case (Op::Not):       return !operand.toBool();
+  case (Op::Negate):    return checkUndef(-operand, context);
+  case (Op::BinaryNot): return checkUndef(~operand, context);
   default:
     assert(false && "Non-existent unary operator!");
     throw EvaluationException("Non-existent unary operator!");
@@ -96,6 +122,8 @@ const char *UnaryOp::opString() const
 
 bool UnaryOp::isLiteral() const { return this->expr->isLiteral(); }
 
+bool UnaryOp::mayPrint() const { return this->expr->mayPrint(); }
+
 void UnaryOp::print(std::ostream& stream, const std::string&) const
 {
   stream << opString() << *this->expr;
@@ -113,38 +141,33 @@ Value BinaryOp::evaluate(const std::shared_ptr<const Context>& context) const
     return this->left->evaluate(context).toBool() && this->right->evaluate(context).toBool();
   case Op::LogicalOr:
     return this->left->evaluate(context).toBool() || this->right->evaluate(context).toBool();
-  case Op::Exponent:
-    return checkUndef(this->left->evaluate(context) ^ this->right->evaluate(context), context);
-  case Op::Multiply:
-    return checkUndef(this->left->evaluate(context) * this->right->evaluate(context), context);
-  case Op::Divide:
-    return checkUndef(this->left->evaluate(context) / this->right->evaluate(context), context);
-  case Op::Modulo:
-    return checkUndef(this->left->evaluate(context) % this->right->evaluate(context), context);
-  case Op::Plus:
-    return checkUndef(this->left->evaluate(context) + this->right->evaluate(context), context);
-  case Op::Minus:
-    return checkUndef(this->left->evaluate(context) - this->right->evaluate(context), context);
-  case Op::ShiftLeft:
-    return checkUndef(this->left->evaluate(context) << this->right->evaluate(context), context);
-  case Op::ShiftRight:
-    return checkUndef(this->left->evaluate(context) >> this->right->evaluate(context), context);
-  case Op::BinaryAnd:
-    return checkUndef(this->left->evaluate(context) & this->right->evaluate(context), context);
-  case Op::BinaryOr:
-    return checkUndef(this->left->evaluate(context) | this->right->evaluate(context), context);
-  case Op::Less:
-    return checkUndef(this->left->evaluate(context) < this->right->evaluate(context), context);
-  case Op::LessEqual:
-    return checkUndef(this->left->evaluate(context) <= this->right->evaluate(context), context);
-  case Op::Greater:
-    return checkUndef(this->left->evaluate(context) > this->right->evaluate(context), context);
-  case Op::GreaterEqual:
-    return checkUndef(this->left->evaluate(context) >= this->right->evaluate(context), context);
-  case Op::Equal:
-    return checkUndef(this->left->evaluate(context) == this->right->evaluate(context), context);
-  case Op::NotEqual:
-    return checkUndef(this->left->evaluate(context) != this->right->evaluate(context), context);
+  default: {
+    Value left = this->left->evaluate(context);
+    return apply(std::move(left), this->right->evaluate(context), context);
+  }
+  }
+}
+
+// Applies all but the logical operators, which don't always evaluate their right operand
+Value BinaryOp::apply(Value&& left, Value&& right, const std::shared_ptr<const Context>& context) const
+{
+  switch (this->op) {
+  case Op::Exponent:     return checkUndef(left ^ right, context);
+  case Op::Multiply:     return checkUndef(left * right, context);
+  case Op::Divide:       return checkUndef(left / right, context);
+  case Op::Modulo:       return checkUndef(left % right, context);
+  case Op::Plus:         return checkUndef(left + right, context);
+  case Op::Minus:        return checkUndef(left - right, context);
+  case Op::ShiftLeft:    return checkUndef(left << right, context);
+  case Op::ShiftRight:   return checkUndef(left >> right, context);
+  case Op::BinaryAnd:    return checkUndef(left & right, context);
+  case Op::BinaryOr:     return checkUndef(left | right, context);
+  case Op::Less:         return checkUndef(left < right, context);
+  case Op::LessEqual:    return checkUndef(left <= right, context);
+  case Op::Greater:      return checkUndef(left > right, context);
+  case Op::GreaterEqual: return checkUndef(left >= right, context);
+  case Op::Equal:        return checkUndef(left == right, context);
+  case Op::NotEqual:     return checkUndef(left != right, context);
   default:
     assert(false && "Non-existent binary operator!");
     throw EvaluationException("Non-existent binary operator!");
@@ -178,6 +201,8 @@ const char *BinaryOp::opString() const
   }
 }
 
+bool BinaryOp::mayPrint() const { return this->left->mayPrint() || this->right->mayPrint(); }
+
 void BinaryOp::print(std::ostream& stream, const std::string&) const
 {
   stream << "(" << *this->left << " " << opString() << " " << *this->right << ")";
@@ -198,6 +223,11 @@ Value TernaryOp::evaluate(const std::shared_ptr<const Context>& context) const
   return evaluateStep(context)->evaluate(context);
 }
 
+bool TernaryOp::mayPrint() const
+{
+  return this->cond->mayPrint() || this->ifexpr->mayPrint() || this->elseexpr->mayPrint();
+}
+
 void TernaryOp::print(std::ostream& stream, const std::string&) const
 {
   stream << "(" << *this->cond << " ? " << *this->ifexpr << " : " << *this->elseexpr << ")";
@@ -208,11 +238,58 @@ ArrayLookup::ArrayLookup(Expression *array, Expression *index, const Location& l
 {
 }
 
+namespace {
+
+// Keeps only the element at one index of the elements it's passed
+class IndexSink : public FlatElementSink
+{
+public:
+  IndexSink(uint32_t index) : index(index) {}
+  const uint32_t index;
+  uint32_t count = 0;
+  Value found = Value::undefined.clone();
+
+protected:
+  void element(Value&& value) override
+  {
+    if (count++ == index) found = std::move(value);
+  }
+};
+
+}  // namespace
+
+/*
+   The array, if it's a list comprehension the element can be picked out of while it's generated.
+   That needs the index before the elements, so it's only done when the order can't be told apart:
+   when generating the elements can't print anything and the index is a literal or a variable.
+ */
+const Vector *ArrayLookup::streamedArray() const
+{
+  const auto *vector = dynamic_cast<const Vector *>(this->array.get());
+  if (!vector || !vector->hasComprehensions() || vector->mayPrint()) return nullptr;
+  if (!this->index->isLiteral() && !dynamic_cast<const Lookup *>(this->index.get())) return nullptr;
+  return vector;
+}
+
 Value ArrayLookup::evaluate(const std::shared_ptr<const Context>& context) const
 {
+  const Vector *vector = streamedArray();
+  // An unknown variable is warned about, which has to come after the warnings of the elements
+  const auto *lookup = dynamic_cast<const Lookup *>(this->index.get());
+  if (vector && (!lookup || context->try_lookup_variable(lookup->get_name()))) {
+    Value index = this->index->evaluate(context);
+    if (index.type() != Value::Type::NUMBER) return vector->evaluate(context)[index];
+    // All elements are still evaluated, for their warnings, but only one is kept
+    IndexSink sink(convert_to_uint32(index.toDouble()));
+    vector->generate(context, sink);
+    if (sink.index < sink.count) return std::move(sink.found);
+    return Value::undef(STR("index ", sink.index, " out of bounds for vector of size ", sink.count));
+  }
   return this->array->evaluate(context)[this->index->evaluate(context)];
 }
 
+bool ArrayLookup::mayPrint() const { return this->array->mayPrint() || this->index->mayPrint(); }
+
 void ArrayLookup::print(std::ostream& stream, const std::string&) const
 {
   stream << *array << "[" << *index << "]";
@@ -271,6 +348,11 @@ Value Range::evaluate(const std::shared_ptr<const Context>& context) const
   return RangeType(begin_val, step_val, end_val);
 }
 
+bool Range::mayPrint() const
+{
+  return this->begin->mayPrint() || ::mayPrint(this->step) || this->end->mayPrint();
+}
+
 void Range::print(std::ostream& stream, const std::string&) const
 {
   stream << "[" << *this->begin;
@@ -285,7 +367,7 @@ bool Range::isLiteral() const
                     : begin->isLiteral() && end->isLiteral();
 }
 
-Vector::Vector(const Location& loc) : Expression(loc), literal_flag(unknown) {}
+Vector::Vector(const Location& loc) : Expression(loc), literal_flag(unknown), print_flag(unknown) {}
 
 bool Vector::isLiteral() const
 {
@@ -303,26 +385,69 @@ bool Vector::isLiteral() const
   }
 }
 
-void Vector::emplace_back(Expression *expr) { this->children.emplace_back(expr); }
+void Vector::emplace_back(Expression *expr)
+{
+  if (dynamic_cast<const ListComprehension *>(expr)) has_comprehensions = true;
+  this->children.emplace_back(expr);
+}
 
-Value Vector::evaluate(const std::shared_ptr<const Context>& context) const
+void FlatElementSink::add(Value&& value)
 {
-  if (children.size() == 1) {
-    Value val = children.front()->evaluate(context);
-    // If only 1 EmbeddedVectorType, convert to plain VectorType
-    if (val.type() == Value::Type::EMBEDDED_VECTOR) {
-      return VectorType(std::move(val.toEmbeddedVectorNonConst()));
-    } else {
-      VectorType vec(context->session());
-      vec.emplace_back(std::move(val));
-      return std::move(vec);
-    }
+  if (value.type() == Value::Type::EMBEDDED_VECTOR) {
+    for (const auto& v : value.toEmbeddedVector()) element(v.clone());
   } else {
-    VectorType vec(context->session());
-    vec.reserve(this->children.size());
+    element(std::move(value));
+  }
+}
+
+namespace {
+
+// Appends the elements to a vector, embedding the vectors of "each" as they are
+class VectorSink : public ElementSink
+{
+public:
+  VectorSink(VectorType& vec) : vec(vec) {}
+  void add(Value&& value) override { vec.emplace_back(std::move(value)); }
+  void reserve(size_t count) override { vec.reserve(vec.size() + count); }
+
+private:
+  VectorType& vec;
+};
+
+}  // namespace
+
+Value Vector::evaluate(const std::shared_ptr<const Context>& context) const
+{
+  VectorType vec(context->session());
+  vec.reserve(this->children.size());
+  if (!has_comprehensions) {
     for (const auto& e : this->children) vec.emplace_back(e->evaluate(context));
     return std::move(vec);
   }
+  // List comprehensions append their elements straight into the result, so it doesn't need flattening
+  VectorSink sink(vec);
+  generate(context, sink);
+  return std::move(vec);
+}
+
+void Vector::generate(const std::shared_ptr<const Context>& context, ElementSink& out) const
+{
+  for (const auto& e : this->children) {
+    if (const auto *lc = dynamic_cast<const ListComprehension *>(e.get())) {
+      lc->generate(context, out);
+    } else {
+      out.add(e->evaluate(context));
+    }
+  }
+}
+
+bool Vector::mayPrint() const
+{
+  if (unknown(print_flag)) {
+    print_flag = std::any_of(this->children.begin(), this->children.end(),
+                             [](const auto& e) { return e->mayPrint(); });
+  }
+  return bool(print_flag);
 }
 
 void Vector::print(std::ostream& stream, const std::string&) const
@@ -389,12 +514,14 @@ Value MemberLookup::evaluate(const std::shared_ptr<const Context>& context) cons
     if (this->member == "step") return v[1];
     if (this->member == "end") return v[2];
     break;
-  case Value::Type::OBJECT: return v[this->member];
+  case Value::Type::OBJECT: return v.toObject().get(this->member, this->key_cache).clone();
   default:                  break;
   }
   return Value::undefined.clone();
 }
 
+bool MemberLookup::mayPrint() const { return this->expr->mayPrint(); }
+
 void MemberLookup::print(std::ostream& stream, const std::string&) const
 {
   stream << *this->expr << "." << this->member;
@@ -486,126 +613,334 @@ boost::optional<CallableFunction> FunctionCall::evaluate_function_expression(
   }
 }
 
-struct SimplifiedExpression {
-  const Expression *expression;
-  boost::optional<ContextHandle<Context>> new_context = boost::none;
-  boost::optional<const FunctionCall *> new_active_function_call = boost::none;
+/**
+ * Evaluates function calls with explicit stacks on the heap instead of recursing on the native
+ * stack, so the depth of recursive functions is limited by the memory the calls in progress take,
+ * up to CALL_STACK_MEMORY, rather than by the size of the native stack.
+ *
+ * The evaluation steps of operators, ternaries, let, assert, echo, indexing and function calls
+ * are tasks on one stack, and their operands are values on another. Everything else, like list
+ * literals and comprehensions, is evaluated by its own evaluate(), which is still guarded by
+ * StackCheck. That also keeps lists, objects and closures from nesting deeper than the passes
+ * over them afterwards, like echo and destruction, can handle on the native stack.
+ *
+ * Each call gets a scope which holds its context. A call in tail position, i.e. when all
+ * that is left to do in the current scope is to end it, replaces the context of the scope
+ * instead, so tail recursion runs in constant space.
+ *
+ * There is one evaluator per thread. Function calls evaluated natively from within it, like
+ * the elements of a list, continue on top of its stacks, so they are only allocated once.
+ */
+class FunctionEvaluator
+{
+public:
+  // Memory of the stacks, beyond which recursion is reported as an error
+  static constexpr size_t MAX_STACK_MEMORY = size_t{CALL_STACK_MEMORY};
+
+  static FunctionEvaluator& inst()
+  {
+    thread_local FunctionEvaluator instance;
+    return instance;
+  }
+
+  Value evaluate(const FunctionCall *call, const std::shared_ptr<const Context>& context);
+
+private:
+  enum class Step {
+    Evaluate,  // expression
+    Unary,     // apply UnaryOp to the last value
+    Binary,    // apply BinaryOp to the last two values
+    Logical,   // short circuit LogicalAnd or LogicalOr on the last value
+    ToBool,    // convert the last value to a boolean
+    Branch,    // continue with a branch of TernaryOp, depending on the last value
+    Index,     // apply ArrayLookup to the last two values
+    Builtin,   // call a BuiltinFunction with the values of the arguments of a call
+    EndScope,  // close the innermost scope
+  };
+  struct Task {
+    Step step;
+    const Expression *expression;
+    const BuiltinFunction *builtin = nullptr;
+  };
+  struct Scope {
+    Scope(ContextHandle<Context>&& context, const FunctionCall *call)
+      : context(std::move(context)), call(call)
+    {
+    }
+    ContextHandle<Context> context;
+    // The call whose body is evaluated in this scope, none for let
+    const FunctionCall *call;
+    unsigned int tail_calls = 0;
+    // Only allocated while profiling, since there can be hundreds of thousands of scopes
+    std::unique_ptr<Profiler::Scope> profile;
+  };
+
+  FunctionEvaluator() = default;
+  void evaluateStep(const Expression *expression);
+  void openScope(ContextHandle<Context>&& context, const FunctionCall *call);
+  void replaceScope(ContextHandle<Context>&& context, const FunctionCall *call,
+                    const Expression *body);
+  void evaluateCall(const FunctionCall *call, const std::shared_ptr<const Context>& context);
+  // Only called while evaluating, when the innermost EndScope task is one of this evaluation
+  [[nodiscard]] bool inTailPosition() const { return tasks.back().step == Step::EndScope; }
+  [[nodiscard]] size_t stackMemory() const;
+
+  std::vector<Task> tasks;
+  std::vector<Value> values;
+  // A deque so scopes don't have to be moved, and are destroyed in the opposite order of creation
+  std::deque<Scope> scopes;
 };
-using SimplificationResult = std::variant<SimplifiedExpression, Value>;
 
-static SimplificationResult simplify_function_body(const Expression *expression,
-                                                   const std::shared_ptr<const Context>& context)
+size_t FunctionEvaluator::stackMemory() const
 {
-  if (!expression) {
-    return Value::undefined.clone();
-  } else {
-    const auto& type = typeid(*expression);
-    if (type == typeid(TernaryOp)) {
-      const auto *ternary = static_cast<const TernaryOp *>(expression);
-      return SimplifiedExpression{ternary->evaluateStep(context)};
-    } else if (type == typeid(Assert)) {
-      const auto *assertion = static_cast<const Assert *>(expression);
-      return SimplifiedExpression{assertion->evaluateStep(context)};
-    } else if (type == typeid(Echo)) {
-      const Echo *echo = static_cast<const Echo *>(expression);
-      return SimplifiedExpression{echo->evaluateStep(context)};
-    } else if (type == typeid(Let)) {
-      const Let *let = static_cast<const Let *>(expression);
-      ContextHandle<Context> let_context{Context::create<Context>(context)};
-      let_context->apply_config_variables(*context);
-      return SimplifiedExpression{let->evaluateStep(let_context), std::move(let_context)};
-    } else if (type == typeid(FunctionCall)) {
-      const auto *call = static_cast<const FunctionCall *>(expression);
-
-      const Expression *function_body;
-      const AssignmentList *required_parameters;
-      std::shared_ptr<const Context> defining_context;
-
-      auto f = call->evaluate_function_expression(context);
-      if (!f) {
-        return Value::undefined.clone();
-      } else {
-        auto index = f->index();
-        if (index == 0) {
-          return std::get<const BuiltinFunction *>(*f)->evaluate(context, call);
-        } else if (index == 1) {
-          CallableUserFunction callable = std::get<CallableUserFunction>(*f);
-          function_body = callable.function->expr.get();
-          required_parameters = &callable.function->parameters;
-          defining_context = callable.defining_context;
-        } else {
-          const FunctionType *function;
-          if (index == 2) {
-            function = &std::get<Value>(*f).toFunction();
-          } else if (index == 3) {
-            function = &std::get<const Value *>(*f)->toFunction();
-          } else {
-            assert(false);
-          }
-          function_body = function->getExpr().get();
-          required_parameters = function->getParameters().get();
-          defining_context = function->getContext();
-        }
-      }
-      ContextHandle<Context> body_context{Context::create<Context>(defining_context)};
-      body_context->apply_config_variables(*context);
-      Arguments arguments{call->arguments, context};
-      Parameters parameters = Parameters::parse(std::move(arguments), call->location(),
-                                                *required_parameters, defining_context);
-      body_context->apply_variables(std::move(parameters).to_context_frame());
-
-      return SimplifiedExpression{function_body, std::move(body_context), call};
-    } else {
-      return expression->evaluate(context);
+  // Besides its Context, a scope's context allocation holds the variables of the call, which
+  // usually take another 200 to 300 bytes
+  constexpr size_t scope_size = sizeof(Scope) + sizeof(Context) + 256;
+  return scopes.size() * scope_size + tasks.capacity() * sizeof(Task) +
+         values.capacity() * sizeof(Value);
+}
+
+void FunctionEvaluator::openScope(ContextHandle<Context>&& context, const FunctionCall *call)
+{
+  tasks.push_back({Step::EndScope, nullptr});
+  scopes.emplace_back(std::move(context), call);
+  if (call && Profiler::enabled()) {
+    scopes.back().profile = std::make_unique<Profiler::Scope>("function", call->name, call->location());
+  }
+}
+
+void FunctionEvaluator::replaceScope(ContextHandle<Context>&& context, const FunctionCall *call,
+                                     const Expression *body)
+{
+  Scope& scope = scopes.back();
+  scope.context = std::move(context);
+  if (call) {
+    scope.call = call;
+    if (scope.tail_calls++ == 1000000) {
+      LOG(message_group::Error, body->location(), scope.context->documentRoot(),
+          "Recursion detected calling function '%1$s'", call->name);
+      throw RecursionException::create("function", call->name, call->location());
+    }
+    if (!scope.profile && Profiler::enabled()) {
+      scope.profile = std::make_unique<Profiler::Scope>("function", call->name, call->location());
     }
   }
 }
 
-Value FunctionCall::evaluate(const std::shared_ptr<const Context>& context) const
+void FunctionEvaluator::evaluateCall(const FunctionCall *call,
+                                     const std::shared_ptr<const Context>& context)
 {
-  const auto& name = get_name();
-  if (StackCheck::inst().check()) {
-    print_err(name.c_str(), loc, context);
-    throw RecursionException::create("function", name, this->loc);
+  if (!inTailPosition()) {
+    // Evaluate the call in a scope of its own, where it is in tail position
+    if (stackMemory() >= MAX_STACK_MEMORY) {
+      print_err(call->name.c_str(), call->location(), context);
+      throw RecursionException::create("function", call->name, call->location());
+    }
+    openScope(ContextHandle<Context>{Context::create<Context>(context)}, call);
+    tasks.push_back({Step::Evaluate, call});
+    return;
   }
 
-  // Repeatedly simplify expr until it reduces to either a tail call,
-  // or an expression that cannot be simplified in-place. If the latter,
-  // recurse. If the former, substitute the function body for expr,
-  // thereby implementing tail recursion optimization.
-  unsigned int recursion_depth = 0;
-  const FunctionCall *current_call = this;
-
-  ContextHandle<Context> expression_context{Context::create<Context>(context)};
-  const Expression *expression = this;
-  while (true) {
-    try {
-      auto result = simplify_function_body(expression, *expression_context);
-      if (Value *value = std::get_if<Value>(&result)) {
-        return std::move(*value);
+  const Expression *function_body;
+  const AssignmentList *required_parameters;
+  std::shared_ptr<const Context> defining_context;
+
+  auto f = call->evaluate_function_expression(context);
+  if (!f) {
+    values.push_back(Value::undefined.clone());
+    return;
+  }
+  auto index = f->index();
+  if (index == 0) {
+    const auto *builtin = std::get<const BuiltinFunction *>(*f);
+    if (builtin->evaluate_arguments && !builtin->is_experimental()) {
+      tasks.push_back({Step::Builtin, call, builtin});
+      for (auto it = call->arguments.rbegin(); it != call->arguments.rend(); ++it) {
+        tasks.push_back({Step::Evaluate, (*it)->getExpr().get()});
       }
+    } else {
+      values.push_back(builtin->evaluate(context, call));
+    }
+    return;
+  } else if (index == 1) {
+    CallableUserFunction callable = std::get<CallableUserFunction>(*f);
+    function_body = callable.function->expr.get();
+    required_parameters = &callable.function->parameters;
+    defining_context = callable.defining_context;
+  } else {
+    const FunctionType *function;
+    if (index == 2) {
+      function = &std::get<Value>(*f).toFunction();
+    } else if (index == 3) {
+      function = &std::get<const Value *>(*f)->toFunction();
+    } else {
+      assert(false);
+    }
+    function_body = function->getExpr().get();
+    required_parameters = function->getParameters().get();
+    defining_context = function->getContext();
+  }
+  ContextHandle<Context> body_context{Context::create<Context>(defining_context)};
+  body_context->apply_config_variables(*context);
+  Arguments arguments{call->arguments, context};
+  Parameters parameters =
+    Parameters::parse(std::move(arguments), call->location(), *required_parameters, defining_context);
+  body_context->apply_variables(std::move(parameters).to_context_frame());
 
-      SimplifiedExpression *simplified_expression = std::get_if<SimplifiedExpression>(&result);
-      assert(simplified_expression);
+  replaceScope(std::move(body_context), call, function_body);
+  tasks.push_back({Step::Evaluate, function_body});
+}
 
-      expression = simplified_expression->expression;
-      if (simplified_expression->new_context) {
-        expression_context = std::move(*simplified_expression->new_context);
+void FunctionEvaluator::evaluateStep(const Expression *expression)
+{
+  const std::shared_ptr<const Context> context = *scopes.back().context;
+  if (!expression) {
+    values.push_back(Value::undefined.clone());
+    return;
+  }
+  const auto& type = typeid(*expression);
+  if (type == typeid(BinaryOp)) {
+    const auto *op = static_cast<const BinaryOp *>(expression);
+    if (op->op == BinaryOp::Op::LogicalAnd || op->op == BinaryOp::Op::LogicalOr) {
+      tasks.push_back({Step::Logical, op});
+    } else {
+      tasks.push_back({Step::Binary, op});
+      tasks.push_back({Step::Evaluate, op->right.get()});
+    }
+    tasks.push_back({Step::Evaluate, op->left.get()});
+  } else if (type == typeid(UnaryOp)) {
+    const auto *op = static_cast<const UnaryOp *>(expression);
+    tasks.push_back({Step::Unary, op});
+    tasks.push_back({Step::Evaluate, op->expr.get()});
+  } else if (type == typeid(TernaryOp)) {
+    const auto *ternary = static_cast<const TernaryOp *>(expression);
+    tasks.push_back({Step::Branch, ternary});
+    tasks.push_back({Step::Evaluate, ternary->cond.get()});
+  } else if (type == typeid(ArrayLookup) &&
+             !static_cast<const ArrayLookup *>(expression)->streamedArray()) {
+    const auto *lookup = static_cast<const ArrayLookup *>(expression);
+    tasks.push_back({Step::Index, lookup});
+    tasks.push_back({Step::Evaluate, lookup->index.get()});
+    tasks.push_back({Step::Evaluate, lookup->array.get()});
+  } else if (type == typeid(FunctionCall)) {
+    evaluateCall(static_cast<const FunctionCall *>(expression), context);
+  } else if (type == typeid(Let)) {
+    const auto *let = static_cast<const Let *>(expression);
+    ContextHandle<Context> let_context{Context::create<Context>(context)};
+    let_context->apply_config_variables(*context);
+    const Expression *body = let->evaluateStep(let_context);
+    if (inTailPosition()) {
+      replaceScope(std::move(let_context), nullptr, body);
+    } else {
+      openScope(std::move(let_context), nullptr);
+    }
+    tasks.push_back({Step::Evaluate, body});
+  } else if (type == typeid(Assert)) {
+    tasks.push_back({Step::Evaluate, static_cast<const Assert *>(expression)->evaluateStep(context)});
+  } else if (type == typeid(Echo)) {
+    tasks.push_back({Step::Evaluate, static_cast<const Echo *>(expression)->evaluateStep(context)});
+  } else {
+    values.push_back(expression->evaluate(context));
+  }
+}
+
+Value FunctionEvaluator::evaluate(const FunctionCall *call,
+                                  const std::shared_ptr<const Context>& context)
+{
+  // This evaluation uses the stacks above these
+  const size_t tasks_base = tasks.size();
+  const size_t values_base = values.size();
+  const size_t scopes_base = scopes.size();
+  auto unwind = [&] {
+    while (scopes.size() > scopes_base) scopes.pop_back();
+    tasks.erase(tasks.begin() + tasks_base, tasks.end());
+    values.erase(values.begin() + values_base, values.end());
+  };
+
+  openScope(ContextHandle<Context>{Context::create<Context>(context)}, call);
+  tasks.push_back({Step::Evaluate, call});
+  try {
+    while (tasks.size() > tasks_base) {
+      const Task task = tasks.back();
+      tasks.pop_back();
+      switch (task.step) {
+      case Step::Evaluate: evaluateStep(task.expression); break;
+      case Step::Unary:
+        values.back() = static_cast<const UnaryOp *>(task.expression)
+                          ->apply(std::move(values.back()), *scopes.back().context);
+        break;
+      case Step::Binary: {
+        Value right = std::move(values.back());
+        values.pop_back();
+        values.back() = static_cast<const BinaryOp *>(task.expression)
+                          ->apply(std::move(values.back()), std::move(right), *scopes.back().context);
+        break;
       }
-      if (simplified_expression->new_active_function_call) {
-        current_call = *simplified_expression->new_active_function_call;
-        if (recursion_depth++ == 1000000) {
-          LOG(message_group::Error, expression->location(), expression_context->documentRoot(),
-              "Recursion detected calling function '%1$s'", current_call->name);
-          throw RecursionException::create("function", current_call->name, current_call->location());
+      case Step::Logical: {
+        const auto *op = static_cast<const BinaryOp *>(task.expression);
+        const bool left = values.back().toBool();
+        values.pop_back();
+        if (left == (op->op == BinaryOp::Op::LogicalAnd)) {
+          tasks.push_back({Step::ToBool, op});
+          tasks.push_back({Step::Evaluate, op->right.get()});
+        } else {
+          values.emplace_back(left);
         }
+        break;
+      }
+      case Step::ToBool: values.back() = Value(values.back().toBool()); break;
+      case Step::Branch: {
+        const auto *ternary = static_cast<const TernaryOp *>(task.expression);
+        const bool cond = values.back().toBool();
+        values.pop_back();
+        tasks.push_back({Step::Evaluate, cond ? ternary->ifexpr.get() : ternary->elseexpr.get()});
+        break;
+      }
+      case Step::Index: {
+        Value index = std::move(values.back());
+        values.pop_back();
+        values.back() = values.back()[index];
+        break;
+      }
+      case Step::Builtin: {
+        const auto *call = static_cast<const FunctionCall *>(task.expression);
+        Arguments arguments{call->arguments, values, scopes.back().context->session()};
+        Value result = task.builtin->evaluate_arguments(std::move(arguments), call->location());
+        values.push_back(std::move(result));
+        break;
+      }
+      case Step::EndScope: scopes.pop_back(); break;
       }
-    } catch (EvaluationException& e) {
-      print_trace(e, current_call, *expression_context);
-      e.traceDepth--;
-      throw;
     }
+  } catch (EvaluationException& e) {
+    while (scopes.size() > scopes_base) {
+      if (scopes.back().call) {
+        print_trace(e, scopes.back().call, *scopes.back().context);
+        e.traceDepth--;
+      }
+      scopes.pop_back();
+    }
+    unwind();
+    throw;
+  } catch (...) {
+    unwind();
+    throw;
   }
+  assert(values.size() == values_base + 1);
+  Value result = std::move(values.back());
+  values.pop_back();
+  return result;
+}
+
+Value FunctionCall::evaluate(const std::shared_ptr<const Context>& context) const
+{
+  // Only checked when evaluation of a function call is entered from elsewhere, as function calls
+  // don't recurse on the native stack within the FunctionEvaluator.
+  if (StackCheck::inst().check()) {
+    print_err(name.c_str(), loc, context);
+    throw RecursionException::create("function", name, this->loc);
+  }
+  return FunctionEvaluator::inst().evaluate(this, context);
 }
 
 void FunctionCall::print(std::ostream& stream, const std::string&) const
@@ -745,6 +1080,8 @@ Value Let::evaluate(const std::shared_ptr<const Context>& context) const
   return evaluateStep(letContext)->evaluate(*letContext);
 }
 
+bool Let::mayPrint() const { return ::mayPrint(this->arguments) || this->expr->mayPrint(); }
+
 void Let::print(std::ostream& stream, const std::string&) const
 {
   stream << "let(" << this->arguments << ") " << *expr;
@@ -752,22 +1089,43 @@ void Let::print(std::ostream& stream, const std::string&) const
 
 ListComprehension::ListComprehension(const Location& loc) : Expression(loc) {}
 
+// Only list comprehensions outside of a vector, like the operand of "each", are evaluated on their own
+Value ListComprehension::evaluate(const std::shared_ptr<const Context>& context) const
+{
+  EmbeddedVectorType vec(context->session());
+  VectorSink sink(vec);
+  generate(context, sink);
+  return {std::move(vec)};
+}
+
+// Appends what the body of a list comprehension evaluates to: its elements if it's a list
+// comprehension itself, or else its value.
+static void generateFrom(const Expression *body, const ListComprehension *lc,
+                         const std::shared_ptr<const Context>& context, ElementSink& out)
+{
+  if (lc) lc->generate(context, out);
+  else out.add(body->evaluate(context));
+}
+
 LcIf::LcIf(Expression *cond, Expression *ifexpr, Expression *elseexpr, const Location& loc)
   : ListComprehension(loc), cond(cond), ifexpr(ifexpr), elseexpr(elseexpr)
 {
 }
 
-Value LcIf::evaluate(const std::shared_ptr<const Context>& context) const
+void LcIf::generate(const std::shared_ptr<const Context>& context, ElementSink& out) const
 {
   const std::shared_ptr<Expression>& expr =
     this->cond->evaluate(context).toBool() ? this->ifexpr : this->elseexpr;
   if (expr) {
-    return expr->evaluate(context);
-  } else {
-    return EmbeddedVectorType::Empty();
+    generateFrom(expr.get(), dynamic_cast<const ListComprehension *>(expr.get()), context, out);
   }
 }
 
+bool LcIf::mayPrint() const
+{
+  return this->cond->mayPrint() || this->ifexpr->mayPrint() || ::mayPrint(this->elseexpr);
+}
+
 void LcIf::print(std::ostream& stream, const std::string&) const
 {
   stream << "if(" << *this->cond << ") (" << *this->ifexpr << ")";
@@ -780,7 +1138,7 @@ LcEach::LcEach(Expression *expr, const Location& loc) : ListComprehension(loc),
 
 // Need this for recurring into already embedded vectors, and performing "each" on their elements
 //    Context is only passed along for the possible use in Range warning.
-Value LcEach::evalRecur(Value&& v, const std::shared_ptr<const Context>& context) const
+void LcEach::evalRecur(Value&& v, const std::shared_ptr<const Context>& context, ElementSink& out) const
 {
   if (v.type() == Value::Type::RANGE) {
     const RangeType& range = v.toRange();
@@ -789,40 +1147,34 @@ Value LcEach::evalRecur(Value&& v, const std::shared_ptr<const Context>& context
       LOG(message_group::Warning, loc, context->documentRoot(),
           "Bad range parameter in for statement: too many elements (%1$lu)", steps);
     } else {
-      EmbeddedVectorType vec(context->session());
-      vec.reserve(range.numValues());
-      for (double d : range) vec.emplace_back(d);
-      return {std::move(vec)};
+      out.reserve(steps);
+      for (double d : range) out.add(d);
     }
   } else if (v.type() == Value::Type::VECTOR) {
     // Safe to move the overall vector ptr since we have a temporary value (could be a copy, or
-    // constructed just for us, doesn't matter)
-    auto vec = EmbeddedVectorType(std::move(v.toVectorNonConst()));
-    return {std::move(vec)};
+    // constructed just for us, doesn't matter). Embedding it keeps this O(1), which matters for
+    // functions appending one element at a time with [each v, x].
+    out.add(EmbeddedVectorType(std::move(v.toVectorNonConst())));
   } else if (v.type() == Value::Type::EMBEDDED_VECTOR) {
-    EmbeddedVectorType vec(context->session());
-    vec.reserve(v.toEmbeddedVector().size());
     // Not safe to move values out of a vector, since it's shared_ptr maye be shared with another Value,
     // which should remain constant
-    for (const auto& val : v.toEmbeddedVector()) vec.emplace_back(evalRecur(val.clone(), context));
-    return {std::move(vec)};
+    for (const auto& val : v.toEmbeddedVector()) evalRecur(val.clone(), context, out);
   } else if (v.type() == Value::Type::STRING) {
-    EmbeddedVectorType vec(context->session());
     auto& wrapper = v.toStrUtf8Wrapper();
-    vec.reserve(wrapper.size());
-    for (auto ch : wrapper) vec.emplace_back(std::move(ch));
-    return {std::move(vec)};
+    out.reserve(wrapper.size());
+    for (auto ch : wrapper) out.add(std::move(ch));
   } else if (v.type() != Value::Type::UNDEFINED) {
-    return std::move(v);
+    out.add(std::move(v));
   }
-  return EmbeddedVectorType::Empty();
 }
 
-Value LcEach::evaluate(const std::shared_ptr<const Context>& context) const
+void LcEach::generate(const std::shared_ptr<const Context>& context, ElementSink& out) const
 {
-  return evalRecur(this->expr->evaluate(context), context);
+  evalRecur(this->expr->evaluate(context), context, out);
 }
 
+bool LcEach::mayPrint() const { return this->expr->mayPrint(); }
+
 void LcEach::print(std::ostream& stream, const std::string&) const
 {
   stream << "each (" << *this->expr << ")";
@@ -841,6 +1193,23 @@ static inline ContextHandle<Context> forContext(const std::shared_ptr<const Cont
   return innerContext;
 }
 
+namespace {
+
+// Passes each element on to a function
+class ElementFunctionSink : public FlatElementSink
+{
+public:
+  ElementFunctionSink(std::function<void(Value&&)> function) : function(std::move(function)) {}
+
+protected:
+  void element(Value&& value) override { function(std::move(value)); }
+
+private:
+  std::function<void(Value&&)> function;
+};
+
+}  // namespace
+
 static void doForEach(const AssignmentList& assignments, const Location& location,
                       const std::function<void(const std::shared_ptr<const Context>&)>& operation,
                       size_t assignment_index, const std::shared_ptr<const Context>& context,
@@ -852,7 +1221,22 @@ static void doForEach(const AssignmentList& assignments, const Location& locatio
   }
 
   const std::string& variable_name = assignments[assignment_index]->getName();
-  Value variable_values = assignments[assignment_index]->getExpr()->evaluate(context);
+  const Expression *expression = assignments[assignment_index]->getExpr().get();
+
+  // Iterate over a list comprehension while it's generated, rather than generating all of it first.
+  // This runs the loop body between the evaluations of the elements, so it's only done if those
+  // can't print anything, which would interleave with the output of the body.
+  const auto *vector = dynamic_cast<const Vector *>(expression);
+  if (vector && vector->hasComprehensions() && !vector->mayPrint()) {
+    ElementFunctionSink sink([&](Value&& value) {
+      doForEach(assignments, location, operation, assignment_index + 1,
+                *forContext(context, variable_name, std::move(value)));
+    });
+    vector->generate(context, sink);
+    return;
+  }
+
+  Value variable_values = expression->evaluate(context);
 
   if (variable_values.type() == Value::Type::RANGE) {
     const RangeType& range = variable_values.toRange();
@@ -910,19 +1294,22 @@ void LcFor::forEach(const AssignmentList& assignments, const Location& loc,
   doForEach(assignments, loc, operation, 0, context, pReserve);
 }
 
-Value LcFor::evaluate(const std::shared_ptr<const Context>& context) const
+void LcFor::generate(const std::shared_ptr<const Context>& context, ElementSink& out) const
 {
-  EmbeddedVectorType vec(context->session());
-  std::function<void(size_t)> reserve = [&vec](size_t capacity) { vec.reserve(capacity); };
+  const auto *lc = dynamic_cast<const ListComprehension *>(expr.get());
+  // Reserve room for one element per iteration, if that's what the body adds. With more than one
+  // variable reserve() would be called for every iteration of the outer ones, so skip it.
+  std::function<void(size_t)> reserve = [&out](size_t count) { out.reserve(count); };
   forEach(
     this->arguments, this->loc, context,
-    [&vec, expression = expr.get()](const std::shared_ptr<const Context>& iterationContext) {
-      vec.emplace_back(expression->evaluate(iterationContext));
+    [&out, expression = expr.get(), lc](const std::shared_ptr<const Context>& iterationContext) {
+      generateFrom(expression, lc, iterationContext, out);
     },
-    &reserve);
-  return {std::move(vec)};
+    !lc && this->arguments.size() == 1 ? &reserve : nullptr);
 }
 
+bool LcFor::mayPrint() const { return ::mayPrint(this->arguments) || this->expr->mayPrint(); }
+
 void LcFor::print(std::ostream& stream, const std::string&) const
 {
   stream << "for(" << this->arguments << ") (" << *this->expr << ")";
@@ -938,9 +1325,9 @@ LcForC::LcForC(AssignmentList args, AssignmentList incrargs, Expression *cond, E
 {
 }
 
-Value LcForC::evaluate(const std::shared_ptr<const Context>& context) const
+void LcForC::generate(const std::shared_ptr<const Context>& context, ElementSink& out) const
 {
-  EmbeddedVectorType output(context->session());
+  const auto *lc = dynamic_cast<const ListComprehension *>(expr.get());
 
   ContextHandle<Context> initialContext{
     Let::sequentialAssignmentContext(this->arguments, this->location(), context)};
@@ -948,7 +1335,7 @@ Value LcForC::evaluate(const std::shared_ptr<const Context>& context) const
 
   unsigned int counter = 0;
   while (this->cond->evaluate(*currentContext).toBool()) {
-    output.emplace_back(this->expr->evaluate(*currentContext));
+    generateFrom(this->expr.get(), lc, *currentContext, out);
 
     if (counter++ == 1000000) {
       LOG(message_group::Error, loc, context->documentRoot(), "For loop counter exceeded limit");
@@ -971,7 +1358,12 @@ Value LcForC::evaluate(const std::shared_ptr<const Context>& context) const
     currentContext = std::move(nextContext);
     currentContext->setParent(*initialContext);
   }
-  return {std::move(output)};
+}
+
+bool LcForC::mayPrint() const
+{
+  return ::mayPrint(this->arguments) || ::mayPrint(this->incr_arguments) || this->cond->mayPrint() ||
+         this->expr->mayPrint();
 }
 
 void LcForC::print(std::ostream& stream, const std::string&) const
@@ -985,12 +1377,14 @@ LcLet::LcLet(AssignmentList args, Expression *expr, const Location& loc)
 {
 }
 
-Value LcLet::evaluate(const std::shared_ptr<const Context>& context) const
+void LcLet::generate(const std::shared_ptr<const Context>& context, ElementSink& out) const
 {
-  return this->expr->evaluate(
-    *Let::sequentialAssignmentContext(this->arguments, this->location(), context));
+  generateFrom(this->expr.get(), dynamic_cast<const ListComprehension *>(this->expr.get()),
+               *Let::sequentialAssignmentContext(this->arguments, this->location(), context), out);
 }
 
+bool LcLet::mayPrint() const { return ::mayPrint(this->arguments) || this->expr->mayPrint(); }
+
 void LcLet::print(std::ostream& stream, const std::string&) const
 {
   stream << "let(" << this->arguments << ") (" << *this->expr << ")";
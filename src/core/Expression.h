@@ -17,12 +17,16 @@
 
 template <class T>
 class ContextHandle;
+class Vector;
 
 class Expression : public ASTNode
 {
 public:
   Expression(const Location& loc) : ASTNode(loc) {}
   [[nodiscard]] virtual bool isLiteral() const;
+  // Whether evaluating this can print messages with echo() or assert(), including in the functions
+  // it calls. Warnings about the values it's given don't count.
+  [[nodiscard]] virtual bool mayPrint() const;
   [[nodiscard]] virtual Value evaluate(const std::shared_ptr<const Context>& context) const = 0;
   Value checkUndef(Value&& val, const std::shared_ptr<const Context>& context) const;
 };
@@ -34,9 +38,13 @@ public:
   [[nodiscard]] bool isLiteral() const override;
   UnaryOp(Op op, Expression *expr, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  [[nodiscard]] bool mayPrint() const override;
   void print(std::ostream& stream, const std::string& indent) const override;
 
 private:
+  friend class ASTSnapshot;
+  friend class FunctionEvaluator;
+  [[nodiscard]] Value apply(Value&& operand, const std::shared_ptr<const Context>& context) const;
   [[nodiscard]] const char *opString() const;
 
   Op op;
@@ -69,9 +77,14 @@ public:
 
   BinaryOp(Expression *left, Op op, Expression *right, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  [[nodiscard]] bool mayPrint() const override;
   void print(std::ostream& stream, const std::string& indent) const override;
 
 private:
+  friend class ASTSnapshot;
+  friend class FunctionEvaluator;
+  [[nodiscard]] Value apply(Value&& left, Value&& right,
+                            const std::shared_ptr<const Context>& context) const;
   [[nodiscard]] const char *opString() const;
 
   Op op;
@@ -85,9 +98,12 @@ public:
   TernaryOp(Expression *cond, Expression *ifexpr, Expression *elseexpr, const Location& loc);
   [[nodiscard]] const Expression *evaluateStep(const std::shared_ptr<const Context>& context) const;
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  [[nodiscard]] bool mayPrint() const override;
   void print(std::ostream& stream, const std::string& indent) const override;
 
 private:
+  friend class ASTSnapshot;
+  friend class FunctionEvaluator;
   std::shared_ptr<Expression> cond;
   std::shared_ptr<Expression> ifexpr;
   std::shared_ptr<Expression> elseexpr;
@@ -98,9 +114,13 @@ class ArrayLookup : public Expression
 public:
   ArrayLookup(Expression *array, Expression *index, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  [[nodiscard]] bool mayPrint() const override;
   void print(std::ostream& stream, const std::string& indent) const override;
 
 private:
+  friend class ASTSnapshot;
+  friend class FunctionEvaluator;
+  [[nodiscard]] const Vector *streamedArray() const;
   std::shared_ptr<Expression> array;
   std::shared_ptr<Expression> index;
 };
@@ -119,6 +139,7 @@ public:
   [[nodiscard]] bool isUndefined() const { return value.type() == Value::Type::UNDEFINED; }
 
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  [[nodiscard]] bool mayPrint() const override { return false; }
   void print(std::ostream& stream, const std::string& indent) const override;
   [[nodiscard]] bool isLiteral() const override { return true; }
 
@@ -135,6 +156,7 @@ public:
   [[nodiscard]] const Expression *getStep() const { return step.get(); }
   [[nodiscard]] const Expression *getEnd() const { return end.get(); }
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  [[nodiscard]] bool mayPrint() const override;
   void print(std::ostream& stream, const std::string& indent) const override;
   [[nodiscard]] bool isLiteral() const override;
 
@@ -144,12 +166,40 @@ private:
   std::shared_ptr<Expression> end;
 };
 
+/*!
+   Receives the elements of a vector as they are generated, so consumers like len() or for
+   can process them one at a time instead of building the whole vector first.
+ */
+class ElementSink
+{
+public:
+  virtual ~ElementSink() = default;
+  // Takes the next element; an embedded vector from "each" stands for all of its elements
+  virtual void add(Value&& value) = 0;
+  // Hints that count more elements follow
+  virtual void reserve(size_t /*count*/) {}
+};
+
+// An ElementSink which takes the elements of embedded vectors one by one
+class FlatElementSink : public ElementSink
+{
+public:
+  void add(Value&& value) final;
+
+protected:
+  virtual void element(Value&& value) = 0;
+};
+
 class Vector : public Expression
 {
 public:
   Vector(const Location& loc);
   const std::vector<std::shared_ptr<Expression>>& getChildren() const { return children; }
   Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  [[nodiscard]] bool mayPrint() const override;
+  // Passes the elements to out as they are evaluated, in the order evaluate() would put them in
+  void generate(const std::shared_ptr<const Context>& context, ElementSink& out) const;
+  [[nodiscard]] bool hasComprehensions() const { return has_comprehensions; }
   void print(std::ostream& stream, const std::string& indent) const override;
   void emplace_back(Expression *expr);
   bool isLiteral() const override;
@@ -157,6 +207,8 @@ public:
 private:
   std::vector<std::shared_ptr<Expression>> children;
   mutable boost::tribool literal_flag;  // cache if already computed
+  mutable boost::tribool print_flag;    // cache if already computed
+  bool has_comprehensions = false;
 };
 
 class Lookup : public Expression
@@ -164,6 +216,7 @@ class Lookup : public Expression
 public:
   Lookup(std::string name, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  [[nodiscard]] bool mayPrint() const override { return false; }
   void print(std::ostream& stream, const std::string& indent) const override;
   [[nodiscard]] const std::string& get_name() const { return name; }
 
@@ -176,11 +229,15 @@ class MemberLookup : public Expression
 public:
   MemberLookup(Expression *expr, std::string member, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  [[nodiscard]] bool mayPrint() const override;
   void print(std::ostream& stream, const std::string& indent) const override;
 
 private:
+  friend class ASTSnapshot;
   std::shared_ptr<Expression> expr;
   std::string member;
+  // where member was found in the last object looked up here
+  mutable ObjectKeyCache key_cache;
 };
 
 class FunctionCall : public Expression
@@ -207,6 +264,8 @@ class FunctionDefinition : public Expression
 public:
   FunctionDefinition(Expression *expr, AssignmentList parameters, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  // Only calls of the function can print, and those count already
+  [[nodiscard]] bool mayPrint() const override { return false; }
   void print(std::ostream& stream, const std::string& indent) const override;
 
 public:
@@ -226,6 +285,7 @@ public:
   void print(std::ostream& stream, const std::string& indent) const override;
 
 private:
+  friend class ASTSnapshot;
   AssignmentList arguments;
   std::shared_ptr<Expression> expr;
 };
@@ -239,6 +299,7 @@ public:
   void print(std::ostream& stream, const std::string& indent) const override;
 
 private:
+  friend class ASTSnapshot;
   AssignmentList arguments;
   std::shared_ptr<Expression> expr;
 };
@@ -254,9 +315,11 @@ public:
     const std::shared_ptr<const Context>& context);
   const Expression *evaluateStep(ContextHandle<Context>& targetContext) const;
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  [[nodiscard]] bool mayPrint() const override;
   void print(std::ostream& stream, const std::string& indent) const override;
 
 private:
+  friend class ASTSnapshot;
   AssignmentList arguments;
   std::shared_ptr<Expression> expr;
 };
@@ -265,16 +328,21 @@ class ListComprehension : public Expression
 {
 public:
   ListComprehension(const Location& loc);
+  // Passes the elements this generates to out, without building a vector of its own
+  virtual void generate(const std::shared_ptr<const Context>& context, ElementSink& out) const = 0;
+  [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
 };
 
 class LcIf : public ListComprehension
 {
 public:
   LcIf(Expression *cond, Expression *ifexpr, Expression *elseexpr, const Location& loc);
-  [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  void generate(const std::shared_ptr<const Context>& context, ElementSink& out) const override;
+  [[nodiscard]] bool mayPrint() const override;
   void print(std::ostream& stream, const std::string& indent) const override;
 
 private:
+  friend class ASTSnapshot;
   std::shared_ptr<Expression> cond;
   std::shared_ptr<Expression> ifexpr;
   std::shared_ptr<Expression> elseexpr;
@@ -288,10 +356,12 @@ public:
                       const std::shared_ptr<const Context>& context,
                       const std::function<void(const std::shared_ptr<const Context>&)>& operation,
                       const std::function<void(size_t)> *pReserve = nullptr);
-  [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  void generate(const std::shared_ptr<const Context>& context, ElementSink& out) const override;
+  [[nodiscard]] bool mayPrint() const override;
   void print(std::ostream& stream, const std::string& indent) const override;
 
 private:
+  friend class ASTSnapshot;
   AssignmentList arguments;
   std::shared_ptr<Expression> expr;
 };
@@ -301,10 +371,12 @@ class LcForC : public ListComprehension
 public:
   LcForC(AssignmentList args, AssignmentList incrargs, Expression *cond, Expression *expr,
          const Location& loc);
-  [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  void generate(const std::shared_ptr<const Context>& context, ElementSink& out) const override;
+  [[nodiscard]] bool mayPrint() const override;
   void print(std::ostream& stream, const std::string& indent) const override;
 
 private:
+  friend class ASTSnapshot;
   AssignmentList arguments;
   AssignmentList incr_arguments;
   std::shared_ptr<Expression> cond;
@@ -315,11 +387,13 @@ class LcEach : public ListComprehension
 {
 public:
   LcEach(Expression *expr, const Location& loc);
-  [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  void generate(const std::shared_ptr<const Context>& context, ElementSink& out) const override;
+  [[nodiscard]] bool mayPrint() const override;
   void print(std::ostream& stream, const std::string& indent) const override;
 
 private:
-  Value evalRecur(Value&& v, const std::shared_ptr<const Context>& context) const;
+  friend class ASTSnapshot;
+  void evalRecur(Value&& v, const std::shared_ptr<const Context>& context, ElementSink& out) const;
   std::shared_ptr<Expression> expr;
 };
 
@@ -327,10 +401,12 @@ class LcLet : public ListComprehension
 {
 public:
   LcLet(AssignmentList args, Expression *expr, const Location& loc);
-  [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  void generate(const std::shared_ptr<const Context>& context, ElementSink& out) const override;
+  [[nodiscard]] bool mayPrint() const override;
   void print(std::ostream& stream, const std::string& indent) const override;
 
 private:
+  friend class ASTSnapshot;
   AssignmentList arguments;
   std::shared_ptr<Expression> expr;
 };
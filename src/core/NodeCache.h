@@ -12,7 +12,8 @@
 /*!
    Caches string values per node based on the node.index().
    The node index guaranteed to be unique per node tree since the index is reset
-   every time a new tree is generated.
+   every time a new tree is generated. A node shared by several parents (see
+   children()) keeps the string of its first occurrence.
  */
 
 class NodeCache
@@ -36,7 +37,6 @@ public:
 
   void insertStart(const size_t nodeidx, const long startindex)
   {
-    assert(this->cache.count(nodeidx) == 0 && "start index inserted twice");
     this->cache.emplace(nodeidx, std::make_pair(startindex, -1L));
   }
 
@@ -44,7 +44,7 @@ public:
   {
     // throws std::out_of_range on miss
     auto indexpair = this->cache.at(nodeidx);
-    assert(indexpair.second == -1L && "end index inserted twice");
+    if (indexpair.second != -1L) return;  // already ended by an earlier occurrence
     this->cache[nodeidx] = std::make_pair(indexpair.first, endindex);
 #ifdef DEBUG
     PRINTDB("NodeCache insert {%i,[%d:%d]}", nodeidx % indexpair.first % endindex);
@@ -30,8 +30,9 @@ int GroupNodeChecker::getChildCount(int groupNodeIndex) const
 Response GroupNodeChecker::visit(State& state, const GroupNode& node)
 {
   if (state.isPrefix()) {
-    // create entry for group node, which children may increment
-    this->groupChildCounts.emplace(node.index(), 0);
+    // create entry for group node, which children may increment. Nodes shared by several
+    // parents (see children()) are only counted once.
+    if (!this->groupChildCounts.emplace(node.index(), 0).second) return Response::PruneTraversal;
   } else if (state.isPostfix()) {
     if ((this->getChildCount(node.index()) > 0) && state.parent()) {
       this->incChildCount(state.parent()->index());
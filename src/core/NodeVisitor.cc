@@ -8,6 +8,20 @@ Response NodeVisitor::traverse(const AbstractNode& node, const State& state)
   State newstate = state;
   newstate.setNumChildren(node.getChildren().size());
 
+  // Leaves the node however its traversal ends, so an exception doesn't leave stale entries in the
+  // stacks of a visitor which is used again, like the profiling stack of GeometryEvaluator
+  struct NodeGuard {
+    NodeGuard(NodeVisitor& visitor, const AbstractNode& node) : visitor(visitor), node(node)
+    {
+      visitor.enterNode(node);
+    }
+    ~NodeGuard() { visitor.leaveNode(node); }
+    NodeGuard(const NodeGuard&) = delete;
+    NodeGuard& operator=(const NodeGuard&) = delete;
+    NodeVisitor& visitor;
+    const AbstractNode& node;
+  } guard(*this, node);
+
   Response response = Response::ContinueTraversal;
   newstate.setPrefix(true);
   newstate.setParent(state.parent());
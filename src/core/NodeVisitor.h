@@ -113,6 +113,11 @@ public:
   }
   // Add visit() methods for new visitable subtypes of AbstractNode here
 
+protected:
+  // Called once before the prefix visit and once after the postfix visit of every traversed node
+  virtual void enterNode(const AbstractNode& /*node*/) {}
+  virtual void leaveNode(const AbstractNode& /*node*/) {}
+
 private:
   static State nullstate;
 };
@@ -228,7 +228,10 @@ SettingsEntryList<LocalAppParameter> Settings::localAppParameterList("printing",
 
 SettingsEntryEnum<std::string> Settings::renderBackend3D(
   "advanced", "renderBackend3D",
-  {{"CGAL", "cgal", "CGAL (old/slow)"}, {"Manifold", "manifold", "Manifold (new/fast)"}}, "Manifold");
+  {{"CGAL", "cgal", "CGAL (old/slow)"},
+   {"Corefinement", "corefinement", "CGAL Corefinement (exact)"},
+   {"Manifold", "manifold", "Manifold (new/fast)"}},
+  "Manifold");
 SettingsEntryEnum<std::string> Settings::toolbarExport3D(
   "advanced", "toolbarExport3D", createFileFormatItems(fileformat::all3D()),
   fileformat::info(FileFormat::ASCII_STL).description);
@@ -40,6 +40,7 @@
 #include <ctime>
 #include <ostream>
 #include <memory>
+#include <set>
 #include <boost/algorithm/string.hpp>
 #include <filesystem>
 #include <string>
@@ -74,6 +75,7 @@ void SourceFile::registerUse(const std::string& path, const Location& loc)
   if (boost::iequals(ext, ".otf") || boost::iequals(ext, ".ttf")) {
     if (fs::is_regular_file(path)) {
       FontCache::instance()->register_font_file(path);
+      usedfonts.push_back(path);
     } else {
       LOG(message_group::Error, "Can't read font with path '%1$s'", path);
     }
@@ -138,35 +140,37 @@ time_t SourceFile::handleDependencies(bool is_root)
   // If a lib in usedlibs was previously missing, we need to relocate it
   // by searching the applicable paths. We can identify a previously missing module
   // as it will have a relative path.
-  time_t latest = 0;
-  for (auto filename : this->usedlibs) {
-    auto found = true;
-
+  std::vector<std::string> filenames;
+  for (const auto& filename : this->usedlibs) {
     // Get an absolute filename for the module
     if (!fs::path(filename).is_absolute()) {
       auto fullpath = find_valid_path(this->path, filename);
       if (!fullpath.empty()) {
         auto newfilename = fullpath.generic_string();
         updates.emplace_back(filename, newfilename);
-        filename = newfilename;
-      } else {
-        found = false;
+        filenames.push_back(newfilename);
       }
+    } else {
+      filenames.push_back(filename);
     }
+  }
 
-    if (found) {
-      auto oldmodule = SourceFileCache::instance()->lookup(filename);
-      SourceFile *newmodule;
-      auto mtime = SourceFileCache::instance()->process(this->getFullpath(), filename, newmodule);
-      if (mtime > latest) latest = mtime;
-      auto changed = newmodule && newmodule != oldmodule;
-      // Detect appearance but not removal of files, and keep old module
-      // on parse errors (FIXME: Is this correct behavior?)
-      if (changed) {
-        PRINTDB("  %s: %p -> %p", filename % oldmodule % newmodule);
-      } else {
-        PRINTDB("  %s: %p", filename % oldmodule);
-      }
+  // Libraries are independent of each other, so they can be read ahead concurrently
+  SourceFileCache::instance()->prefetch(filenames);
+
+  time_t latest = 0;
+  for (const auto& filename : filenames) {
+    auto oldmodule = SourceFileCache::instance()->lookup(filename);
+    SourceFile *newmodule;
+    auto mtime = SourceFileCache::instance()->process(this->getFullpath(), filename, newmodule);
+    if (mtime > latest) latest = mtime;
+    auto changed = newmodule && newmodule != oldmodule;
+    // Detect appearance but not removal of files, and keep old module
+    // on parse errors (FIXME: Is this correct behavior?)
+    if (changed) {
+      PRINTDB("  %s: %p -> %p", filename % oldmodule % newmodule);
+    } else {
+      PRINTDB("  %s: %p", filename % oldmodule);
     }
   }
 
@@ -178,6 +182,26 @@ time_t SourceFile::handleDependencies(bool is_root)
   return latest;
 }
 
+/*!
+   Adds the full paths of all included and used files, recursively.
+   Libraries which couldn't be located are added relative to this file,
+   so they are noticed when they appear next to it.
+ */
+void SourceFile::collectDependencies(std::set<std::string>& files) const
+{
+  for (const auto& item : this->includes) {
+    files.insert(item.second);
+  }
+  for (const auto& filename : this->usedlibs) {
+    const auto fullpath =
+      fs::path(filename).is_absolute() ? filename : (fs::path(this->path) / filename).generic_string();
+    if (!files.insert(fullpath).second) continue;
+    if (const auto *module = SourceFileCache::instance()->lookup(fullpath)) {
+      module->collectDependencies(files);
+    }
+  }
+}
+
 std::shared_ptr<AbstractNode> SourceFile::instantiate(
   const std::shared_ptr<const Context>& context,
   std::shared_ptr<const FileContext> *resulting_file_context) const
@@ -2,6 +2,7 @@
 
 #include <ostream>
 #include <memory>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <ctime>
@@ -27,6 +28,7 @@ public:
   void registerInclude(const std::string& localpath, const std::string& fullpath, const Location& loc);
   std::time_t includesChanged() const;
   std::time_t handleDependencies(bool is_root = true);
+  void collectDependencies(std::set<std::string>& files) const;
   bool hasIncludes() const { return !this->includes.empty(); }
   bool usesLibraries() const { return !this->usedlibs.empty(); }
   bool isHandlingDependencies() const { return this->is_handling_dependencies; }
@@ -37,10 +39,14 @@ public:
 
   const std::shared_ptr<LocalScope> scope;
   std::vector<std::string> usedlibs;
+  // Font files registered by use<>, kept to restore them from AST snapshots
+  std::vector<std::string> usedfonts;
 
   std::vector<IndicatorData> indicatorData;
 
 private:
+  friend class ASTSnapshot;
+
   std::time_t include_modified(const std::string& filename) const;
 
   std::unordered_map<std::string, std::string> includes;
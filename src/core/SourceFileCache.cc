@@ -1,4 +1,5 @@
 #include "core/SourceFileCache.h"
+#include "core/ASTSnapshot.h"
 #include "core/StatCache.h"
 #include "core/SourceFile.h"
 #include "utils/printutils.h"
@@ -8,9 +9,13 @@
 
 #include <cstdio>
 #include <fstream>
+#include <future>
+#include <memory>
 #include <string>
 #include <sys/stat.h>
 #include <algorithm>
+#include <utility>
+#include <vector>
 
 /*!
    FIXME: Implement an LRU scheme to avoid having an ever-growing source file cache
@@ -20,6 +25,18 @@
 
 SourceFileCache *SourceFileCache::inst = nullptr;
 
+namespace {
+
+std::string make_cache_id(const struct stat& st)
+{
+  return str(boost::format("%x.%x") % st.st_mtime % st.st_size);
+}
+
+}  // namespace
+
+SourceFileCache::SourceFileCache() = default;
+SourceFileCache::~SourceFileCache() = default;
+
 /*!
    Reprocess the given file and all its dependencies and reparse anything
    necessary. Updates the cache if necessary.
@@ -50,7 +67,7 @@ std::time_t SourceFileCache::process(const std::string& mainFile, const std::str
   if (!valid) return 0;
 
   // If the file is present, we'll always cache some result
-  std::string cache_id = str(boost::format("%x.%x") % st.st_mtime % st.st_size);
+  std::string cache_id = make_cache_id(st);
 
   cache_entry& cacheEntry = this->entries[filename];
   // Initialize entry, if new
@@ -94,21 +111,41 @@ std::time_t SourceFileCache::process(const std::string& mainFile, const std::str
 #endif
 
     std::string text;
-    {
+    std::unique_ptr<SourceFile> snapshot;
+    auto pending = this->prefetched.find(filename);
+    if (pending != this->prefetched.end() && pending->second.cache_id == cache_id) {
+      text = std::move(pending->second.text);
+      snapshot = std::move(pending->second.snapshot);
+    } else {
       std::ifstream ifs(filename.c_str());
       if (!ifs.is_open()) {
         LOG(message_group::Warning, "Can't open library file '%1$s'\n", filename);
         return 0;
       }
       text = STR(ifs.rdbuf(), "\n\x03\n", commandline_commands);
+      if (ASTSnapshot::enabled()) {
+        snapshot = ASTSnapshot::read(ASTSnapshot::snapshotPath(filename, text));
+      }
     }
+    if (pending != this->prefetched.end()) this->prefetched.erase(pending);
 
     print_messages_push();
 
     delete cacheEntry.parsed_file;
-    file =
-      parse(cacheEntry.parsed_file, text, filename, mainFile, false) ? cacheEntry.parsed_file : nullptr;
-    PRINTDB("parsed file: %s", filename);
+    if (snapshot) {
+      PRINTDB("loaded AST snapshot: %s", filename);
+      ASTSnapshot::registerDependencies(*snapshot);
+      cacheEntry.parsed_file = snapshot.release();
+      file = cacheEntry.parsed_file;
+    } else {
+      const bool parsed = parse(cacheEntry.parsed_file, text, filename, mainFile, false);
+      file = parsed ? cacheEntry.parsed_file : nullptr;
+      PRINTDB("parsed file: %s", filename);
+      // Warnings are only emitted while parsing, so only snapshot files which didn't produce any
+      if (file && ASTSnapshot::enabled() && print_messages_stack.back().empty()) {
+        ASTSnapshot::write(*file, ASTSnapshot::snapshotPath(filename, text));
+      }
+    }
     cacheEntry.file = file;
     cacheEntry.cache_id = cache_id;
     auto mod = file ? file : cacheEntry.parsed_file;
@@ -123,7 +160,54 @@ std::time_t SourceFileCache::process(const std::string& mainFile, const std::str
   return std::max({deps_mtime, cacheEntry.mtime, cacheEntry.includes_mtime});
 }
 
-void SourceFileCache::clear() { this->entries.clear(); }
+/*!
+   Reads the given library files and their AST snapshots concurrently, so the
+   following calls to process() don't have to. Files which are already cached
+   and unchanged are skipped.
+
+   This only helps with AST snapshots enabled, since parsing itself relies on
+   global parser state and can't run in parallel.
+ */
+void SourceFileCache::prefetch(const std::vector<std::string>& filenames)
+{
+  if (!ASTSnapshot::enabled()) return;
+
+  std::vector<std::pair<std::string, std::string>> pending;
+  for (const auto& filename : filenames) {
+    struct stat st;
+    if (StatCache::stat(filename, st) != 0) continue;
+    auto cache_id = make_cache_id(st);
+    auto entry = this->entries.find(filename);
+    if (entry != this->entries.end() && entry->second.cache_id == cache_id) continue;
+    pending.emplace_back(filename, std::move(cache_id));
+  }
+  // A single file is just as well read by process()
+  if (pending.size() < 2) return;
+
+  std::vector<std::future<prefetch_entry>> results;
+  results.reserve(pending.size());
+  for (const auto& [filename, cache_id] : pending) {
+    results.push_back(std::async(std::launch::async, [&filename = filename, &cache_id = cache_id]() {
+      prefetch_entry result{cache_id, "", nullptr};
+      std::ifstream ifs(filename.c_str());
+      if (!ifs.is_open()) return result;
+      result.text = STR(ifs.rdbuf(), "\n\x03\n", commandline_commands);
+      result.snapshot = ASTSnapshot::read(ASTSnapshot::snapshotPath(filename, result.text));
+      return result;
+    }));
+  }
+  for (size_t i = 0; i < pending.size(); ++i) {
+    auto result = results[i].get();
+    // Unreadable files are left to process(), which reports them
+    if (!result.text.empty()) this->prefetched[pending[i].first] = std::move(result);
+  }
+}
+
+void SourceFileCache::clear()
+{
+  this->entries.clear();
+  this->prefetched.clear();
+}
 
 SourceFile *SourceFileCache::lookup(const std::string& filename)
 {
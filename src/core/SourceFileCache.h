@@ -1,8 +1,10 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <ctime>
 #include <unordered_map>
+#include <vector>
 
 class SourceFile;
 
@@ -20,13 +22,15 @@ public:
 
   std::time_t process(const std::string& mainFile, const std::string& filename,
                       SourceFile *& sourceFile);
+  void prefetch(const std::vector<std::string>& filenames);
   SourceFile *lookup(const std::string& filename);
   size_t size() const { return this->entries.size(); }
   void clear();
   static void clear_markers();
 
 private:
-  SourceFileCache() = default;
+  SourceFileCache();
+  ~SourceFileCache();
 
   static SourceFileCache *inst;
 
@@ -39,4 +43,12 @@ private:
     std::time_t includes_mtime{};  // time the includes last changed
   };
   std::unordered_map<std::string, cache_entry> entries;
+
+  // Files read ahead of process() by prefetch()
+  struct prefetch_entry {
+    std::string cache_id;
+    std::string text;
+    std::unique_ptr<SourceFile> snapshot;
+  };
+  std::unordered_map<std::string, prefetch_entry> prefetched;
 };
@@ -39,6 +39,7 @@
 #include "utils/compiler_specific.h"
 #include "utils/exceptions.h"
 #include "utils/printutils.h"
+#include "utils/Profiler.h"
 #include "utils/StackCheck.h"
 #include <cstddef>
 #include <sstream>
@@ -96,6 +97,7 @@ std::shared_ptr<AbstractNode> UserModule::instantiate(
   }
 
   StaticModuleNameStack name{inst->name()};  // push on static stack, pop at end of method!
+  Profiler::Scope profile("module", inst->name(), inst->location());
   ContextHandle<UserModuleContext> module_context{Context::create<UserModuleContext>(
     defining_context, this, inst->location(), Arguments(inst->arguments, context),
     Children(inst->scope, context))};
@@ -26,6 +26,7 @@
 
 #include "core/Value.h"
 
+#include <algorithm>
 #include <filesystem>
 #include <cmath>
 #include <variant>
@@ -36,6 +37,7 @@
 #include <cassert>
 #include <cstddef>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -178,7 +180,7 @@ inline std::string DoubleConvert(const double& value, char *buffer,
   return buffer;
 }
 
-static uint32_t convert_to_uint32(const double d)
+uint32_t convert_to_uint32(const double d)
 {
   auto ret = std::numeric_limits<uint32_t>::max();
   if (std::isfinite(d)) {
@@ -727,8 +729,10 @@ Value ObjectType::operator==(const ObjectType& other) const
     return false;
   }
 
+  // objects with the same layout have the same keys
+  const bool same_keys = other.ptr->layout == this->ptr->layout;
   for (size_t i = 0; i < this->ptr->values.size(); i++) {
-    auto key_the_same = this->ptr->keys[i] != other.ptr->keys[i];
+    auto key_the_same = !same_keys && this->ptr->keys()[i] != other.ptr->keys()[i];
     if (key_the_same) {
       return false;
     }
@@ -1356,6 +1360,85 @@ std::ostream& operator<<(std::ostream& stream, const RangeType& r)
                 << DoubleConvert(r.end_value(), buffer, builder, dc) << "]";
 }
 
+std::shared_ptr<ObjectLayout> ObjectLayout::empty()
+{
+  static const std::shared_ptr<ObjectLayout> root = std::make_shared<ObjectLayout>();
+  return root;
+}
+
+size_t ObjectLayout::find(const std::string& key) const
+{
+  if (keys.size() <= LINEAR_LOOKUP_MAX) {
+    const auto it = std::find(keys.begin(), keys.end(), key);
+    return it != keys.end() ? it - keys.begin() : NOINDEX;
+  }
+  const auto it = index.find(key);
+  return it != index.end() ? it->second : NOINDEX;
+}
+
+void ObjectLayout::buildIndex()
+{
+  index.clear();
+  if (keys.size() <= LINEAR_LOOKUP_MAX) return;
+  index.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) index.emplace(keys[i], i);
+}
+
+std::shared_ptr<ObjectLayout> ObjectLayout::append(std::shared_ptr<ObjectLayout> layout,
+                                                   const std::string& key)
+{
+  if (layout->shared && layout->keys.size() < SHARED_KEYS_MAX) {
+    const std::lock_guard<std::mutex> lock(layout->transitions_mutex);
+    auto& transition = layout->transitions[key];
+    if (auto child = transition.lock()) return child;
+
+    // Allocated separately from its control block, so an expired transition doesn't keep
+    // the keys alive.
+    std::shared_ptr<ObjectLayout> child(new ObjectLayout);
+    child->parent = layout;
+    child->keys = layout->keys;
+    child->keys.push_back(key);
+    child->buildIndex();
+    transition = child;
+
+    // Objects with arbitrary keys leave expired transitions behind, so sweep those out
+    // whenever the number of transitions has doubled.
+    if (layout->transitions.size() >= layout->transitions_purge_size) {
+      for (auto it = layout->transitions.begin(); it != layout->transitions.end();) {
+        if (it->second.expired()) it = layout->transitions.erase(it);
+        else ++it;
+      }
+      layout->transitions_purge_size = std::max<size_t>(16, 2 * layout->transitions.size());
+    }
+    return child;
+  }
+
+  if (layout->shared) {
+    auto copy = std::make_shared<ObjectLayout>();
+    copy->shared = false;
+    copy->keys = layout->keys;
+    copy->index = layout->index;
+    layout = std::move(copy);
+  }
+  layout->keys.push_back(key);
+  if (layout->keys.size() == LINEAR_LOOKUP_MAX + 1) layout->buildIndex();
+  else if (!layout->index.empty()) layout->index.emplace(key, layout->keys.size() - 1);
+  return layout;
+}
+
+std::shared_ptr<ObjectLayout> ObjectLayout::erase(std::shared_ptr<ObjectLayout> layout, size_t index)
+{
+  if (layout->shared) {
+    auto copy = std::make_shared<ObjectLayout>();
+    copy->shared = false;
+    copy->keys = layout->keys;
+    layout = std::move(copy);
+  }
+  layout->keys.erase(layout->keys.begin() + index);
+  layout->buildIndex();
+  return layout;
+}
+
 // called by clone()
 ObjectType::ObjectType(const std::shared_ptr<ObjectObject>& copy) : ptr(copy) {}
 
@@ -1365,11 +1448,28 @@ ObjectType::ObjectType(EvaluationSession *session) : ptr(std::make_shared<Object
 }
 
 const Value& ObjectType::get(const std::string& key) const { return ptr->get(key); }
+
+const Value& ObjectType::get(const std::string& key, ObjectKeyCache& cache) const
+{
+  const ObjectLayout *layout = ptr->layout.get();
+  size_t index = cache.index.load(std::memory_order_relaxed);
+  // The key is compared too, as unshared layouts change in place and a freed layout's
+  // address can be reused by another.
+  if (cache.layout.load(std::memory_order_relaxed) == layout && index < layout->keys.size() &&
+      layout->keys[index] == key) {
+    return ptr->values[index];
+  }
+  index = layout->find(key);
+  if (index == NOINDEX) return Value::undefined;
+  cache.layout.store(layout, std::memory_order_relaxed);
+  cache.index.store(index, std::memory_order_relaxed);
+  return ptr->values[index];
+}
 bool ObjectType::set(const std::string& key, Value value) { return ptr->set(key, std::move(value)); }
 bool ObjectType::del(const std::string& key) { return ptr->del(key) != NOINDEX; }
 bool ObjectType::contains(const std::string& key) const { return ptr->find(key) != NOINDEX; }
 bool ObjectType::empty() const { return ptr->values.empty(); }
-const std::vector<std::string>& ObjectType::keys() const { return ptr->keys; }
+const std::vector<std::string>& ObjectType::keys() const { return ptr->keys(); }
 const std::vector<Value>& ObjectType::values() const { return ptr->values; }
 
 const Value& ObjectType::operator[](const str_utf8_wrapper& v) const { return this->get(v.toString()); }
@@ -1380,10 +1480,10 @@ ObjectType ObjectType::clone() const { return ObjectType(this->ptr); }
 std::ostream& operator<<(std::ostream& stream, const ObjectType& v)
 {
   stream << "{ ";
-  auto iter = v.ptr->keys.begin();
-  if (iter != v.ptr->keys.end()) {
+  auto iter = v.ptr->keys().begin();
+  if (iter != v.ptr->keys().end()) {
     str_utf8_wrapper k(*iter);
-    for (; iter != v.ptr->keys.end(); ++iter) {
+    for (; iter != v.ptr->keys().end(); ++iter) {
       str_utf8_wrapper k2(*iter);
       stream << k2.toString() << " = " << v[k2] << "; ";
     }
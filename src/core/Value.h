@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <iterator>
 #include <unordered_map>
 #include <utility>
@@ -7,8 +8,10 @@
 #include <string>
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <ostream>
 #include <memory>
+#include <mutex>
 #include <type_traits>
 #include <variant>
 
@@ -22,6 +25,7 @@ class tostream_visitor;
 class EvaluationSession;
 class Expression;
 class Value;
+struct ObjectKeyCache;
 
 class QuotedString : public std::string
 {
@@ -91,8 +95,8 @@ public:
    * by treating their elements as elements of their parent, traversable via VectorType's custom
    * iterator.
    * -- An embedded vector should never exist "in the wild", only as a pseudo-element of a parent vector.
-   *    Eg "Lc*" Expressions return Embedded Vectors but they are necessarily child expressions of a
-   * Vector expression.
+   *    Eg "each" embeds the vector it is applied to in the Vector expression it is part of. Other "Lc*"
+   * Expressions append their elements to that vector directly.
    * -- Any VectorType containing embedded elements will be forced to "flatten" upon usage of operator[],
    *    which is the only case of random-access.
    * -- Any loops through VectorTypes should prefer automatic range-based for loops eg: for(const auto&
@@ -300,6 +304,7 @@ public:
     ObjectType(class EvaluationSession *session);
     [[nodiscard]] ObjectType clone() const;
     [[nodiscard]] const Value& get(const std::string& key) const;
+    [[nodiscard]] const Value& get(const std::string& key, ObjectKeyCache& cache) const;
     bool set(const std::string& key, Value value);
     bool del(const std::string& key);  // true if was present
     bool contains(const std::string& key) const;
@@ -421,6 +426,63 @@ private:
 };
 
 static const size_t NOINDEX = std::string::npos;
+
+/*!
+   The keys of an object, in insertion order.
+
+   Objects built the same way, like the records of one JSON file or the results of one
+   function, get the same keys in the same order. They share one layout, found by following
+   the transitions from the empty layout one key at a time. A layout in that tree never
+   changes once created.
+
+   Objects with many keys, or ones which had a key deleted, get a layout of their own which
+   they update in place, so building a large dictionary doesn't copy its keys for every key
+   added.
+ */
+class ObjectLayout
+{
+public:
+  // Layouts with more keys than this are looked up by hash instead of a linear scan
+  static constexpr size_t LINEAR_LOOKUP_MAX = 8;
+  // Objects with more keys than this don't share their layout
+  static constexpr size_t SHARED_KEYS_MAX = 64;
+
+  std::vector<std::string> keys;
+
+  [[nodiscard]] static std::shared_ptr<ObjectLayout> empty();
+  [[nodiscard]] size_t find(const std::string& key) const;
+  [[nodiscard]] bool isShared() const { return shared; }
+
+  // Returns the layout with key appended to layout, which may be layout itself if unshared
+  static std::shared_ptr<ObjectLayout> append(std::shared_ptr<ObjectLayout> layout,
+                                              const std::string& key);
+  // Returns the layout with the key at index removed, which may be layout itself if unshared
+  static std::shared_ptr<ObjectLayout> erase(std::shared_ptr<ObjectLayout> layout, size_t index);
+
+private:
+  void buildIndex();
+
+  bool shared = true;
+  std::unordered_map<std::string, size_t> index;
+
+  // Shared layouts keep the layouts they were appended to alive, so objects which are built one
+  // key at a time find the same chain of transitions as long as any object using it exists
+  std::shared_ptr<ObjectLayout> parent;
+  std::mutex transitions_mutex;
+  std::unordered_map<std::string, std::weak_ptr<ObjectLayout>> transitions;
+  size_t transitions_purge_size = 16;
+};
+
+/*!
+   Where a key was found in the last object it was looked up in. Lookups in objects with the
+   same layout check that key and index still match instead of searching for the key.
+   Used by MemberLookup, which can be evaluated from several threads.
+ */
+struct ObjectKeyCache {
+  std::atomic<const ObjectLayout *> layout{nullptr};
+  std::atomic<size_t> index{0};
+};
+
 // The object type which ObjectType's shared_ptr points to.
 struct Value::ObjectType::ObjectObject {
   class EvaluationSession *evaluation_session = nullptr;
@@ -431,25 +493,15 @@ struct Value::ObjectType::ObjectObject {
   // However, for the garbage collection in ContextMemoryManager.cc
   // it is paramount we only have 1 reference to a Value and that
   // we can provide a pointer to a vector<Value>.
-  // We therefore use a map for performance but maintain an index
-  // instead of a secondary reference.
+  // The keys therefore live in a (usually shared) layout,
+  // and values holds the value of each key at the same index.
 
-  std::unordered_map<std::string, size_t> map;
-  std::vector<std::string> keys;
+  std::shared_ptr<ObjectLayout> layout = ObjectLayout::empty();
   std::vector<Value> values;
 
-  const size_t find(const std::string& key)
-  {
-    if (!keys.empty() && map.empty()) {
-      for (size_t i = 0; i < keys.size(); i++) {
-        map.emplace(keys[i], i);
-      }
-    }
-    auto it = map.find(key);
-    if (it != map.end()) {
-      return it->second;
-    } else return NOINDEX;
-  }
+  [[nodiscard]] const std::vector<std::string>& keys() const { return layout->keys; }
+
+  [[nodiscard]] size_t find(const std::string& key) const { return layout->find(key); }
 
   bool set(const std::string& key, Value value)
   {
@@ -458,10 +510,7 @@ struct Value::ObjectType::ObjectObject {
       // if contains key, keep at same position
       values[index] = std::move(value);
     } else {
-      if (!map.empty()) {
-        map[key] = keys.size();  // incremental update
-      }
-      keys.emplace_back(key);
+      layout = ObjectLayout::append(std::move(layout), key);
       values.emplace_back(std::move(value));
     }
     return index == NOINDEX;
@@ -471,14 +520,13 @@ struct Value::ObjectType::ObjectObject {
   {
     size_t index = find(key);
     if (index != NOINDEX) {
-      keys.erase(keys.begin() + index);
+      layout = ObjectLayout::erase(std::move(layout), index);
       values.erase(values.begin() + index);
-      map.clear();
     }
     return index;
   }
 
-  const Value& get(const std::string& key)
+  [[nodiscard]] const Value& get(const std::string& key) const
   {
     size_t index = find(key);
     if (index != NOINDEX) return values[index];
@@ -488,6 +536,9 @@ struct Value::ObjectType::ObjectObject {
 
 std::ostream& operator<<(std::ostream& stream, const Value::ObjectType& u);
 
+// The index a number stands for in operator[], or the largest uint32_t if it stands for none
+uint32_t convert_to_uint32(double d);
+
 using VectorType = Value::VectorType;
 using EmbeddedVectorType = Value::EmbeddedVectorType;
 using ObjectType = Value::ObjectType;
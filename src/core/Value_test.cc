@@ -0,0 +1,40 @@
+#include <catch2/catch_all.hpp>
+#include "core/Value.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// Builds an object one key at a time, like JSON import and object() do
+Value::ObjectType record(const std::vector<std::string>& keys)
+{
+  Value::ObjectType object(nullptr);
+  for (size_t i = 0; i < keys.size(); ++i) object.set(keys[i], Value(double(i)));
+  return object;
+}
+
+}  // namespace
+
+TEST_CASE("Objects built with the same keys share one layout", "[Value][Object]")
+{
+  // Each object only references its final layout, so the intermediate layouts for "x" and
+  // "x", "y" must be kept alive by it for the second object to find the same chain
+  const auto a = record({"x", "y", "z"});
+  const auto b = record({"x", "y", "z"});
+  CHECK(a.ptr->layout == b.ptr->layout);
+  CHECK(a.ptr->layout->isShared());
+
+  const auto c = record({"x", "z", "y"});
+  CHECK(c.ptr->layout != a.ptr->layout);
+}
+
+TEST_CASE("Deleting a key unshares the layout", "[Value][Object]")
+{
+  const auto a = record({"x", "y"});
+  auto b = record({"x", "y"});
+  b.del("x");
+  CHECK_FALSE(b.ptr->layout->isShared());
+  CHECK(a.ptr->layout->isShared());
+  CHECK(b.keys() == std::vector<std::string>{"y"});
+}
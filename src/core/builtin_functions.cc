@@ -50,6 +50,8 @@
 #include <limits>
 #include <algorithm>
 #include <random>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "utils/boost-utils.h"
@@ -184,6 +186,8 @@ Value builtin_rands(Arguments arguments, const Location& loc)
   }
   auto numresults = boost_numeric_cast<size_t, double>(numresultsd);
 
+  // The results depend on (or reseed) the shared generator state
+  arguments.session()->mark_uncacheable();
   if (arguments.size() > 3) {
     auto seed = static_cast<uint32_t>(hash_floating_point(arguments[3]->toDouble()));
     deterministic_rng.seed(seed);
@@ -382,6 +386,41 @@ Value builtin_length(Arguments arguments, const Location& loc)
   return {double(arguments[0]->toStrUtf8Wrapper().get_utf8_strlen())};
 }
 
+namespace {
+
+// Counts the elements of a vector without keeping them
+class CountSink : public ElementSink
+{
+public:
+  void add(Value&& value) override
+  {
+    count += value.type() == Value::Type::EMBEDDED_VECTOR ? value.toEmbeddedVector().size() : 1;
+  }
+  size_t count = 0;
+};
+
+// The argument, if it's a list comprehension which a builtin can consume as it's generated
+const Vector *comprehension_argument(const FunctionCall *call, size_t index)
+{
+  const auto *vector = dynamic_cast<const Vector *>(call->arguments[index]->getExpr().get());
+  return vector && vector->hasComprehensions() ? vector : nullptr;
+}
+
+}  // namespace
+
+// len() of a list comprehension counts its elements as they're generated, without building it
+Value builtin_length_fused(const std::shared_ptr<const Context>& context, const FunctionCall *call)
+{
+  if (call->arguments.size() == 1) {
+    if (const Vector *vector = comprehension_argument(call, 0)) {
+      CountSink sink;
+      vector->generate(context, sink);
+      return {double(sink.count)};
+    }
+  }
+  return builtin_length(Arguments(call->arguments, context), call->location());
+}
+
 Value builtin_log(Arguments arguments, const Location& loc)
 {
   double x, y;
@@ -411,10 +450,14 @@ Value builtin_ln(Arguments arguments, const Location& loc)
 
 Value builtin_str(Arguments arguments, const Location& /*loc*/)
 {
+  // str(acc, ...) is the usual way to build up a string, so a leading string is shared with the
+  // result instead of being copied
+  const bool prefixed = !arguments.empty() && arguments[0]->type() == Value::Type::STRING;
   std::ostringstream stream;
-  for (const auto& argument : arguments) {
-    stream << argument->toString();
+  for (size_t i = prefixed ? 1 : 0; i < arguments.size(); ++i) {
+    stream << arguments[i]->toString();
   }
+  if (prefixed) return {arguments[0]->toStrUtf8Wrapper().concat(stream.str())};
   return {stream.str()};
 }
 
@@ -598,6 +641,124 @@ Value builtin_has_key(Arguments arguments, const Location& loc)
   return obj.contains(key);
 }
 
+namespace {
+
+// Smaller search() and lookup() tables are scanned directly, as building an index wouldn't pay off
+constexpr size_t TABLE_INDEX_MIN_SIZE = 32;
+// Maximum number of memoized table indexes per thread
+constexpr size_t TABLE_INDEX_MAX_ENTRIES = 64;
+
+/*
+   Indexes over search() and lookup() tables, memoized by the identity of the
+   table's shared vector object. Values are immutable and copies of a vector
+   share that object, so a table passed repeatedly (e.g. a catalog queried in
+   a loop) is only indexed once. Entries hold weak references, so they don't
+   keep tables alive, and a new table allocated at the address of a dead one
+   is never mistaken for it.
+ */
+template <class Index>
+class TableIndexCache
+{
+public:
+  template <class Build>
+  const Index& get(const VectorType& table, unsigned int column, const Build& build)
+  {
+    const Key key{table.ptr.get(), column};
+    auto it = this->entries.find(key);
+    if (it != this->entries.end() && !it->second.table.expired() &&
+        it->second.size == table.size()) {
+      return it->second.index;
+    }
+    if (it == this->entries.end() && this->entries.size() >= TABLE_INDEX_MAX_ENTRIES) {
+      for (auto e = this->entries.begin(); e != this->entries.end();) {
+        if (e->second.table.expired()) e = this->entries.erase(e);
+        else ++e;
+      }
+      if (this->entries.size() >= TABLE_INDEX_MAX_ENTRIES) this->entries.clear();
+    }
+    auto& entry = this->entries[key];
+    entry.table = table.ptr;
+    entry.size = table.size();
+    entry.index = build(table, column);
+    return entry.index;
+  }
+
+private:
+  struct Key {
+    const void *table;
+    unsigned int column;
+    bool operator==(const Key& other) const
+    {
+      return this->table == other.table && this->column == other.column;
+    }
+  };
+  struct KeyHash {
+    size_t operator()(const Key& key) const
+    {
+      return std::hash<const void *>{}(key.table) ^ (std::hash<unsigned int>{}(key.column) << 1);
+    }
+  };
+  struct Entry {
+    std::weak_ptr<void> table;
+    size_t size;
+    Index index;
+  };
+  std::unordered_map<Key, Entry, KeyHash> entries;
+};
+
+// The valid [key, value] entries of a lookup() table, in table order
+struct LookupTable {
+  bool first_valid{false};
+  bool sorted{true};  // keys are non-decreasing and not NaN
+  std::vector<double> keys;
+  std::vector<double> values;
+};
+
+LookupTable build_lookup_table(const VectorType& vec, unsigned int /*column*/)
+{
+  LookupTable table;
+  table.keys.reserve(vec.size());
+  table.values.reserve(vec.size());
+  bool first = true;
+  for (const auto& entry : vec) {
+    double p, v;
+    const bool valid = entry.getVec2(p, v);
+    if (first) table.first_valid = valid;
+    first = false;
+    if (!valid) continue;
+    if (std::isnan(p) || (!table.keys.empty() && p < table.keys.back())) table.sorted = false;
+    table.keys.push_back(p);
+    table.values.push_back(v);
+  }
+  return table;
+}
+
+thread_local TableIndexCache<LookupTable> lookup_tables;
+
+/*
+   Finds the entries surrounding p: low is the first entry with the largest key <= p
+   and high the first entry with the smallest key >= p. Either falls back to the first
+   entry if no such key exists.
+ */
+void find_lookup_entries(const LookupTable& table, double p, size_t& low, size_t& high)
+{
+  const auto& keys = table.keys;
+  low = high = 0;
+  if (table.sorted) {
+    high = std::lower_bound(keys.begin(), keys.end(), p) - keys.begin();
+    if (high == keys.size()) high = 0;
+    const auto upper = std::upper_bound(keys.begin(), keys.end(), p) - keys.begin();
+    if (upper > 0) low = std::lower_bound(keys.begin(), keys.end(), keys[upper - 1]) - keys.begin();
+    return;
+  }
+  for (size_t i = 1; i < keys.size(); ++i) {
+    if (keys[i] <= p && (keys[i] > keys[low] || keys[low] > p)) low = i;
+    if (keys[i] >= p && (keys[i] < keys[high] || keys[high] < p)) high = i;
+  }
+}
+
+}  // namespace
+
 Value builtin_lookup(Arguments arguments, const Location& loc)
 {
   if (!check_arguments("lookup", arguments, loc, {Value::Type::NUMBER, Value::Type::VECTOR})) {
@@ -613,24 +774,35 @@ Value builtin_lookup(Arguments arguments, const Location& loc)
   double low_p, low_v, high_p, high_v;
   const auto& vec = arguments[1]->toVector();
 
-  // Second must be a vector of vec2, with valid numbers inside
-  auto it = vec.begin();
-  if (vec.empty() || it->toVector().size() < 2 || !it->getVec2(low_p, low_v)) {
-    return Value::undefined.clone();
-  }
-  high_p = low_p;
-  high_v = low_v;
-
-  for (++it; it != vec.end(); ++it) {
-    double this_p, this_v;
-    if (it->getVec2(this_p, this_v)) {
-      if (this_p <= p && (this_p > low_p || low_p > p)) {
-        low_p = this_p;
-        low_v = this_v;
-      }
-      if (this_p >= p && (this_p < high_p || high_p < p)) {
-        high_p = this_p;
-        high_v = this_v;
+  if (vec.size() >= TABLE_INDEX_MIN_SIZE) {
+    const auto& table = lookup_tables.get(vec, 0, build_lookup_table);
+    if (!table.first_valid) return Value::undefined.clone();
+    size_t low, high;
+    find_lookup_entries(table, p, low, high);
+    low_p = table.keys[low];
+    low_v = table.values[low];
+    high_p = table.keys[high];
+    high_v = table.values[high];
+  } else {
+    // Second must be a vector of vec2, with valid numbers inside
+    auto it = vec.begin();
+    if (vec.empty() || it->toVector().size() < 2 || !it->getVec2(low_p, low_v)) {
+      return Value::undefined.clone();
+    }
+    high_p = low_p;
+    high_v = low_v;
+
+    for (++it; it != vec.end(); ++it) {
+      double this_p, this_v;
+      if (it->getVec2(this_p, this_v)) {
+        if (this_p <= p && (this_p > low_p || low_p > p)) {
+          low_p = this_p;
+          low_v = this_v;
+        }
+        if (this_p >= p && (this_p < high_p || high_p < p)) {
+          high_p = this_p;
+          high_v = this_v;
+        }
       }
     }
   }
@@ -765,6 +937,62 @@ static VectorType search(const str_utf8_wrapper& find, const VectorType& table,
   return returnvec;
 }
 
+namespace {
+
+// Rows of a search() table by the number or string in the searched column, in table order
+struct SearchIndex {
+  std::unordered_map<double, std::vector<uint32_t>> numbers;
+  std::unordered_map<std::string, std::vector<uint32_t>> strings;
+};
+
+void add_search_key(SearchIndex& index, const Value& key, uint32_t row)
+{
+  if (key.type() == Value::Type::NUMBER) {
+    const double d = key.toDouble();
+    // NaN never matches, and -0 == 0
+    if (!std::isnan(d)) index.numbers[d == 0 ? 0.0 : d].push_back(row);
+  } else if (key.type() == Value::Type::STRING) {
+    index.strings[key.toStrUtf8Wrapper().toString()].push_back(row);
+  }
+}
+
+SearchIndex build_search_index(const VectorType& table, unsigned int column)
+{
+  SearchIndex index;
+  uint32_t row = 0;
+  for (const auto& element : table) {
+    if (column == 0) add_search_key(index, element, row);
+    const auto& entry = element.toVector();
+    if (column < entry.size()) add_search_key(index, entry[column], row);
+    ++row;
+  }
+  return index;
+}
+
+thread_local TableIndexCache<SearchIndex> search_indexes;
+
+/*
+   Rows of the table matching value in the given column, or nullptr if the value
+   isn't indexed and the table has to be scanned instead.
+ */
+const std::vector<uint32_t> *find_search_rows(const SearchIndex& index, const Value& value)
+{
+  static const std::vector<uint32_t> no_rows;
+  if (value.type() == Value::Type::NUMBER) {
+    const double d = value.toDouble();
+    if (std::isnan(d)) return &no_rows;
+    const auto it = index.numbers.find(d == 0 ? 0.0 : d);
+    return it == index.numbers.end() ? &no_rows : &it->second;
+  }
+  if (value.type() == Value::Type::STRING) {
+    const auto it = index.strings.find(value.toStrUtf8Wrapper().toString());
+    return it == index.strings.end() ? &no_rows : &it->second;
+  }
+  return nullptr;
+}
+
+}  // namespace
+
 Value builtin_search(Arguments arguments, const Location& loc)
 {
   if (arguments.size() < 2 || arguments.size() > 4) {
@@ -780,8 +1008,23 @@ Value builtin_search(Arguments arguments, const Location& loc)
 
   VectorType returnvec(arguments.session());
 
+  // Large tables are indexed once and then reused by subsequent searches of the same table
+  const SearchIndex *index = nullptr;
+  if (searchTable.type() == Value::Type::VECTOR && findThis.type() != Value::Type::STRING &&
+      searchTable.toVector().size() >= TABLE_INDEX_MIN_SIZE) {
+    index = &search_indexes.get(searchTable.toVector(), index_col_num, build_search_index);
+  }
+
   if (findThis.type() == Value::Type::NUMBER) {
     unsigned int matchCount = 0;
+    if (index) {
+      for (const auto row : *find_search_rows(*index, findThis)) {
+        returnvec.emplace_back(double(row));
+        matchCount++;
+        if (num_returns_per_match != 0 && matchCount >= num_returns_per_match) break;
+      }
+      return std::move(returnvec);
+    }
     size_t j = 0;
     for (const auto& search_element : searchTable.toVector()) {
       if ((index_col_num == 0 && (findThis == search_element).toBool()) ||
@@ -807,21 +1050,30 @@ Value builtin_search(Arguments arguments, const Location& loc)
       unsigned int matchCount = 0;
       VectorType resultvec(arguments.session());
 
-      size_t j = 0;
-      for (const auto& search_element : searchTable.toVector()) {
-        if ((index_col_num == 0 && (find_value == search_element).toBool()) ||
-            (index_col_num < search_element.toVector().size() &&
-             (find_value == search_element.toVector()[index_col_num]).toBool())) {
-          matchCount++;
-          if (num_returns_per_match == 1) {
-            returnvec.emplace_back(double(j));
-            break;
-          } else {
-            resultvec.emplace_back(double(j));
+      // Returns true once no further matches are wanted
+      auto add_match = [&](size_t j) {
+        matchCount++;
+        if (num_returns_per_match == 1) {
+          returnvec.emplace_back(double(j));
+          return true;
+        }
+        resultvec.emplace_back(double(j));
+        return num_returns_per_match > 1 && matchCount >= num_returns_per_match;
+      };
+      if (const auto *rows = index ? find_search_rows(*index, find_value) : nullptr) {
+        for (const auto row : *rows) {
+          if (add_match(row)) break;
+        }
+      } else {
+        size_t j = 0;
+        for (const auto& search_element : searchTable.toVector()) {
+          if ((index_col_num == 0 && (find_value == search_element).toBool()) ||
+              (index_col_num < search_element.toVector().size() &&
+               (find_value == search_element.toVector()[index_col_num]).toBool())) {
+            if (add_match(j)) break;
           }
-          if (num_returns_per_match > 1 && matchCount >= num_returns_per_match) break;
+          ++j;
         }
-        ++j;
       }
       if ((num_returns_per_match == 1 && matchCount == 0) || num_returns_per_match == 0 ||
           num_returns_per_match > 1) {
@@ -834,6 +1086,104 @@ Value builtin_search(Arguments arguments, const Location& loc)
   return std::move(returnvec);
 }
 
+namespace {
+
+/*
+   Searches for numbers, or a vector of values, in the rows of a table as they're generated.
+   All values are looked for in each row in turn, which finds the same rows as looking for
+   each value in all rows.
+ */
+class SearchSink : public FlatElementSink
+{
+public:
+  SearchSink(const Value& findThis, unsigned int num_returns_per_match, unsigned int index_col_num)
+    : num_returns_per_match(num_returns_per_match), index_col_num(index_col_num)
+  {
+    if (findThis.type() == Value::Type::VECTOR) {
+      for (const auto& find_value : findThis.toVector()) find_values.push_back(&find_value);
+    } else {
+      find_values.push_back(&findThis);
+    }
+    matches.resize(find_values.size());
+  }
+
+  // The matching rows for each value searched for
+  std::vector<std::vector<uint32_t>> matches;
+
+protected:
+  void element(Value&& search_element) override
+  {
+    for (size_t i = 0; i < find_values.size(); ++i) {
+      if (num_returns_per_match != 0 && matches[i].size() >= num_returns_per_match) continue;
+      const Value& find_value = *find_values[i];
+      if ((index_col_num == 0 && (find_value == search_element).toBool()) ||
+          (index_col_num < search_element.toVector().size() &&
+           (find_value == search_element.toVector()[index_col_num]).toBool())) {
+        matches[i].push_back(row);
+      }
+    }
+    ++row;
+  }
+
+private:
+  const unsigned int num_returns_per_match;
+  const unsigned int index_col_num;
+  std::vector<const Value *> find_values;
+  uint32_t row = 0;
+};
+
+}  // namespace
+
+/*
+   search() of a number or a vector in a list comprehension checks each row as it's generated,
+   without building the table. The other arguments have to be evaluated before the table for
+   this, so it's only done when they can't have side effects.
+ */
+Value builtin_search_fused(const std::shared_ptr<const Context>& context, const FunctionCall *call)
+{
+  const auto& argument_expressions = call->arguments;
+  const Vector *table = argument_expressions.size() >= 2 && argument_expressions.size() <= 4
+                          ? comprehension_argument(call, 1)
+                          : nullptr;
+  for (size_t i = 2; table && i < argument_expressions.size(); ++i) {
+    if (!argument_expressions[i]->getExpr()->isLiteral()) table = nullptr;
+  }
+  if (!table) return builtin_search(Arguments(argument_expressions, context), call->location());
+
+  std::vector<Value> values;
+  for (const auto& argument_expression : argument_expressions) {
+    values.push_back(argument_expression == argument_expressions[1]
+                       ? Value::undefined.clone()
+                       : argument_expression->getExpr()->evaluate(context));
+  }
+  const Value& findThis = values[0];
+  if (findThis.type() != Value::Type::NUMBER && findThis.type() != Value::Type::VECTOR) {
+    values[1] = table->evaluate(context);
+    return builtin_search(Arguments(argument_expressions, values, context->session()), call->location());
+  }
+
+  unsigned int num_returns_per_match = values.size() > 2 ? (unsigned int)values[2].toDouble() : 1;
+  unsigned int index_col_num = values.size() > 3 ? (unsigned int)values[3].toDouble() : 0;
+  SearchSink sink(findThis, num_returns_per_match, index_col_num);
+  table->generate(context, sink);
+
+  VectorType returnvec(context->session());
+  if (findThis.type() == Value::Type::NUMBER) {
+    for (const auto row : sink.matches[0]) returnvec.emplace_back(double(row));
+    return std::move(returnvec);
+  }
+  for (const auto& rows : sink.matches) {
+    if (num_returns_per_match == 1 && !rows.empty()) {
+      returnvec.emplace_back(double(rows[0]));
+    } else {
+      VectorType resultvec(context->session());
+      for (const auto row : rows) resultvec.emplace_back(double(row));
+      returnvec.emplace_back(std::move(resultvec));
+    }
+  }
+  return std::move(returnvec);
+}
+
 Value builtin_version(Arguments arguments, const Location& /*loc*/)
 {
   VectorType vec(arguments.session());
@@ -869,6 +1219,7 @@ Value builtin_parent_module(Arguments arguments, const Location& loc)
 
   int n = trunc(d);
   int s = UserModule::stack_size();
+  arguments.session()->mark_uncacheable();
   if (n < 0) {
     LOG(message_group::Warning, loc, arguments.documentRoot(),
         "Negative parent module index (%1$d) not allowed", n);
@@ -1201,7 +1552,7 @@ void register_builtin_functions()
                    "exp(number) -> number",
                  });
 
-  Builtins::init("len", new BuiltinFunction(&builtin_length),
+  Builtins::init("len", new BuiltinFunction(&builtin_length_fused),
                  {
                    "len(string) -> number",
                    "len(vector) -> number",
@@ -1257,7 +1608,7 @@ void register_builtin_functions()
                  });
 
   Builtins::init(
-    "search", new BuiltinFunction(&builtin_search),
+    "search", new BuiltinFunction(&builtin_search_fused),
     {
       "search(string , string or vector [, num_returns_per_match [, index_col_num ] ] ) -> vector",
     });
@@ -27,6 +27,7 @@
 #include <utility>
 #include <memory>
 #include <cstddef>
+#include <numeric>
 #include <vector>
 
 #include "core/Arguments.h"
@@ -93,7 +94,9 @@ static std::shared_ptr<AbstractNode> builtin_children(const ModuleInstantiation
 
   if (!parameters.contains("index")) {
     // no arguments => all children
-    return children->instantiate(lazyUnionNode(inst));
+    std::vector<size_t> indices(children->size());
+    std::iota(indices.begin(), indices.end(), 0);
+    return children->instantiate(lazyUnionNode(inst), indices);
   }
 
   // one (or more ignored) argument
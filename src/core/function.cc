@@ -42,7 +42,7 @@ BuiltinFunction::BuiltinFunction(Value (*f)(const std::shared_ptr<const Context>
 }
 
 BuiltinFunction::BuiltinFunction(Value (*f)(Arguments, const Location&), const Feature *feature)
-  : feature(feature)
+  : evaluate_arguments(f), feature(feature)
 {
   evaluate = [f](const std::shared_ptr<const Context>& context, const FunctionCall *call) {
     return f(Arguments(call->arguments, context), call->location());
@@ -18,6 +18,8 @@ class BuiltinFunction
 {
 public:
   std::function<Value(const std::shared_ptr<const Context>&, const FunctionCall *)> evaluate;
+  // The function called by evaluate() with the evaluated arguments, if it's that simple
+  Value (*evaluate_arguments)(Arguments, const Location&) = nullptr;
 
 private:
   const Feature *feature;
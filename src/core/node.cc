@@ -29,6 +29,9 @@
 #include "core/ModuleInstantiation.h"
 #include "core/progress.h"
 
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
 #include <deque>
 #include <memory>
 #include <cstddef>
@@ -36,13 +39,132 @@
 #include <iostream>
 #include <algorithm>
 #include <string>
+#include <utility>
+#include <vector>
 
 size_t AbstractNode::idx_counter;
 
+namespace {
+
+// Accumulates words into two independently mixed 64-bit lanes
+class FingerprintHasher
+{
+public:
+  void add(uint64_t word)
+  {
+    this->a = mix(this->a ^ word);
+    this->b = mix(this->b + word * 0x9e3779b97f4a7c15ull);
+  }
+  void add(const std::string& str)
+  {
+    add(uint64_t(str.size()));
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= str.size(); i += sizeof(uint64_t)) {
+      uint64_t word;
+      std::memcpy(&word, str.data() + i, sizeof(word));
+      add(word);
+    }
+    if (i < str.size()) {
+      uint64_t word = 0;
+      std::memcpy(&word, str.data() + i, str.size() - i);
+      add(word);
+    }
+  }
+  void add(const NodeFingerprint& fingerprint)
+  {
+    add(fingerprint.high);
+    add(fingerprint.low);
+  }
+  [[nodiscard]] NodeFingerprint result() const { return {this->a, this->b}; }
+
+private:
+  // splitmix64 finalizer
+  static uint64_t mix(uint64_t x)
+  {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+  uint64_t a{0x243f6a8885a308d3ull};
+  uint64_t b{0x13198a2e03707344ull};
+};
+
+// Plain groups are transparent in fingerprints, the root node is not
+bool isPlainGroup(const AbstractNode& node)
+{
+  return dynamic_cast<const GroupNode *>(&node) && !dynamic_cast<const RootNode *>(&node);
+}
+
+uint64_t modifierFlags(const AbstractNode& node)
+{
+  return (node.modinst->isBackground() ? 1 : 0) | (node.modinst->isHighlight() ? 2 : 0);
+}
+
+}  // namespace
+
+std::string NodeFingerprint::toString() const
+{
+  char buf[33];
+  snprintf(buf, sizeof(buf), "%016" PRIx64 "%016" PRIx64, this->high, this->low);
+  return buf;
+}
+
 AbstractNode::AbstractNode(const ModuleInstantiation *mi) : modinst(mi), idx(idx_counter++) {}
 
 std::string AbstractNode::toString() const { return this->name() + "()"; }
 
+const NodeFingerprint& AbstractNode::fingerprint() const
+{
+  // Post-order walk on an explicit stack, as node trees can be nested deeper than the C++ stack
+  // allows. Once a node's children are done, computeFingerprint() only reads cached fingerprints.
+  std::vector<std::pair<const AbstractNode *, bool>> stack;
+  if (!this->fingerprint_cache) stack.emplace_back(this, false);
+  while (!stack.empty()) {
+    auto& [node, children_done] = stack.back();
+    if (node->fingerprint_cache) {
+      stack.pop_back();
+    } else if (children_done) {
+      node->fingerprint_cache = node->computeFingerprint();
+      stack.pop_back();
+    } else {
+      children_done = true;
+      const AbstractNode *parent = node;
+      for (const auto& child : parent->children) {
+        if (!child->fingerprint_cache) stack.emplace_back(child.get(), false);
+      }
+    }
+  }
+  return *this->fingerprint_cache;
+}
+
+NodeFingerprint AbstractNode::computeFingerprint() const
+{
+  if (isPlainGroup(*this)) {
+    const AbstractNode *single = nullptr;
+    size_t nonempty = 0;
+    for (const auto& child : this->children) {
+      if (!isPlainGroup(*child) || !child->fingerprint().empty()) {
+        single = child.get();
+        ++nonempty;
+      }
+    }
+    if (nonempty == 0) return {};
+    if (nonempty == 1 && modifierFlags(*single) == 0) return single->fingerprint();
+  }
+
+  FingerprintHasher hasher;
+  hasher.add(toString());
+  hasher.add(uint64_t(this->children.size()));
+  for (const auto& child : this->children) {
+    hasher.add(modifierFlags(*child));
+    hasher.add(child->fingerprint());
+  }
+  return hasher.result();
+}
+
 std::shared_ptr<const AbstractNode> AbstractNode::getNodeByID(
   int idx, std::deque<std::shared_ptr<const AbstractNode>>& path) const
 {
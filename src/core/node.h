@@ -3,6 +3,8 @@
 #include <ostream>
 #include <memory>
 #include <cstddef>
+#include <cstdint>
+#include <optional>
 #include <utility>
 #include <vector>
 #include <string>
@@ -21,6 +23,23 @@ void progress_report_prep(const std::shared_ptr<AbstractNode>& root,
                           void *vp);
 void progress_report_fin();
 
+/*!
+   128-bit content hash of a node subtree, see AbstractNode::fingerprint().
+ */
+struct NodeFingerprint {
+  uint64_t high{0};
+  uint64_t low{0};
+
+  [[nodiscard]] bool empty() const { return this->high == 0 && this->low == 0; }
+  bool operator==(const NodeFingerprint& other) const
+  {
+    return this->high == other.high && this->low == other.low;
+  }
+  bool operator!=(const NodeFingerprint& other) const { return !(*this == other); }
+  // 32 hex digits, used as geometry cache key
+  [[nodiscard]] std::string toString() const;
+};
+
 /*!
 
    The node tree is the result of evaluation of a module instantiation
@@ -51,6 +70,15 @@ public:
   const std::vector<std::shared_ptr<AbstractNode>>& getChildren() const { return this->children; }
   int index() const { return this->idx; }
 
+  /*!
+     Identifies the geometry of this subtree across compiles. Computed on first use from
+     the node's evaluated parameters (its toString()), the modifiers of its children and
+     the children's fingerprints. Like the node dump, groups with a single child hash to
+     that child and empty groups to an empty fingerprint. Must only be called once the
+     subtree is fully instantiated.
+   */
+  const NodeFingerprint& fingerprint() const;
+
   static void resetIndexCounter() { idx_counter = 1; }
 
   // FIXME: Make protected
@@ -76,6 +104,11 @@ public:
                             std::vector<std::shared_ptr<const AbstractNode>>& nodes) const;
 
   std::shared_ptr<AbstractNode> clone(void);
+
+private:
+  NodeFingerprint computeFingerprint() const;
+
+  mutable std::optional<NodeFingerprint> fingerprint_cache;
 };
 
 class AbstractIntersectionNode : public AbstractNode
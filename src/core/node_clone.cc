@@ -86,6 +86,7 @@ NodeCloneFunc(CubeNode) NodeCloneFunc(SphereNode) NodeCloneFunc(CylinderNode)
                   if (clone != nullptr)
   {
     clone->idx = idx_counter++;
+    clone->fingerprint_cache.reset();
     clone->children.clear();
     for (const auto& child : this->children) {
       clone->children.push_back(child->clone());
@@ -0,0 +1,77 @@
+#include "core/str_utf8_wrapper.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glib.h>
+
+namespace {
+
+// Strings shorter than this are copied when concatenated, rather than shared
+constexpr size_t CONCAT_MIN_SHARED_SIZE = 256;
+
+}  // namespace
+
+str_utf8_wrapper::str_utf8_t::~str_utf8_t()
+{
+  // Release long chains of prefixes one by one, rather than recursively
+  auto p = std::move(this->prefix);
+  while (p && p.use_count() == 1) p = std::move(p->prefix);
+}
+
+void str_utf8_wrapper::str_utf8_t::flatten()
+{
+  // Collect the parts from the end back to the first one which is flat
+  std::vector<const str_utf8_t *> parts;
+  for (const str_utf8_t *part = this; part; part = part->prefix.get()) parts.push_back(part);
+
+  std::string flat;
+  flat.reserve(this->u8size);
+  for (auto part = parts.rbegin(); part != parts.rend(); ++part) flat += (*part)->u8str;
+  this->u8str = std::move(flat);
+  this->prefix.reset();
+}
+
+size_t str_utf8_wrapper::str_utf8_t::length()
+{
+  if (this->u8len == LENGTH_UNKNOWN) {
+    const std::string& s = str();
+    this->u8len = g_utf8_strlen(s.c_str(), static_cast<gssize>(s.size()));
+  }
+  return this->u8len;
+}
+
+/*!
+   Returns a pointer to code point idx, which must be less than length().
+
+   ASCII strings are indexed directly. Otherwise, an index of the byte offsets of every
+   INDEX_STRIDE-th code point is built on first use, so a lookup walks at most
+   INDEX_STRIDE - 1 code points instead of the whole string.
+ */
+const char *str_utf8_wrapper::str_utf8_t::offset_to_pointer(size_t idx)
+{
+  const std::string& s = str();
+  if (length() == s.size()) return s.c_str() + idx;
+
+  if (this->index.empty()) {
+    this->index.reserve(length() / INDEX_STRIDE + 1);
+    const char *p = s.c_str();
+    const char *end = p + s.size();
+    for (size_t i = 0; p < end; ++i, p = g_utf8_next_char(p)) {
+      if (i % INDEX_STRIDE == 0) this->index.push_back(p - s.c_str());
+    }
+  }
+  const char *p = s.c_str() + this->index[idx / INDEX_STRIDE];
+  for (size_t i = idx % INDEX_STRIDE; i > 0; --i) p = g_utf8_next_char(p);
+  return p;
+}
+
+str_utf8_wrapper str_utf8_wrapper::concat(std::string suffix) const
+{
+  if (suffix.empty()) return this->clone();
+  if (this->size() < CONCAT_MIN_SHARED_SIZE) return {this->toString() + suffix};
+  return str_utf8_wrapper(std::make_shared<str_utf8_t>(this->str_ptr, std::move(suffix)));
+}
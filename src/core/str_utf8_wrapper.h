@@ -6,6 +6,7 @@
 #include <cstddef>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <glib.h>
 
@@ -15,12 +16,41 @@ private:
   // store the cached length in glong, paired with its string
   struct str_utf8_t {
     static constexpr size_t LENGTH_UNKNOWN = -1;
+    // Every INDEX_STRIDE-th code point has its byte offset stored in the index
+    static constexpr size_t INDEX_STRIDE = 32;
     str_utf8_t() : u8str(), u8len(0) {}
     str_utf8_t(std::string s) : u8str(std::move(s)) {}
     str_utf8_t(const char *cstr) : u8str(cstr) {}
     str_utf8_t(const char *cstr, size_t size, size_t u8len) : u8str(cstr, size), u8len(u8len) {}
-    const std::string u8str;
+    // The concatenation of prefix and suffix, which is only built when the string is accessed
+    str_utf8_t(std::shared_ptr<str_utf8_t> prefix, std::string suffix)
+      : u8str(std::move(suffix)), prefix(std::move(prefix))
+    {
+      this->u8size = this->prefix->size() + u8str.size();
+    }
+    str_utf8_t(const str_utf8_t&) = delete;
+    str_utf8_t& operator=(const str_utf8_t&) = delete;
+    ~str_utf8_t();
+
+    const std::string& str()
+    {
+      if (prefix) flatten();
+      return u8str;
+    }
+    size_t size() const { return prefix ? u8size : u8str.size(); }
+    size_t length();
+    const char *offset_to_pointer(size_t idx);
+
+  private:
+    void flatten();
+
+    // Until flattened, only the part of the string following prefix
+    std::string u8str;
+    std::shared_ptr<str_utf8_t> prefix;
+    // Size in bytes, if there's a prefix
+    size_t u8size = 0;
     size_t u8len = LENGTH_UNKNOWN;
+    std::vector<size_t> index;
   };
   // private constructor for copying members
   explicit str_utf8_wrapper(const std::shared_ptr<str_utf8_t>& str_in) : str_ptr(str_in) {}
@@ -86,58 +116,38 @@ public:
     return str_utf8_wrapper(this->str_ptr);
   }  // makes a copy of shared_ptr
 
-  bool operator==(const str_utf8_wrapper& rhs) const
-  {
-    return this->str_ptr->u8str == rhs.str_ptr->u8str;
-  }
-  bool operator!=(const str_utf8_wrapper& rhs) const
-  {
-    return this->str_ptr->u8str != rhs.str_ptr->u8str;
-  }
-  bool operator<(const str_utf8_wrapper& rhs) const { return this->str_ptr->u8str < rhs.str_ptr->u8str; }
-  bool operator>(const str_utf8_wrapper& rhs) const { return this->str_ptr->u8str > rhs.str_ptr->u8str; }
-  bool operator<=(const str_utf8_wrapper& rhs) const
-  {
-    return this->str_ptr->u8str <= rhs.str_ptr->u8str;
-  }
-  bool operator>=(const str_utf8_wrapper& rhs) const
-  {
-    return this->str_ptr->u8str >= rhs.str_ptr->u8str;
-  }
-  [[nodiscard]] bool empty() const { return this->str_ptr->u8str.empty(); }
-  [[nodiscard]] const char *c_str() const { return this->str_ptr->u8str.c_str(); }
-  [[nodiscard]] const std::string& toString() const { return this->str_ptr->u8str; }
-  [[nodiscard]] size_t size() const { return this->str_ptr->u8str.size(); }
+  /*!
+     Returns this string followed by suffix. Long strings are not copied, but shared with the
+     result until it's accessed, so building a string by repeated concatenation, e.g. with
+     str(acc, c) in a recursive function, takes linear rather than quadratic time.
+   */
+  [[nodiscard]] str_utf8_wrapper concat(std::string suffix) const;
+
+  bool operator==(const str_utf8_wrapper& rhs) const { return this->toString() == rhs.toString(); }
+  bool operator!=(const str_utf8_wrapper& rhs) const { return this->toString() != rhs.toString(); }
+  bool operator<(const str_utf8_wrapper& rhs) const { return this->toString() < rhs.toString(); }
+  bool operator>(const str_utf8_wrapper& rhs) const { return this->toString() > rhs.toString(); }
+  bool operator<=(const str_utf8_wrapper& rhs) const { return this->toString() <= rhs.toString(); }
+  bool operator>=(const str_utf8_wrapper& rhs) const { return this->toString() >= rhs.toString(); }
+  [[nodiscard]] bool empty() const { return this->toString().empty(); }
+  [[nodiscard]] const char *c_str() const { return this->toString().c_str(); }
+  [[nodiscard]] const std::string& toString() const { return this->str_ptr->str(); }
+  [[nodiscard]] size_t size() const { return this->str_ptr->size(); }
   str_utf8_wrapper operator[](const size_t idx) const
   {
-    if (idx < this->size()) {
-      // Ensure character (not byte) index is inside the character/glyph array
-      if (idx < this->get_utf8_strlen()) {
-        gchar utf8_of_cp[6] = "";  // A buffer for a single unicode character to be copied into
-        auto ptr = g_utf8_offset_to_pointer(str_ptr->u8str.c_str(), idx);
-        if (ptr) {
-          g_utf8_strncpy(utf8_of_cp, ptr, 1);
-        }
-        return std::string(utf8_of_cp);
-      }
-    }
-    return {};
+    // Ensure character (not byte) index is inside the character/glyph array
+    if (idx >= this->get_utf8_strlen()) return {};
+    const char *ptr = str_ptr->offset_to_pointer(idx);
+    const char *next = g_utf8_next_char(ptr);
+    const char *end = this->c_str() + this->size();
+    return {ptr, static_cast<size_t>((next < end ? next : end) - ptr)};
   }
 
-  [[nodiscard]] size_t get_utf8_strlen() const
-  {
-    if (str_ptr->u8len == str_utf8_t::LENGTH_UNKNOWN) {
-      str_ptr->u8len = g_utf8_strlen(str_ptr->u8str.c_str(), static_cast<gssize>(str_ptr->u8str.size()));
-    }
-    return str_ptr->u8len;
-  }
+  [[nodiscard]] size_t get_utf8_strlen() const { return str_ptr->length(); }
 
-  [[nodiscard]] uint32_t get_utf8_char() const { return g_utf8_get_char(str_ptr->u8str.c_str()); }
+  [[nodiscard]] uint32_t get_utf8_char() const { return g_utf8_get_char(this->c_str()); }
 
-  [[nodiscard]] bool utf8_validate() const
-  {
-    return g_utf8_validate(str_ptr->u8str.c_str(), -1, nullptr);
-  }
+  [[nodiscard]] bool utf8_validate() const { return g_utf8_validate(this->c_str(), -1, nullptr); }
 
 private:
   std::shared_ptr<str_utf8_t> str_ptr;
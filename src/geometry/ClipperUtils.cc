@@ -2,21 +2,30 @@
 #include "geometry/linalg.h"
 #include "geometry/Polygon2d.h"
 #include "clipper2/clipper.h"
+#include "utils/parallel.h"
 #include "utils/printutils.h"
 
 #include <algorithm>
 #include <clipper2/clipper.engine.h>
 #include <cmath>
 #include <cassert>
+#include <iterator>
 #include <utility>
 #include <memory>
 #include <cstddef>
+#include <cstdint>
+#include <numeric>
 #include <vector>
 
 namespace ClipperUtils {
 
 namespace {
 
+// Number of paths unionGroups() unions in one go when splitting up many same-signed paths
+constexpr size_t UNION_CHUNK_SIZE = 256;
+// Number of partial unions unionGroups() merges in one go
+constexpr size_t UNION_FAN_IN = 8;
+
 Clipper2Lib::Paths64 process(const Clipper2Lib::Paths64& polygons, Clipper2Lib::ClipType cliptype,
                              Clipper2Lib::FillRule polytype)
 {
@@ -76,17 +85,18 @@ void minkowski_outline(const Clipper2Lib::Path64& poly, const Clipper2Lib::Path6
 // Add the polygon a translated to an arbitrary point of each separate component of b.
 // Ideally, we would translate to the midpoint of component b, but the point can
 // be chosen arbitrarily since the translated object would always stay inside
-// the minkowski sum.
+// the minkowski sum. Each translated copy is kept in a group of its own, as its holes
+// must be unioned together with its outlines.
 void fill_minkowski_insides(const Clipper2Lib::Paths64& a, const Clipper2Lib::Paths64& b,
-                            Clipper2Lib::Paths64& target)
+                            std::vector<Clipper2Lib::Paths64>& groups)
 {
   for (const auto& b_path : b) {
     // We only need to add for positive components of b
     if (!b_path.empty() && Clipper2Lib::IsPositive(b_path) == 1) {
       const auto& delta = b_path[0];  // arbitrary point
-      for (const auto& path : a) {
-        target.push_back(path);
-        for (auto& point : target.back()) {
+      groups.push_back(a);
+      for (auto& path : groups.back()) {
+        for (auto& point : path) {
           point.x += delta.x;
           point.y += delta.y;
         }
@@ -95,6 +105,118 @@ void fill_minkowski_insides(const Clipper2Lib::Paths64& a, const Clipper2Lib::Pa
   }
 }
 
+// Splits paths which all have positive winding into chunks, which may be unioned separately
+void appendChunks(Clipper2Lib::Paths64&& paths, std::vector<Clipper2Lib::Paths64>& groups)
+{
+  for (size_t start = 0; start < paths.size(); start += UNION_CHUNK_SIZE) {
+    const size_t end = std::min(start + UNION_CHUNK_SIZE, paths.size());
+    groups.emplace_back(std::make_move_iterator(paths.begin() + start),
+                        std::make_move_iterator(paths.begin() + end));
+  }
+}
+
+/*!
+   Unions groups of paths with the NonZero fill rule and adds the result to clipper as subjects,
+   ready for a final union.
+
+   Each group is unioned on its own first, so a group must not rely on paths of other groups to
+   cancel out its holes. The partial results are then merged UNION_FAN_IN at a time until few
+   are left. All unions of a pass run in parallel.
+ */
+void unionGroups(std::vector<Clipper2Lib::Paths64>&& groups, Clipper2Lib::Clipper64& clipper)
+{
+  const auto unionRange = [&groups](size_t start, size_t count) {
+    Clipper2Lib::Clipper64 clipper;
+    clipper.PreserveCollinear(false);
+    const size_t end = std::min(start + count, groups.size());
+    for (size_t i = start; i < end; ++i) clipper.AddSubject(groups[i]);
+    Clipper2Lib::Paths64 result;
+    clipper.Execute(Clipper2Lib::ClipType::Union, Clipper2Lib::FillRule::NonZero, result);
+    return result;
+  };
+  size_t count = 1;
+  while (count == 1 || groups.size() > UNION_FAN_IN) {
+    std::vector<size_t> starts;
+    for (size_t start = 0; start < groups.size(); start += count) starts.push_back(start);
+    std::vector<Clipper2Lib::Paths64> unions(starts.size());
+    parallelizable_transform(starts.begin(), starts.end(), unions.begin(),
+                             [&](size_t start) { return unionRange(start, count); });
+    groups = std::move(unions);
+    count = UNION_FAN_IN;
+  }
+  for (const auto& paths : groups) clipper.AddSubject(paths);
+}
+
+// True if path is a convex outline with positive winding. Collinear vertices are accepted.
+bool isConvex(const Clipper2Lib::Path64& path)
+{
+  const size_t n = path.size();
+  if (n < 3 || !Clipper2Lib::IsPositive(path)) return false;
+  // All turns must go left, and the outline must not wind around more than once,
+  // so the direction of its edges turns from up to down and back only once.
+  int ysign_changes = 0, last_ysign = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const auto& prev = path[(i + n - 1) % n];
+    const auto& curr = path[i];
+    const auto& next = path[(i + 1) % n];
+    const double cross = Clipper2Lib::CrossProduct(prev, curr, next);
+    if (cross < 0) return false;
+    if (cross == 0 && Clipper2Lib::DotProduct(prev, curr, next) < 0) return false;
+    const int ysign = (next.y > curr.y) - (next.y < curr.y);
+    if (ysign != 0) {
+      if (last_ysign != 0 && ysign != last_ysign) ++ysign_changes;
+      last_ysign = ysign;
+    }
+  }
+  return ysign_changes <= 2;
+}
+
+/*!
+   Minkowski sum of two convex outlines with positive winding, in O(n+m).
+
+   Both outlines are walked from their bottom-most vertex, merging their edges by angle.
+   The result may contain collinear vertices.
+ */
+Clipper2Lib::Path64 convexMinkowskiSum(const Clipper2Lib::Path64& a, const Clipper2Lib::Path64& b)
+{
+  const auto bottom = [](const Clipper2Lib::Path64& path) {
+    Clipper2Lib::Path64 rotated(path);
+    auto first = std::min_element(rotated.begin(), rotated.end(), [](const auto& p, const auto& q) {
+      return p.y < q.y || (p.y == q.y && p.x < q.x);
+    });
+    std::rotate(rotated.begin(), first, rotated.end());
+    // Close the outline so that edge i always runs from vertex i to i + 1
+    rotated.push_back(rotated[0]);
+    rotated.push_back(rotated[1]);
+    return rotated;
+  };
+  const Clipper2Lib::Path64 p = bottom(a);
+  const Clipper2Lib::Path64 q = bottom(b);
+  const size_t n = a.size(), m = b.size();
+
+  Clipper2Lib::Path64 sum;
+  sum.reserve(n + m);
+  const auto edge = [](const Clipper2Lib::Path64& path, size_t k) {
+    return Vector2d(path[k + 1].x - path[k].x, path[k + 1].y - path[k].y);
+  };
+  size_t i = 0, j = 0;
+  while (i < n || j < m) {
+    sum.emplace_back(p[i].x + q[j].x, p[i].y + q[j].y);
+    if (i == n) {
+      ++j;
+    } else if (j == m) {
+      ++i;
+    } else {
+      const Vector2d u = edge(p, i), v = edge(q, j);
+      const double cross = u.x() * v.y() - u.y() * v.x();
+      // Parallel edges are merged into one
+      if (cross >= 0) ++i;
+      if (cross <= 0) ++j;
+    }
+  }
+  return sum;
+}
+
 void SimplifyPolyTree(const Clipper2Lib::PolyPath64& polytree, double epsilon,
                       Clipper2Lib::PolyPath64& result)
 {
@@ -105,6 +227,79 @@ void SimplifyPolyTree(const Clipper2Lib::PolyPath64& polytree, double epsilon,
   }
 }
 
+// Sanitized polygons with fewer islands than this are offset in one go
+constexpr size_t OFFSET_MIN_PARALLEL_ISLANDS = 16;
+
+// Splits a polytree into islands: outlines with their holes. Islands inside holes are separate islands.
+void collectIslands(const Clipper2Lib::PolyPath64& node, std::vector<Clipper2Lib::Paths64>& islands)
+{
+  for (const auto& outer : node) {
+    Clipper2Lib::Paths64 island{outer->Polygon()};
+    for (const auto& hole : *outer) {
+      island.push_back(hole->Polygon());
+      collectIslands(*hole, islands);
+    }
+    islands.push_back(std::move(island));
+  }
+}
+
+/*!
+   Groups islands whose bounding boxes, grown by margin on each side, overlap directly or
+   through other islands. Returns the island indices of each group, in order of their first island.
+ */
+std::vector<std::vector<size_t>> overlappingIslands(const std::vector<Clipper2Lib::Paths64>& islands,
+                                                    int64_t margin)
+{
+  std::vector<Clipper2Lib::Rect64> bounds;
+  bounds.reserve(islands.size());
+  for (const auto& island : islands) {
+    // The outline contains the holes
+    auto rect = Clipper2Lib::GetBounds(island.front());
+    rect.left -= margin;
+    rect.top -= margin;
+    rect.right += margin;
+    rect.bottom += margin;
+    bounds.push_back(rect);
+  }
+
+  std::vector<size_t> parent(islands.size());
+  std::iota(parent.begin(), parent.end(), 0);
+  const auto find = [&parent](size_t i) {
+    while (parent[i] != i) i = parent[i] = parent[parent[i]];
+    return i;
+  };
+
+  // Sweep along x, so each island is only compared with those overlapping it in x
+  std::vector<size_t> order(islands.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&bounds](size_t a, size_t b) { return bounds[a].left < bounds[b].left; });
+  std::vector<size_t> active;
+  for (const size_t i : order) {
+    active.erase(std::remove_if(active.begin(), active.end(),
+                                [&](size_t j) { return bounds[j].right < bounds[i].left; }),
+                 active.end());
+    for (const size_t j : active) {
+      if (bounds[j].top <= bounds[i].bottom && bounds[i].top <= bounds[j].bottom) {
+        parent[find(i)] = find(j);
+      }
+    }
+    active.push_back(i);
+  }
+
+  std::vector<std::vector<size_t>> groups;
+  std::vector<size_t> group_index(islands.size(), islands.size());
+  for (size_t i = 0; i < islands.size(); ++i) {
+    const size_t root = find(i);
+    if (group_index[root] == islands.size()) {
+      group_index[root] = groups.size();
+      groups.emplace_back();
+    }
+    groups[group_index[root]].push_back(i);
+  }
+  return groups;
+}
+
 }  // namespace
 
 // Using 1 bit less precision than the maximum possible, to limit the chance
@@ -298,27 +493,35 @@ std::unique_ptr<Polygon2d> applyMinkowski(const std::vector<std::shared_ptr<cons
 
   for (size_t i = 1; i < polygons.size(); ++i) {
     if (!polygons[i]) continue;
-    Clipper2Lib::Paths64 minkowski_terms;
     auto rhs = fromPolygon2d(*polygons[i], scale_bits);
+    clipper.Clear();
 
-    // First, convolve each outline of lhs with the outlines of rhs
-    for (auto const& rhs_path : rhs) {
-      for (auto const& lhs_path : lhs) {
-        Clipper2Lib::Paths64 result;
-        minkowski_outline(lhs_path, rhs_path, result, true, true);
-        minkowski_terms.insert(minkowski_terms.end(), result.begin(), result.end());
-      }
+    if (lhs.size() == 1 && rhs.size() == 1 && isConvex(lhs[0]) && isConvex(rhs[0])) {
+      // The sum of two convex outlines is the convex outline made of both their edges
+      clipper.AddSubject(Clipper2Lib::Paths64{convexMinkowskiSum(lhs[0], rhs[0])});
+    } else {
+      // First, convolve each outline of lhs with the outlines of rhs, all pairs in parallel
+      std::vector<Clipper2Lib::Paths64> outlines(lhs.size() * rhs.size());
+      parallelizable_cross_product_transform(rhs, lhs, outlines.begin(),
+                                             [](const Clipper2Lib::Path64& rhs_path,
+                                                const Clipper2Lib::Path64& lhs_path) {
+                                               Clipper2Lib::Paths64 result;
+                                               minkowski_outline(lhs_path, rhs_path, result, true, true);
+                                               return result;
+                                             });
+      // The quads all have positive winding, so they can be unioned in any grouping
+      std::vector<Clipper2Lib::Paths64> minkowski_terms;
+      for (auto& quads : outlines) appendChunks(std::move(quads), minkowski_terms);
+
+      // Then, fill the central parts
+      fill_minkowski_insides(lhs, rhs, minkowski_terms);
+      fill_minkowski_insides(rhs, lhs, minkowski_terms);
+
+      // This union operation must be performed at each iteration since the minkowski_terms
+      // now contain lots of small quads
+      unionGroups(std::move(minkowski_terms), clipper);
     }
 
-    // Then, fill the central parts
-    fill_minkowski_insides(lhs, rhs, minkowski_terms);
-    fill_minkowski_insides(rhs, lhs, minkowski_terms);
-
-    // This union operation must be performed at each iteration since the minkowski_terms
-    // now contain lots of small quads
-    clipper.Clear();
-    clipper.AddSubject(minkowski_terms);
-
     if (i != polygons.size() - 1) {
       clipper.Execute(Clipper2Lib::ClipType::Union, Clipper2Lib::FillRule::NonZero, lhs);
     }
@@ -329,6 +532,13 @@ std::unique_ptr<Polygon2d> applyMinkowski(const std::vector<std::shared_ptr<cons
   return toPolygon2d(polytree, scale_bits);
 }
 
+/*!
+   Offsets the polygon with Clipper.
+
+   Offsetting is local, so islands of a sanitized polygon which stay apart after offsetting
+   are offset separately, in parallel. Only islands which might touch are offset together,
+   which unions them.
+ */
 std::unique_ptr<Polygon2d> applyOffset(const Polygon2d& poly, double offset,
                                        Clipper2Lib::JoinType joinType, double miter_limit,
                                        double arc_tolerance)
@@ -336,30 +546,75 @@ std::unique_ptr<Polygon2d> applyOffset(const Polygon2d& poly, double offset,
   const bool isMiter = joinType == Clipper2Lib::JoinType::Miter;
   const bool isRound = joinType == Clipper2Lib::JoinType::Round;
   const int scale_bits = scaleBitsFromPrecision();
-  Clipper2Lib::ClipperOffset co(isMiter ? miter_limit : 2.0,
-                                isRound ? std::ldexp(arc_tolerance, scale_bits) : 1.0);
+  const double clipper_miter_limit = isMiter ? miter_limit : 2.0;
+  const auto offsetPaths = [&](const Clipper2Lib::Paths64& paths) {
+    Clipper2Lib::ClipperOffset co(clipper_miter_limit,
+                                  isRound ? std::ldexp(arc_tolerance, scale_bits) : 1.0);
+    co.AddPaths(paths, joinType, Clipper2Lib::EndType::Polygon);
+    Clipper2Lib::PolyTree64 result;
+    co.Execute(std::ldexp(offset, scale_bits), result);
+    return toPolygon2d(result, scale_bits);
+  };
+
   auto p = ClipperUtils::fromPolygon2d(poly, scale_bits);
-  co.AddPaths(p, joinType, Clipper2Lib::EndType::Polygon);
-  Clipper2Lib::PolyTree64 result;
-  co.Execute(std::ldexp(offset, scale_bits), result);
-  return toPolygon2d(result, scale_bits);
+  const auto is_island = [](const Outline2d& outline) { return outline.positive; };
+  const auto num_islands =
+    static_cast<size_t>(std::count_if(poly.outlines().begin(), poly.outlines().end(), is_island));
+  if (!poly.isSanitized() || num_islands < OFFSET_MIN_PARALLEL_ISLANDS) {
+    return offsetPaths(p);
+  }
+
+  std::vector<Clipper2Lib::Paths64> islands;
+  collectIslands(*sanitize(p), islands);
+  // Outlines grow by at most the miter limit times the offset, holes stay inside their island
+  const double growth = std::max(offset, 0.0) * clipper_miter_limit;
+  const auto margin = static_cast<int64_t>(std::ceil(std::ldexp(growth, scale_bits))) + 1;
+  const auto groups = overlappingIslands(islands, margin);
+  if (groups.size() < 2) return offsetPaths(p);
+
+  std::vector<std::unique_ptr<Polygon2d>> parts(groups.size());
+  parallelizable_transform(groups.begin(), groups.end(), parts.begin(), [&](const auto& group) {
+    Clipper2Lib::Paths64 paths;
+    for (const size_t i : group) paths.insert(paths.end(), islands[i].begin(), islands[i].end());
+    return offsetPaths(paths);
+  });
+  auto result = std::make_unique<Polygon2d>();
+  for (const auto& part : parts) {
+    for (const auto& outline : part->outlines()) result->addOutline(outline);
+  }
+  result->setSanitized(true);
+  return result;
 }
 
+/*!
+   Unions the projections of mesh facets and other 2D shapes.
+
+   Unsanitized polygons are taken to be collections of facet outlines, which are
+   unioned regardless of their winding. The outlines are unioned in chunks,
+   in parallel, and the partial results are unioned again until one is left.
+ */
 std::unique_ptr<Polygon2d> applyProjection(const std::vector<std::shared_ptr<const Polygon2d>>& polygons)
 {
   const int scale_bits = scaleBitsFromPrecision();
 
-  Clipper2Lib::Clipper64 sumclipper;
-  sumclipper.PreserveCollinear(false);
+  std::vector<Clipper2Lib::Paths64> groups;
   for (const auto& poly : polygons) {
-    Clipper2Lib::Paths64 result = ClipperUtils::fromPolygon2d(*poly, scale_bits);
-    // Using NonZero ensures that we don't create holes from polygons sharing
-    // edges since we're unioning a mesh
-    result = ClipperUtils::process(result, Clipper2Lib::ClipType::Union, Clipper2Lib::FillRule::NonZero);
-    // Add correctly winded polygons to the main clipper
-    sumclipper.AddSubject(result);
+    auto paths = ClipperUtils::fromPolygon2d(*poly, scale_bits);
+    if (poly->isSanitized() || paths.size() <= UNION_CHUNK_SIZE) {
+      // Holes of sanitized polygons would cancel out other polygons, so they're unioned on their own
+      groups.push_back(std::move(paths));
+    } else {
+      // Consecutive facets tend to be neighbors, so chunks of them merge well
+      appendChunks(std::move(paths), groups);
+    }
   }
+  if (groups.empty()) return {};
 
+  // Using NonZero ensures that we don't create holes from polygons sharing
+  // edges since we're unioning a mesh
+  Clipper2Lib::Clipper64 sumclipper;
+  sumclipper.PreserveCollinear(false);
+  unionGroups(std::move(groups), sumclipper);
   Clipper2Lib::PolyTree64 sumresult;
   // This is key - without StrictlySimple, we tend to get self-intersecting results
   // FIXME: StrictlySimple doesn't exist in Clipper2. Check if it still exposes problems without
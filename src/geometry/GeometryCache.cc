@@ -10,20 +10,27 @@
 #include "geometry/cgal/CGALNefGeometry.h"
 #endif
 
-GeometryCache *GeometryCache::inst = nullptr;
+GeometryCache *GeometryCache::instance()
+{
+  // Intentionally leaked, geometries may depend on other static state during shutdown
+  static auto *inst = new GeometryCache;
+  return inst;
+}
 
 std::shared_ptr<const Geometry> GeometryCache::get(const std::string& id) const
 {
-  const auto& geom = this->cache[id]->geom;
+  const auto entry = this->cache.get(id);
+  const auto geom = entry ? entry->geom : nullptr;
 #ifdef DEBUG
   PRINTDB("Geometry Cache hit: %s (%d bytes)", id.substr(0, 40) % (geom ? geom->memsize() : 0));
 #endif
   return geom;
 }
 
-bool GeometryCache::insert(const std::string& id, const std::shared_ptr<const Geometry>& geom)
+bool GeometryCache::insert(const std::string& id, const std::shared_ptr<const Geometry>& geom,
+                           double recompute_us)
 {
-  auto inserted = this->cache.insert(id, new cache_entry(geom), geom ? geom->memsize() : 0);
+  auto inserted = this->cache.insert(id, cache_entry(geom), geom ? geom->memsize() : 0, recompute_us);
 #if defined(ENABLE_CGAL) && defined(DEBUG)
   assert(!dynamic_cast<const CGALNefGeometry *>(geom.get()));
   if (inserted)
@@ -1,26 +1,29 @@
 #pragma once
 
 #include <cstddef>
+#include <limits>
 #include <memory>
 #include <string>
 
-#include "Cache.h"
+#include "ShardedCache.h"
 #include "geometry/Geometry.h"
 
 class GeometryCache
 {
 public:
-  GeometryCache(size_t memorylimit = 100ul * 1024ul * 1024ul) : cache(memorylimit) {}
-
-  static GeometryCache *instance()
+  // By default, only the global CacheManager budget limits the cache size
+  GeometryCache(size_t memorylimit = std::numeric_limits<size_t>::max())
+    : cache("geometry_cache", memorylimit)
   {
-    if (!inst) inst = new GeometryCache;
-    return inst;
   }
 
+  static GeometryCache *instance();
+
   bool contains(const std::string& id) const { return this->cache.contains(id); }
   std::shared_ptr<const class Geometry> get(const std::string& id) const;
-  bool insert(const std::string& id, const std::shared_ptr<const Geometry>& geom);
+  // recompute_us is the time it took to create geom, used to decide what to evict first
+  bool insert(const std::string& id, const std::shared_ptr<const Geometry>& geom,
+              double recompute_us = 0);
   size_t size() const;
   size_t totalCost() const;
   size_t maxSizeMB() const;
@@ -29,13 +32,11 @@ public:
   void print();
 
 private:
-  static GeometryCache *inst;
-
   struct cache_entry {
     std::shared_ptr<const class Geometry> geom;
     std::string msg;
     cache_entry(const std::shared_ptr<const Geometry>& geom);
   };
 
-  Cache<std::string, cache_entry> cache;
+  ShardedCache<cache_entry> cache;
 };
@@ -36,7 +36,9 @@
 #include "utils/calc.h"
 #include "utils/degree_trig.h"
 #include "utils/printutils.h"
+#include "utils/Profiler.h"
 
+#include <chrono>
 #include <iterator>
 #include <cassert>
 #include <list>
@@ -44,11 +46,13 @@
 #include <memory>
 #ifdef ENABLE_CGAL
 #include "geometry/cgal/CGALCache.h"
+#include "geometry/cgal/CGALNefGeometry.h"
 #include "geometry/cgal/cgalutils.h"
 #include <CGAL/convex_hull_2.h>
 #include <CGAL/Point_2.h>
 #endif
 #ifdef ENABLE_MANIFOLD
+#include "geometry/manifold/ManifoldGeometry.h"
 #include "geometry/manifold/manifoldutils.h"
 #endif
 
@@ -60,6 +64,33 @@ class Tree;
 
 GeometryEvaluator::GeometryEvaluator(const Tree& tree) : tree(tree) {}
 
+#if defined(ENABLE_MANIFOLD) && defined(ENABLE_CGAL)
+/*!
+   Returns geom in the representation of the Manifold backend if that's in use.
+
+   Nef polyhedra only show up in Manifold renders when imported or left in the cache by an
+   earlier CGAL render. Converting them once here lets transforms stay lazy, instead of being
+   done in exact arithmetic, and saves every later operation from converting them again.
+   The conversion is cached next to the Nef polyhedron, which stays cached for CGAL renders.
+ */
+static std::shared_ptr<const Geometry> toBackendGeometry(const std::shared_ptr<const Geometry>& geom)
+{
+  if (RenderSettings::inst()->backend3D != RenderBackend3D::ManifoldBackend) return geom;
+  if (!std::dynamic_pointer_cast<const CGALNefGeometry>(geom)) return geom;
+  auto *cache = CGALCache::instance();
+  if (auto manifold = std::dynamic_pointer_cast<const ManifoldGeometry>(cache->getConverted(geom))) {
+    return manifold;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  if (auto manifold = ManifoldUtils::createManifoldFromGeometry(geom)) {
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    cache->insertConverted(geom, manifold, elapsed.count());
+    return manifold;
+  }
+  return geom;
+}
+#endif
+
 /*!
    Set allownef to false to force the result to _not_ be a Nef polyhedron
 
@@ -77,11 +108,15 @@ std::shared_ptr<const Geometry> GeometryEvaluator::evaluateGeometry(const Abstra
     // If not found in any caches, we need to evaluate the geometry
     // traverse() will set this->root to a geometry, which can be any geometry
     // (including GeometryList if the lazyunions feature is enabled)
+    // Evaluation times are only needed for the cache inserts of this traversal. The evaluator can be
+    // reused for many traversals, and one which threw may have left some behind.
+    this->evaluationTimes.clear();
     this->traverse(node);
     result = this->root;
 
     // Insert the raw result into the cache.
     smartCacheInsert(node, result);
+    this->evaluationTimes.clear();
   }
 
   // Convert engine-specific 3D geometry to PolySet if needed
@@ -179,6 +214,9 @@ GeometryEvaluator::ResultObject GeometryEvaluator::applyToChildren3D(const Abstr
     }
 #endif
 #ifdef ENABLE_CGAL
+    if (RenderSettings::inst()->backend3D == RenderBackend3D::CorefinementBackend) {
+      return ResultObject::constResult(CGALUtils::applyOperator3DCorefine(actualchildren, op));
+    }
     return ResultObject::constResult(std::shared_ptr<const Geometry>(
       CGALUtils::applyUnion3D(actualchildren.begin(), actualchildren.end())));
 #else
@@ -193,6 +231,9 @@ GeometryEvaluator::ResultObject GeometryEvaluator::applyToChildren3D(const Abstr
     }
 #endif
 #ifdef ENABLE_CGAL
+    if (RenderSettings::inst()->backend3D == RenderBackend3D::CorefinementBackend) {
+      return ResultObject::constResult(CGALUtils::applyOperator3DCorefine(children, op));
+    }
     return ResultObject::constResult(CGALUtils::applyOperator3D(children, op));
 #else
     assert(false && "No boolean backend available");
@@ -330,11 +371,13 @@ std::vector<std::shared_ptr<const Polygon2d>> GeometryEvaluator::collectChildren
 void GeometryEvaluator::smartCacheInsert(const AbstractNode& node,
                                          const std::shared_ptr<const Geometry>& geom)
 {
-  const std::string& key = this->tree.getIdString(node);
+  const std::string key = node.fingerprint().toString();
+  const auto time = this->evaluationTimes.find(node.index());
+  const double recompute_us = time != this->evaluationTimes.end() ? time->second : 0;
 
   if (CGALCache::acceptsGeometry(geom)) {
     if (!CGALCache::instance()->contains(key)) {
-      CGALCache::instance()->insert(key, geom);
+      CGALCache::instance()->insert(key, geom, recompute_us);
     }
   } else if (!GeometryCache::instance()->contains(key)) {
     // FIXME: Sanity-check Polygon2d as well?
@@ -343,7 +386,7 @@ void GeometryEvaluator::smartCacheInsert(const AbstractNode& node,
     // }
 
     // Perhaps add acceptsGeometry() to GeometryCache as well?
-    if (!GeometryCache::instance()->insert(key, geom)) {
+    if (!GeometryCache::instance()->insert(key, geom, recompute_us)) {
       LOG(message_group::Warning, "GeometryEvaluator: Node didn't fit into cache.");
     }
   }
@@ -351,21 +394,40 @@ void GeometryEvaluator::smartCacheInsert(const AbstractNode& node,
 
 bool GeometryEvaluator::isSmartCached(const AbstractNode& node)
 {
-  const std::string& key = this->tree.getIdString(node);
+  const std::string key = node.fingerprint().toString();
   return GeometryCache::instance()->contains(key) || CGALCache::instance()->contains(key);
 }
 
 std::shared_ptr<const Geometry> GeometryEvaluator::smartCacheGet(const AbstractNode& node,
                                                                  bool preferNef)
 {
-  const std::string& key = this->tree.getIdString(node);
+  const std::string key = node.fingerprint().toString();
   const bool hasgeom = GeometryCache::instance()->contains(key);
   const bool hascgal = CGALCache::instance()->contains(key);
-  if (hascgal && (preferNef || !hasgeom)) return CGALCache::instance()->get(key);
+  if (hascgal && (preferNef || !hasgeom)) {
+    auto geom = CGALCache::instance()->get(key);
+#if defined(ENABLE_MANIFOLD) && defined(ENABLE_CGAL)
+    return toBackendGeometry(geom);
+#else
+    return geom;
+#endif
+  }
   if (hasgeom) return GeometryCache::instance()->get(key);
   return {};
 }
 
+/*!
+   Returns a mutable copy of res to transform in place, in the representation of the 3D backend.
+ */
+std::shared_ptr<Geometry> GeometryEvaluator::mutableBackendGeometry(ResultObject& res)
+{
+#if defined(ENABLE_MANIFOLD) && defined(ENABLE_CGAL)
+  const auto geom = res.constptr();
+  if (auto converted = toBackendGeometry(geom); converted != geom) return converted->copy();
+#endif
+  return res.asMutableGeometry();
+}
+
 /*!
    Returns a list of 3D Geometry children of the given node.
    May return empty geometries, but not nullptr objects
@@ -452,6 +514,14 @@ std::unique_ptr<Polygon2d> GeometryEvaluator::applyToChildren2D(const AbstractNo
 void GeometryEvaluator::addToParent(const State& state, const AbstractNode& node,
                                     const std::shared_ptr<const Geometry>& geom)
 {
+  if (!this->profileStack.empty() && geom) {
+    this->profileStack.back().facets = static_cast<int64_t>(geom->numFacets());
+  }
+  if (!this->nodeStartTimes.empty()) {
+    const std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - this->nodeStartTimes.back();
+    this->evaluationTimes[node.index()] = elapsed.count();
+  }
   this->visitedchildren.erase(node.index());
   if (state.parent()) {
     this->visitedchildren[state.parent()->index()].push_back(
@@ -463,6 +533,24 @@ void GeometryEvaluator::addToParent(const State& state, const AbstractNode& node
   }
 }
 
+void GeometryEvaluator::enterNode(const AbstractNode& node)
+{
+  this->nodeStartTimes.push_back(std::chrono::steady_clock::now());
+  if (!Profiler::enabled()) return;
+  const auto& loc = node.modinst ? node.modinst->location() : Location::NONE;
+  auto event = Profiler::begin("geometry", node.verbose_name(), loc);
+  event.cache_hit = isSmartCached(node) ? 1 : 0;
+  this->profileStack.push_back(std::move(event));
+}
+
+void GeometryEvaluator::leaveNode(const AbstractNode& /*node*/)
+{
+  this->nodeStartTimes.pop_back();
+  if (this->profileStack.empty()) return;
+  Profiler::end(this->profileStack.back());
+  this->profileStack.pop_back();
+}
+
 Response GeometryEvaluator::visit(State& state, const ColorNode& node)
 {
   if (state.isPrefix() && isSmartCached(node)) return Response::PruneTraversal;
@@ -631,9 +719,13 @@ Response GeometryEvaluator::visit(State& state, const RenderNode& node)
     std::shared_ptr<const Geometry> geom;
     if (!isSmartCached(node)) {
       ResultObject res = applyToChildren(node, OpenSCADOperator::UNION);
-      auto mutableGeom = res.asMutableGeometry();
-      if (mutableGeom) mutableGeom->setConvexity(node.convexity);
-      geom = mutableGeom;
+      geom = res.constptr();
+      // Only copy the geometry if its convexity actually changes
+      if (geom && geom->getConvexity() != node.convexity) {
+        auto mutableGeom = res.asMutableGeometry();
+        mutableGeom->setConvexity(node.convexity);
+        geom = mutableGeom;
+      }
     } else {
       geom = smartCacheGet(node, state.preferNef());
     }
@@ -680,7 +772,7 @@ Response GeometryEvaluator::visit(State& state, const TextNode& node)
       auto polygonlist = node.createPolygonList();
       geom = ClipperUtils::apply(polygonlist, Clipper2Lib::ClipType::Union);
     } else {
-      geom = GeometryCache::instance()->get(this->tree.getIdString(node));
+      geom = GeometryCache::instance()->get(node.fingerprint().toString());
     }
     addToParent(state, node, geom);
     node.progress_report();
@@ -751,7 +843,7 @@ Response GeometryEvaluator::visit(State& state, const TransformNode& node)
               geom = ClipperUtils::sanitize(*polygons);
             }
           } else if (geom->getDimension() == 3) {
-            auto mutableGeom = res.asMutableGeometry();
+            auto mutableGeom = mutableBackendGeometry(res);
             if (mutableGeom) mutableGeom->transform(node.matrix);
             geom = mutableGeom;
           }
@@ -954,7 +1046,7 @@ Response GeometryEvaluator::visit(State& state, const CgalAdvNode& node)
       }
       case CgalAdvType::RESIZE: {
         ResultObject res = applyToChildren(node, OpenSCADOperator::UNION);
-        auto editablegeom = res.asMutableGeometry();
+        auto editablegeom = mutableBackendGeometry(res);
         geom = editablegeom;
         if (editablegeom) {
           editablegeom->setConvexity(node.convexity);
@@ -4,8 +4,10 @@
 #include "geometry/linalg.h"
 #include "core/enums.h"
 #include "geometry/Geometry.h"
+#include "utils/Profiler.h"
 
 #include <cassert>
+#include <chrono>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -48,6 +50,10 @@ public:
 
   [[nodiscard]] const Tree& getTree() const { return this->tree; }
 
+protected:
+  void enterNode(const AbstractNode& node) override;
+  void leaveNode(const AbstractNode& node) override;
+
 private:
   class ResultObject
   {
@@ -104,6 +110,7 @@ private:
 
   void smartCacheInsert(const AbstractNode& node, const std::shared_ptr<const Geometry>& geom);
   std::shared_ptr<const Geometry> smartCacheGet(const AbstractNode& node, bool preferNef);
+  std::shared_ptr<Geometry> mutableBackendGeometry(ResultObject& res);
   bool isSmartCached(const AbstractNode& node);
   bool isValidDim(const Geometry::GeometryItem& item, unsigned int& dim) const;
   std::vector<std::shared_ptr<const Polygon2d>> collectChildren2D(const AbstractNode& node);
@@ -125,6 +132,12 @@ private:
   Response lazyEvaluateRootNode(State& state, const AbstractNode& node);
 
   std::map<int, Geometry::Geometries> visitedchildren;
+  // Open --profile events of the nodes currently being traversed
+  std::vector<ProfileEvent> profileStack;
+  // Start times of the nodes currently being traversed, and the resulting evaluation time
+  // in microseconds per node index, passed to the caches as recompute cost
+  std::vector<std::chrono::steady_clock::time_point> nodeStartTimes;
+  std::map<int, double> evaluationTimes;
   const Tree& tree;
   std::shared_ptr<const Geometry> root;
 
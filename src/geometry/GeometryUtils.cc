@@ -29,18 +29,73 @@
 #include "geometry/manifold/ManifoldGeometry.h"
 #endif
 
-static void *stdAlloc(void *userData, unsigned int size)
+namespace {
+
+/*!
+   Bump allocator backing libtess2.
+
+   libtess2 makes many small allocations for every polygon. Each thread keeps
+   one arena which hands out memory from a few reused blocks, and everything
+   is released at once when a tessellation is done, so tessellating many
+   faces (possibly on several threads) doesn't hammer the global heap.
+ */
+class TessArena
 {
-  TESS_NOTUSED(userData);
-  return malloc(size);
+public:
+  void *allocate(size_t size)
+  {
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    while (current < blocks.size() && offset + size > blocks[current].size) {
+      ++current;
+      offset = 0;
+    }
+    if (current == blocks.size()) {
+      const auto blocksize = std::max(BLOCK_SIZE, size);
+      blocks.push_back({std::make_unique<char[]>(blocksize), blocksize});
+      offset = 0;
+    }
+    void *ptr = blocks[current].data.get() + offset;
+    offset += size;
+    return ptr;
+  }
+
+  void reset()
+  {
+    current = 0;
+    offset = 0;
+    // Don't hold on to the memory needed by an exceptionally large polygon
+    if (blocks.size() > MAX_RETAINED_BLOCKS) blocks.resize(MAX_RETAINED_BLOCKS);
+  }
+
+private:
+  static constexpr size_t ALIGNMENT = 16;
+  static constexpr size_t BLOCK_SIZE = 256 * 1024;
+  static constexpr size_t MAX_RETAINED_BLOCKS = 4;
+
+  struct Block {
+    std::unique_ptr<char[]> data;
+    size_t size;
+  };
+  std::vector<Block> blocks;
+  size_t current{0};
+  size_t offset{0};
+};
+
+thread_local TessArena tess_arena;
+
+void *arenaAlloc(void *userData, unsigned int size)
+{
+  return static_cast<TessArena *>(userData)->allocate(size);
 }
 
-static void stdFree(void *userData, void *ptr)
+void arenaFree(void *userData, void *ptr)
 {
   TESS_NOTUSED(userData);
-  free(ptr);
+  TESS_NOTUSED(ptr);
 }
 
+}  // namespace
+
 using IndexedEdge = std::pair<int, int>;
 
 /*!
@@ -294,10 +349,16 @@ bool GeometryUtils::tessellatePolygonWithHoles(const std::vector<Vector3f>& vert
   TESStesselator *tess = nullptr;
 
   memset(&ma, 0, sizeof(ma));
-  ma.memalloc = stdAlloc;
-  ma.memfree = stdFree;
+  ma.memalloc = arenaAlloc;
+  ma.memfree = arenaFree;
+  ma.userData = &tess_arena;
   ma.extraVertices = 256;  // realloc not provided, allow 256 extra vertices.
 
+  // All memory allocated by libtess2 is released at once when leaving this function
+  struct ArenaReset {
+    ~ArenaReset() { tess_arena.reset(); }
+  } arena_reset;
+
   if (!(tess = tessNewTess(&ma))) return true;
 
   std::vector<TESSreal> contour;
@@ -317,8 +378,10 @@ bool GeometryUtils::tessellatePolygonWithHoles(const std::vector<Vector3f>& vert
     tessAddContour(tess, 3, &contour.front(), sizeof(TESSreal) * 3, face.size());
   }
 
-  if (!tessTesselate(tess, TESS_WINDING_ODD, TESS_CONSTRAINED_DELAUNAY_TRIANGLES, 3, 3, normalvec))
+  if (!tessTesselate(tess, TESS_WINDING_ODD, TESS_CONSTRAINED_DELAUNAY_TRIANGLES, 3, 3, normalvec)) {
+    tessDeleteTess(tess);
     return false;
+  }
 
   const auto vindices = tessGetVertexIndices(tess);
   const auto elements = tessGetElements(tess);
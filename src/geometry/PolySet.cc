@@ -36,6 +36,7 @@
 #include <Eigen/LU>
 #include <cstddef>
 #include <string>
+#include <utility>
 #include <vector>
 
 /*! /class PolySet
@@ -95,7 +96,15 @@ void PolySet::transform(const Transform3d& mat)
   // If mirroring transform, flip faces to avoid the object to end up being inside-out
   bool mirrored = mat.matrix().determinant() < 0;
 
-  for (auto& v : this->vertices) v = mat * v;
+  if (this->vertices.isShared()) {
+    // Transform shared vertices into a new buffer, rather than copying them first
+    std::vector<Vector3d> transformed;
+    transformed.reserve(this->vertices.size());
+    for (const auto& v : this->vertices.get()) transformed.emplace_back(mat * v);
+    this->vertices = std::move(transformed);
+  } else {
+    for (auto& v : this->vertices) v = mat * v;
+  }
 
   if (mirrored)
     for (auto& p : this->indices) {
@@ -107,7 +116,8 @@ void PolySet::transform(const Transform3d& mat)
 void PolySet::setColor(const Color4f& c)
 {
   colors = {c};
-  color_indices.assign(indices.size(), 0);
+  // Replace rather than overwrite, so any shared color indices aren't copied first
+  color_indices = std::vector<int32_t>(indices.size(), 0);
 }
 
 bool PolySet::isConvex() const
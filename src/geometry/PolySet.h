@@ -5,6 +5,7 @@
 #include "geometry/GeometryUtils.h"
 #include "geometry/Polygon2d.h"
 #include "utils/boost-utils.h"
+#include "utils/CopyOnWriteVector.h"
 
 #include <cstdint>
 #include <memory>
@@ -20,11 +21,13 @@ class PolySet : public Geometry
 
 public:
   VISITABLE_GEOMETRY();
-  PolygonIndices indices;
-  std::vector<Vector3d> vertices;
+  // The buffers are shared between copies until modified, so e.g. transforming or coloring
+  // a cached PolySet doesn't copy the parts it leaves alone.
+  CopyOnWriteVector<IndexedFace> indices;
+  CopyOnWriteVector<Vector3d> vertices;
   // Per polygon color, indexing the colors vector below. Can be empty, and -1 means no specific color.
-  std::vector<int32_t> color_indices;
-  std::vector<Color4f> colors;
+  CopyOnWriteVector<int32_t> color_indices;
+  CopyOnWriteVector<Color4f> colors;
 
   PolySet(unsigned int dim, boost::tribool convex = unknown);
 
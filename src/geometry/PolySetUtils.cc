@@ -1,14 +1,21 @@
 #include "geometry/PolySetUtils.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
+#include <iterator>
+#include <map>
 #include <memory>
 #include <cstddef>
 #include <sstream>
+#include <utility>
 #include <vector>
 
 #include <boost/range/adaptor/reversed.hpp>
 
+#include "geometry/ClipperUtils.h"
 #include "geometry/Geometry.h"
 #include "geometry/linalg.h"
 #include "geometry/PolySet.h"
@@ -16,6 +23,7 @@
 #include "geometry/Polygon2d.h"
 #include "utils/printutils.h"
 #include "geometry/GeometryUtils.h"
+#include "utils/parallel.h"
 #ifdef ENABLE_CGAL
 #include "geometry/cgal/cgalutils.h"
 #endif
@@ -23,6 +31,185 @@
 #include "geometry/manifold/ManifoldGeometry.h"
 #endif
 
+namespace {
+
+// Faces are triangulated in chunks of this many faces, one chunk per task
+constexpr size_t TESSELLATION_CHUNK_SIZE = 256;
+
+// Minimum sine of the turning angle at each corner of a quad taking the fast path
+constexpr double CONVEX_QUAD_MIN_TURN = 1e-4;
+// Maximum deviation of the fourth quad corner from the plane of the other three, relative to its size
+constexpr double CONVEX_QUAD_MAX_NONPLANARITY = 1e-6;
+// libtess2 flips a diagonal whose opposite angles sum to at least this, see tesedgeIsLocallyDelaunay()
+constexpr double LIBTESS_DELAUNAY_FLIP_ANGLE = M_PI + 0.01;
+// Closer to the flip angle than this (in radians), libtess2's float arithmetic could go either way
+constexpr double CONVEX_QUAD_FLIP_MARGIN = 1e-4;
+// Normal components closer than this (relative) could make libtess2 project along either axis
+constexpr double CONVEX_QUAD_AXIS_MARGIN = 1e-3;
+
+/*!
+   Finds how libtess2 triangulates a convex quad when projecting it along the given axis.
+
+   libtess2 orients the projected quad counter-clockwise and sweeps it starting from its
+   lexicographically smallest corner. A convex quad is a single monotone region, which it
+   splits along the diagonal not touching that corner. The Delaunay refinement then flips
+   that diagonal if the angles opposite to it, at the first corner and the one across
+   from it, sum to LIBTESS_DELAUNAY_FLIP_ANGLE or more.
+
+   Returns false if the flip is too close to call.
+ */
+bool libtess_quad_split(const std::array<Vector3d, 4>& p, int axis, size_t& first, bool& flip)
+{
+  std::array<Vector2d, 4> q;
+  double area = 0;
+  for (size_t i = 0; i < 4; ++i) q[i] = {p[i][(axis + 1) % 3], p[i][(axis + 2) % 3]};
+  for (size_t i = 0; i < 4; ++i) area += q[i][0] * q[(i + 1) % 4][1] - q[(i + 1) % 4][0] * q[i][1];
+  if (area < 0) {
+    for (auto& v : q) v[1] = -v[1];
+  }
+
+  first = 0;
+  for (size_t i = 1; i < 4; ++i) {
+    if (q[i][0] < q[first][0] || (q[i][0] == q[first][0] && q[i][1] <= q[first][1])) first = i;
+  }
+  const auto angle = [&q](size_t i) {
+    const Vector2d a = q[(i + 3) % 4] - q[i];
+    const Vector2d b = q[(i + 1) % 4] - q[i];
+    return std::atan2(std::abs(a[0] * b[1] - a[1] * b[0]), a.dot(b));
+  };
+  const double opposite_angles = angle(first) + angle((first + 2) % 4);
+  if (std::abs(opposite_angles - LIBTESS_DELAUNAY_FLIP_ANGLE) < CONVEX_QUAD_FLIP_MARGIN) return false;
+  flip = opposite_angles >= LIBTESS_DELAUNAY_FLIP_ANGLE;
+  return true;
+}
+
+/*!
+   Triangulates a strictly convex, planar quad exactly like
+   GeometryUtils::tessellatePolygonWithHoles() does: the same two triangles, in the same
+   order and starting at the same corners. See libtess_quad_split().
+
+   Returns false for concave, collinear and non-planar quads, and for the rare quads where
+   libtess2's float arithmetic could pick another projection or diagonal than we do here.
+   Those are left to libtess2, so the result doesn't depend on which path was taken.
+ */
+bool tessellate_convex_quad(const std::vector<Vector3f>& verts, const IndexedFace& face,
+                            std::vector<IndexedFace>& triangles)
+{
+  std::array<Vector3d, 4> p;
+  for (size_t i = 0; i < 4; ++i) p[i] = verts[face[i]].cast<double>();
+
+  const Vector3d normal = (p[2] - p[0]).cross(p[3] - p[1]);
+  const double normal_length = normal.norm();
+  if (!(normal_length > 0)) return false;
+
+  double size = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    const Vector3d e1 = p[(i + 1) % 4] - p[i];
+    const Vector3d e2 = p[(i + 2) % 4] - p[(i + 1) % 4];
+    const double turn = e1.cross(e2).dot(normal) / normal_length;
+    if (!(turn > CONVEX_QUAD_MIN_TURN * e1.norm() * e2.norm())) return false;
+    size = std::max(size, e1.norm());
+  }
+  const Vector3d plane = (p[1] - p[0]).cross(p[2] - p[0]).normalized();
+  if (std::abs((p[3] - p[0]).dot(plane)) > CONVEX_QUAD_MAX_NONPLANARITY * size) return false;
+
+  // libtess2 projects along the largest component of the normal, preferring the lower axis on ties
+  const Vector3d magnitude = normal.cwiseAbs();
+  int axis = 0;
+  if (magnitude[1] > magnitude[axis]) axis = 1;
+  if (magnitude[2] > magnitude[axis]) axis = 2;
+  size_t first;
+  bool flip;
+  if (!libtess_quad_split(p, axis, first, flip)) return false;
+  // libtess2 computes the normal in float from three of the corners, so on near ties it could
+  // project along another axis. That only matters if it splits the quad differently there.
+  for (int other = 0; other < 3; ++other) {
+    if (other == axis || magnitude[other] < magnitude[axis] * (1 - CONVEX_QUAD_AXIS_MARGIN)) continue;
+    size_t other_first;
+    bool other_flip;
+    if (!libtess_quad_split(p, other, other_first, other_flip)) return false;
+    if (other_first != first || other_flip != flip) return false;
+  }
+
+  const auto corner = [&](size_t i) { return face[(first + i) % 4]; };
+  if (flip) {
+    triangles.push_back({corner(0), corner(2), corner(3)});
+    triangles.push_back({corner(2), corner(0), corner(1)});
+  } else {
+    triangles.push_back({corner(3), corner(1), corner(2)});
+    triangles.push_back({corner(1), corner(3), corner(0)});
+  }
+  return true;
+}
+
+struct TessellatedChunk {
+  std::vector<IndexedFace> triangles;
+  std::vector<int32_t> color_indices;
+};
+
+/*!
+   Returns the loops along which the triangle mesh ps crosses the z=0 plane.
+   For a closed, outward-oriented mesh, outlines are counter-clockwise and holes clockwise.
+   Vertices exactly on the plane count as lying above it, or below it if onPlaneIsBelow is set.
+
+   Crossings are identified by the mesh edge they lie on rather than by their coordinates,
+   so loops are chained exactly.
+ */
+std::vector<Outline2d> slice_loops(const PolySet& ps, bool onPlaneIsBelow)
+{
+  using Edge = std::pair<int, int>;
+  const auto below = [&](int idx) {
+    const double z = ps.vertices[idx][2];
+    return onPlaneIsBelow ? z <= 0 : z < 0;
+  };
+  // Computed from the canonical edge, so both triangles sharing an edge agree on the point
+  const auto crossing = [&](const Edge& edge) -> Vector2d {
+    const auto& p = ps.vertices[edge.first];
+    const auto& q = ps.vertices[edge.second];
+    if (p[2] == 0) return {p[0], p[1]};
+    if (q[2] == 0) return {q[0], q[1]};
+    const double t = p[2] / (p[2] - q[2]);
+    return {p[0] + t * (q[0] - p[0]), p[1] + t * (q[1] - p[1])};
+  };
+
+  // Each crossing triangle contributes one segment, from the edge where its boundary descends
+  // through the plane to the edge where it ascends again. This keeps material on the left.
+  std::map<Edge, Edge> segments;
+  for (const auto& face : ps.indices) {
+    Edge start{-1, -1}, end{-1, -1};
+    for (size_t i = 0; i < face.size(); ++i) {
+      const int a = face[i];
+      const int b = face[(i + 1) % face.size()];
+      const Edge edge = a < b ? Edge(a, b) : Edge(b, a);
+      if (!below(a) && below(b)) start = edge;
+      else if (below(a) && !below(b)) end = edge;
+    }
+    if (start.first >= 0 && end.first >= 0) segments.emplace(start, end);
+  }
+
+  std::vector<Outline2d> loops;
+  while (!segments.empty()) {
+    const Edge first = segments.begin()->first;
+    Edge current = first;
+    Outline2d outline;
+    bool closed = false;
+    for (auto next = segments.find(current); next != segments.end(); next = segments.find(current)) {
+      outline.vertices.push_back(crossing(current));
+      current = next->second;
+      segments.erase(next);
+      if (current == first) {
+        closed = true;
+        break;
+      }
+    }
+    // Open chains only occur for non-manifold meshes and are dropped
+    if (closed && outline.vertices.size() >= 3) loops.push_back(std::move(outline));
+  }
+  return loops;
+}
+
+}  // namespace
+
 namespace PolySetUtils {
 
 // Project all polygons (also back-facing) into a Polygon2d instance.
@@ -44,6 +231,33 @@ std::unique_ptr<Polygon2d> project(const PolySet& ps)
   return poly;
 }
 
+/*!
+   Intersects the mesh with the XY plane, like projection(cut=true).
+
+   Faces lying in the plane are part of the result: the mesh is cut just above and just
+   below the plane and both cuts are unioned. The second cut is only needed if some vertex
+   lies exactly in the plane.
+ */
+std::unique_ptr<Polygon2d> slice(const PolySet& ps)
+{
+  std::unique_ptr<PolySet> tessellated;
+  if (!ps.isTriangular()) tessellated = tessellate_faces(ps);
+  const PolySet& mesh = tessellated ? *tessellated : ps;
+
+  const bool touchesPlane =
+    std::any_of(mesh.vertices.begin(), mesh.vertices.end(), [](const Vector3d& v) { return v[2] == 0; });
+  std::vector<std::shared_ptr<const Polygon2d>> cuts;
+  for (const bool onPlaneIsBelow : {false, true}) {
+    if (onPlaneIsBelow && !touchesPlane) break;
+    auto cut = std::make_shared<Polygon2d>();
+    for (auto& outline : slice_loops(mesh, onPlaneIsBelow)) cut->addOutline(std::move(outline));
+    // The winding tells holes from outlines, so it must be kept
+    cut->setSanitized(true);
+    cuts.push_back(std::move(cut));
+  }
+  return ClipperUtils::apply(cuts, Clipper2Lib::ClipType::Union);
+}
+
 /* Tessellation of 3d PolySet faces
 
    This code is for tessellating the faces of a 3d PolySet, assuming that
@@ -134,28 +348,55 @@ std::unique_ptr<PolySet> tessellate_faces(const PolySet& polyset)
     }
   }
 
-  // we will reuse this memory instead of reallocating for each polygon
-  std::vector<IndexedTriangle> triangles;
-  std::vector<IndexedFace> facesBuffer(1);
-  for (size_t i = 0, n = polygons.size(); i < n; i++) {
-    const auto& face = polygons[i];
-    if (face.size() == 3) {
-      // trivial case - triangles cannot be concave or have holes
-      result->indices.push_back({face[0], face[1], face[2]});
-      if (has_colors) result->color_indices.push_back(polygon_color_indices[i]);
-    }
-    // Quads seem trivial, but can be concave, and can have degenerate cases.
-    // So everything more complex than triangles goes into the general case.
-    else {
-      triangles.clear();
-      facesBuffer[0] = face;
-      auto err = GeometryUtils::tessellatePolygonWithHoles(verts, facesBuffer, triangles, nullptr);
-      if (!err) {
-        for (const auto& t : triangles) {
-          result->indices.push_back({t[0], t[1], t[2]});
-          if (has_colors) result->color_indices.push_back(polygon_color_indices[i]);
+  // Faces are independent, so chunks of them are triangulated in parallel. The chunks are
+  // concatenated in their original order afterwards, so the result doesn't depend on scheduling.
+  const size_t num_chunks = (polygons.size() + TESSELLATION_CHUNK_SIZE - 1) / TESSELLATION_CHUNK_SIZE;
+  std::vector<size_t> chunk_starts(num_chunks);
+  for (size_t i = 0; i < num_chunks; ++i) chunk_starts[i] = i * TESSELLATION_CHUNK_SIZE;
+  std::vector<TessellatedChunk> chunks(num_chunks);
+  parallelizable_transform(chunk_starts.begin(), chunk_starts.end(), chunks.begin(), [&](size_t start) {
+    TessellatedChunk chunk;
+    const size_t end = std::min(start + TESSELLATION_CHUNK_SIZE, polygons.size());
+    chunk.triangles.reserve(2 * (end - start));
+    // we will reuse this memory instead of reallocating for each polygon
+    std::vector<IndexedTriangle> triangles;
+    std::vector<IndexedFace> facesBuffer(1);
+    for (size_t i = start; i < end; ++i) {
+      const auto& face = polygons[i];
+      const auto first = chunk.triangles.size();
+      if (face.size() == 3) {
+        // trivial case - triangles cannot be concave or have holes
+        chunk.triangles.push_back({face[0], face[1], face[2]});
+      } else if (face.size() == 4 && tessellate_convex_quad(verts, face, chunk.triangles)) {
+        // Quads seem trivial, but can be concave, and can have degenerate cases.
+        // Convex ones are split here the same way libtess2 would split them.
+      } else {
+        triangles.clear();
+        facesBuffer[0] = face;
+        auto err = GeometryUtils::tessellatePolygonWithHoles(verts, facesBuffer, triangles, nullptr);
+        if (!err) {
+          for (const auto& t : triangles) chunk.triangles.push_back({t[0], t[1], t[2]});
         }
       }
+      if (has_colors) {
+        chunk.color_indices.insert(chunk.color_indices.end(), chunk.triangles.size() - first,
+                                   polygon_color_indices[i]);
+      }
+    }
+    return chunk;
+  });
+
+  // Prefix sum of the chunk sizes gives each chunk's position in the result
+  std::vector<size_t> offsets(num_chunks + 1, 0);
+  for (size_t i = 0; i < num_chunks; ++i) offsets[i + 1] = offsets[i] + chunks[i].triangles.size();
+  result->indices.resize(offsets.back());
+  if (has_colors) result->color_indices.resize(offsets.back());
+  for (size_t i = 0; i < num_chunks; ++i) {
+    auto& chunk = chunks[i];
+    std::move(chunk.triangles.begin(), chunk.triangles.end(), result->indices.begin() + offsets[i]);
+    if (has_colors) {
+      std::copy(chunk.color_indices.begin(), chunk.color_indices.end(),
+                result->color_indices.begin() + offsets[i]);
     }
   }
   if (degeneratePolygons > 0) {
@@ -11,6 +11,7 @@ class PolySet;
 namespace PolySetUtils {
 
 std::unique_ptr<Polygon2d> project(const PolySet& ps);
+std::unique_ptr<Polygon2d> slice(const PolySet& ps);
 std::unique_ptr<PolySet> tessellate_faces(const PolySet& inps);
 bool is_approximately_convex(const PolySet& ps);
 
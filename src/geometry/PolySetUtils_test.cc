@@ -0,0 +1,124 @@
+#include <catch2/catch_all.hpp>
+#include "geometry/PolySetUtils.h"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include "geometry/GeometryUtils.h"
+#include "geometry/PolySet.h"
+
+namespace {
+
+using Quad = std::array<Vector2d, 4>;
+
+// Places each quad in the 3D frame given by rotation and offset, as a face of its own
+void addQuads(PolySet& ps, const std::vector<Quad>& quads, const Eigen::Matrix3d& rotation,
+              const Vector3d& offset, bool reversed)
+{
+  for (const auto& quad : quads) {
+    IndexedFace face;
+    for (size_t i = 0; i < 4; ++i) {
+      const auto& v = quad[reversed ? 3 - i : i];
+      face.push_back(ps.vertices.size());
+      ps.vertices.push_back(rotation * Vector3d(v[0], v[1], 0) + offset);
+    }
+    ps.indices.push_back(face);
+  }
+}
+
+// Rectangles, isosceles trapezoids and quads inscribed in a circle: all of them cocircular
+std::vector<Quad> cocircularQuads()
+{
+  std::vector<Quad> quads;
+  for (double w = 1; w <= 4; ++w) {
+    for (double h = 1; h <= 3; ++h) {
+      quads.push_back({{{0, 0}, {w, 0}, {w, h}, {0, h}}});
+      quads.push_back({{{0, 0}, {w + 2, 0}, {w + 1, h}, {1, h}}});
+      quads.push_back({{{1, 0}, {w + 1, 0}, {w + 2, h}, {0, h}}});
+    }
+  }
+  for (int i = 0; i < 16; ++i) {
+    const double a = 2 * M_PI * i / 16;
+    quads.push_back({{{std::cos(a), std::sin(a)},
+                      {std::cos(a + 1), std::sin(a + 1)},
+                      {std::cos(a + 2.5), std::sin(a + 2.5)},
+                      {std::cos(a + 4), std::sin(a + 4)}}});
+  }
+  return quads;
+}
+
+// Random convex and concave quads, with corners at random distances around a center
+std::vector<Quad> randomQuads(std::mt19937& rng)
+{
+  std::uniform_real_distribution<double> angle(0, M_PI / 2);
+  std::uniform_real_distribution<double> radius(1, 10);
+  std::vector<Quad> quads(200);
+  for (auto& quad : quads) {
+    for (size_t i = 0; i < 4; ++i) {
+      const double a = i * M_PI / 2 + angle(rng);
+      const double r = radius(rng);
+      quad[i] = {r * std::cos(a), r * std::sin(a)};
+    }
+  }
+  return quads;
+}
+
+}  // namespace
+
+TEST_CASE("tessellate_faces splits quads like libtess2", "[Geometry][PolySetUtils]")
+{
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> unit(-1, 1);
+  const auto cocircular = cocircularQuads();
+  const auto random = randomQuads(rng);
+
+  PolySet ps(3);
+  // All axis-aligned orientations, where ties between corners are common
+  for (int axis = 0; axis < 3; ++axis) {
+    for (const bool reversed : {false, true}) {
+      Eigen::Matrix3d rotation = Eigen::Matrix3d::Zero();
+      rotation(axis, 0) = 1;
+      rotation((axis + 1) % 3, 1) = reversed ? -1 : 1;
+      rotation((axis + 2) % 3, 2) = 1;
+      const Vector3d offset(10 * axis, -5, reversed ? 3 : 0);
+      addQuads(ps, cocircular, rotation, offset, reversed);
+      addQuads(ps, random, rotation, offset, reversed);
+    }
+  }
+  // Arbitrary orientations, including planes at 45 degrees to the axes
+  std::vector<Eigen::Matrix3d> rotations;
+  rotations.emplace_back(Eigen::AngleAxisd(M_PI / 4, Vector3d::UnitZ()));
+  rotations.emplace_back(Eigen::AngleAxisd(M_PI / 4, Vector3d(1, 1, 0).normalized()));
+  for (int i = 0; i < 8; ++i) {
+    const Vector3d axis(unit(rng), unit(rng), unit(rng));
+    rotations.emplace_back(Eigen::AngleAxisd(M_PI * unit(rng), axis.normalized()));
+  }
+  for (const auto& rotation : rotations) {
+    const Vector3d offset(10 * unit(rng), 10 * unit(rng), 10 * unit(rng));
+    addQuads(ps, cocircular, rotation, offset, false);
+    addQuads(ps, random, rotation, offset, true);
+  }
+
+  const auto tessellated = PolySetUtils::tessellate_faces(ps);
+  REQUIRE(tessellated->vertices.size() == ps.vertices.size());
+  REQUIRE(tessellated->indices.size() == 2 * ps.indices.size());
+
+  std::vector<Vector3f> verts;
+  for (const auto& v : ps.vertices) verts.emplace_back(v.cast<float>());
+  for (size_t i = 0; i < ps.indices.size(); ++i) {
+    std::vector<IndexedTriangle> expected;
+    GeometryUtils::tessellatePolygonWithHoles(verts, {ps.indices[i]}, expected, nullptr);
+    REQUIRE(expected.size() == 2);
+    for (size_t j = 0; j < 2; ++j) {
+      const auto& triangle = tessellated->indices[2 * i + j];
+      INFO("face " << i << ", triangle " << j);
+      CHECK(triangle == IndexedFace{expected[j][0], expected[j][1], expected[j][2]});
+    }
+  }
+}
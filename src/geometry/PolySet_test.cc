@@ -0,0 +1,83 @@
+#include <catch2/catch_all.hpp>
+#include "geometry/PolySet.h"
+
+#include <memory>
+
+namespace {
+
+// Single triangle, colored red
+std::unique_ptr<PolySet> triangle()
+{
+  auto ps = std::make_unique<PolySet>(3);
+  ps->vertices = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}};
+  ps->indices = {{0, 1, 2}};
+  ps->setColor(Color4f(1.0f, 0.0f, 0.0f));
+  return ps;
+}
+
+const PolySet& asPolySet(const std::unique_ptr<Geometry>& geom)
+{
+  return dynamic_cast<const PolySet&>(*geom);
+}
+
+}  // namespace
+
+TEST_CASE("PolySet copies share their buffers", "[Geometry][PolySet]")
+{
+  const auto ps = triangle();
+  const auto copy = ps->copy();
+  const auto& copied = asPolySet(copy);
+  CHECK(copied.vertices.sharesWith(ps->vertices));
+  CHECK(copied.indices.sharesWith(ps->indices));
+  CHECK(copied.colors.sharesWith(ps->colors));
+  CHECK(copied.color_indices.sharesWith(ps->color_indices));
+}
+
+TEST_CASE("Transforming a PolySet copy only replaces its vertices", "[Geometry][PolySet]")
+{
+  const auto ps = triangle();
+  auto copy = ps->copy();
+  copy->transform(Transform3d(Eigen::Translation3d(1, 2, 3)));
+  const auto& copied = asPolySet(copy);
+  CHECK_FALSE(copied.vertices.sharesWith(ps->vertices));
+  CHECK(copied.indices.sharesWith(ps->indices));
+  CHECK(copied.colors.sharesWith(ps->colors));
+  CHECK(copied.vertices[1] == Vector3d(2, 2, 3));
+  CHECK(ps->vertices[1] == Vector3d(1, 0, 0));
+}
+
+TEST_CASE("Mirroring a PolySet copy flips only the copy's faces", "[Geometry][PolySet]")
+{
+  const auto ps = triangle();
+  auto copy = ps->copy();
+  copy->transform(Transform3d(Eigen::Scaling(-1.0, 1.0, 1.0)));
+  const auto& copied = asPolySet(copy);
+  CHECK_FALSE(copied.indices.sharesWith(ps->indices));
+  CHECK(copied.indices[0] == IndexedFace{2, 1, 0});
+  CHECK(ps->indices[0] == IndexedFace{0, 1, 2});
+}
+
+TEST_CASE("Coloring a PolySet copy keeps its mesh shared", "[Geometry][PolySet]")
+{
+  const auto ps = triangle();
+  auto copy = ps->copy();
+  copy->setColor(Color4f(0.0f, 0.0f, 1.0f));
+  const auto& copied = asPolySet(copy);
+  CHECK(copied.vertices.sharesWith(ps->vertices));
+  CHECK(copied.indices.sharesWith(ps->indices));
+  CHECK(copied.colors[0] == Color4f(0.0f, 0.0f, 1.0f));
+  CHECK(ps->colors[0] == Color4f(1.0f, 0.0f, 0.0f));
+}
+
+TEST_CASE("Modifying a PolySet copy leaves the original alone", "[Geometry][PolySet]")
+{
+  const auto ps = triangle();
+  auto copy = ps->copy();
+  auto& copied = dynamic_cast<PolySet&>(*copy);
+  copied.vertices[0] = Vector3d(5, 5, 5);
+  copied.indices.push_back({0, 2, 1});
+  CHECK(ps->vertices[0] == Vector3d(0, 0, 0));
+  CHECK(ps->indices.size() == 1);
+  CHECK(copied.indices.size() == 2);
+  CHECK(copied.colors.sharesWith(ps->colors));
+}
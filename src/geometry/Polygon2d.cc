@@ -19,8 +19,22 @@
 
 Polygon2d::Polygon2d(Outline2d outline) : sanitized(true) { addOutline(std::move(outline)); }
 
+const Polygon2d::Outlines2d Polygon2d::noOutlines;
+
 std::unique_ptr<Geometry> Polygon2d::copy() const { return std::make_unique<Polygon2d>(*this); }
 
+// Like CGALNefGeometry::mutableP3(), this copies the outlines only if they're shared
+Polygon2d::Outlines2d& Polygon2d::mutableOutlines()
+{
+  if (!this->theoutlines) {
+    this->theoutlines = std::make_shared<Outlines2d>();
+  } else if (this->theoutlines.use_count() != 1) {
+    this->theoutlines = std::make_shared<Outlines2d>(*this->theoutlines);
+  }
+  // We're the only owner, and the outlines were created by us as a non-const object
+  return const_cast<Outlines2d&>(*this->theoutlines);
+}
+
 BoundingBox Outline2d::getBoundingBox() const
 {
   BoundingBox bbox;
@@ -67,7 +81,7 @@ BoundingBox Polygon2d::getBoundingBox() const
 std::string Polygon2d::dump() const
 {
   std::ostringstream out;
-  for (const auto& o : this->theoutlines) {
+  for (const auto& o : this->outlines()) {
     out << "contour:\n";
     for (const auto& v : o.vertices) {
       out << "  " << v.transpose();
@@ -77,16 +91,30 @@ std::string Polygon2d::dump() const
   return out.str();
 }
 
-bool Polygon2d::isEmpty() const { return this->theoutlines.empty(); }
+bool Polygon2d::isEmpty() const { return this->outlines().empty(); }
 
 void Polygon2d::transform(const Transform2d& mat)
 {
   if (mat.matrix().determinant() == 0) {
     LOG(message_group::Warning, "Scaling a 2D object with 0 - removing object");
-    this->theoutlines.clear();
+    this->theoutlines.reset();
+    return;
+  }
+  if (this->theoutlines && this->theoutlines.use_count() != 1) {
+    // Transform shared outlines into a new copy, rather than copying them first
+    auto transformed = std::make_shared<Outlines2d>();
+    transformed->reserve(this->theoutlines->size());
+    for (const auto& o : *this->theoutlines) {
+      Outline2d outline;
+      outline.positive = o.positive;
+      outline.vertices.reserve(o.vertices.size());
+      for (const auto& v : o.vertices) outline.vertices.emplace_back(mat * v);
+      transformed->push_back(std::move(outline));
+    }
+    this->theoutlines = std::move(transformed);
     return;
   }
-  for (auto& o : this->theoutlines) {
+  for (auto& o : mutableOutlines()) {
     for (auto& v : o.vertices) {
       v = mat * v;
     }
@@ -117,10 +145,10 @@ void Polygon2d::resize(const Vector2d& newsize, const Eigen::Matrix<bool, 2, 1>&
 
 bool Polygon2d::is_convex() const
 {
-  if (theoutlines.size() > 1) return false;
-  if (theoutlines.empty()) return true;
+  if (outlines().size() > 1) return false;
+  if (outlines().empty()) return true;
 
-  auto const& pts = theoutlines[0].vertices;
+  auto const& pts = outlines()[0].vertices;
   int N = pts.size();
 
   // Check for a right turn. This assumes the polygon is simple.
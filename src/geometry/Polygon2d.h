@@ -20,6 +20,10 @@ struct Outline2d {
   [[nodiscard]] BoundingBox getBoundingBox() const;
 };
 
+/*!
+   The outlines are shared between copies and only duplicated when a copy is modified,
+   so copying e.g. a cached polygon to transform it doesn't copy the outlines twice.
+ */
 class Polygon2d : public Geometry
 {
 public:
@@ -34,15 +38,15 @@ public:
   [[nodiscard]] std::unique_ptr<Geometry> copy() const override;
   [[nodiscard]] size_t numFacets() const override
   {
-    return std::accumulate(theoutlines.begin(), theoutlines.end(), 0,
+    return std::accumulate(outlines().begin(), outlines().end(), 0,
                            [](size_t a, const Outline2d& b) { return a + b.vertices.size(); });
   }
-  void addOutline(Outline2d outline) { this->theoutlines.push_back(std::move(outline)); }
+  void addOutline(Outline2d outline) { mutableOutlines().push_back(std::move(outline)); }
   [[nodiscard]] std::unique_ptr<PolySet> tessellate() const;
   [[nodiscard]] double area() const;
 
   using Outlines2d = std::vector<Outline2d>;
-  [[nodiscard]] const Outlines2d& outlines() const { return theoutlines; }
+  [[nodiscard]] const Outlines2d& outlines() const { return theoutlines ? *theoutlines : noOutlines; }
   // Note: The "using" here is a kludge to avoid a compiler warning.
   // It would be better to fix the class relationships, so that Polygon2d does
   // not inherit an unused 3d transform function.
@@ -61,6 +65,9 @@ public:
   [[nodiscard]] bool is_convex() const;
 
 private:
-  Outlines2d theoutlines;
+  Outlines2d& mutableOutlines();
+
+  static const Outlines2d noOutlines;
+  std::shared_ptr<const Outlines2d> theoutlines;
   bool sanitized{false};
 };
@@ -1,9 +1,13 @@
 #include "geometry/cgal/CGALCache.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <memory>
 #include <cstddef>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "geometry/Geometry.h"
 #include "utils/printutils.h"
@@ -14,13 +18,19 @@
 #include "geometry/manifold/ManifoldGeometry.h"
 #endif
 
-CGALCache *CGALCache::inst = nullptr;
+CGALCache::CGALCache(size_t limit) : cache("cgal_cache", limit) {}
 
-CGALCache::CGALCache(size_t limit) : cache(limit) {}
+CGALCache *CGALCache::instance()
+{
+  // Intentionally leaked, geometries may depend on other static state during shutdown
+  static auto *inst = new CGALCache;
+  return inst;
+}
 
 std::shared_ptr<const Geometry> CGALCache::get(const std::string& id) const
 {
-  const auto& N = this->cache[id]->N;
+  const auto entry = this->cache.get(id);
+  const auto N = entry ? entry->N : nullptr;
 #ifdef DEBUG
   LOG("CGAL Cache hit: %1$s (%2$d bytes)", id.substr(0, 40), N ? N->memsize() : 0);
 #endif
@@ -39,10 +49,11 @@ bool CGALCache::acceptsGeometry(const std::shared_ptr<const Geometry>& geom)
     ;
 }
 
-bool CGALCache::insert(const std::string& id, const std::shared_ptr<const Geometry>& N)
+bool CGALCache::insert(const std::string& id, const std::shared_ptr<const Geometry>& N,
+                       double recompute_us)
 {
   assert(acceptsGeometry(N));
-  auto inserted = this->cache.insert(id, new cache_entry(N), N ? N->memsize() : 0);
+  auto inserted = this->cache.insert(id, cache_entry(N), N ? N->memsize() : 0, recompute_us);
 #ifdef DEBUG
   if (inserted) LOG("CGAL Cache insert: %1$s (%2$d bytes)", id.substr(0, 40), (N ? N->memsize() : 0));
   else LOG("CGAL Cache insert failed: %1$s (%2$d bytes)", id.substr(0, 40), (N ? N->memsize() : 0));
@@ -50,6 +61,68 @@ bool CGALCache::insert(const std::string& id, const std::shared_ptr<const Geomet
   return inserted;
 }
 
+std::string CGALCache::convertedKey(const std::shared_ptr<const Geometry>& source)
+{
+  // Can't collide with the hex fingerprints used as node keys
+  return "converted:" + std::to_string(reinterpret_cast<uintptr_t>(source.get()));
+}
+
+std::shared_ptr<const Geometry> CGALCache::getConverted(const std::shared_ptr<const Geometry>& source)
+{
+  if (!source) return nullptr;
+  const auto key = convertedKey(source);
+  const auto entry = this->cache.get(key);
+  if (!entry) return nullptr;
+  // The address may have been reused after the original source was destroyed
+  if (entry->source.lock() != source) {
+    this->cache.remove(key);
+    return nullptr;
+  }
+  ++this->reusedConversionCount;
+  return entry->N;
+}
+
+bool CGALCache::insertConverted(const std::shared_ptr<const Geometry>& source,
+                                const std::shared_ptr<const Geometry>& N, double recompute_us)
+{
+  assert(acceptsGeometry(N));
+  if (!source) return false;
+  ++this->conversionCount;
+  removeDestroyedConversions();
+  const auto key = convertedKey(source);
+  {
+    const std::lock_guard<std::mutex> lock(this->convertedMutex);
+    this->convertedSources[key] = source;
+  }
+  cache_entry entry(N);
+  entry.source = source;
+  return this->cache.insert(key, std::move(entry), N ? N->memsize() : 0, recompute_us);
+}
+
+/*
+   Removes the conversions of destroyed sources. It's called on every insert, but only checks
+   once the number of sources has doubled since the last check, which keeps the cost per insert
+   constant on average.
+ */
+void CGALCache::removeDestroyedConversions()
+{
+  std::vector<std::string> destroyed;
+  {
+    const std::lock_guard<std::mutex> lock(this->convertedMutex);
+    if (this->convertedSources.size() < std::max<size_t>(64, 2 * this->convertedSourcesChecked)) return;
+    for (auto it = this->convertedSources.begin(); it != this->convertedSources.end();) {
+      if (it->second.expired()) {
+        destroyed.push_back(it->first);
+        it = this->convertedSources.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    this->convertedSourcesChecked = this->convertedSources.size();
+  }
+  for (const auto& key : destroyed) this->cache.remove(key);
+}
+
 size_t CGALCache::size() const { return cache.size(); }
 
 size_t CGALCache::totalCost() const { return cache.totalCost(); }
@@ -58,12 +131,23 @@ size_t CGALCache::maxSizeMB() const { return this->cache.maxCost() / (1024ul * 1
 
 void CGALCache::setMaxSizeMB(size_t limit) { this->cache.setMaxCost(limit * 1024ul * 1024ul); }
 
-void CGALCache::clear() { cache.clear(); }
+void CGALCache::clear()
+{
+  cache.clear();
+  {
+    const std::lock_guard<std::mutex> lock(this->convertedMutex);
+    this->convertedSources.clear();
+    this->convertedSourcesChecked = 0;
+  }
+  this->conversionCount = 0;
+  this->reusedConversionCount = 0;
+}
 
 void CGALCache::print()
 {
   LOG("CGAL Polyhedrons in cache: %1$d", this->cache.size());
   LOG("CGAL cache size in bytes: %1$d", this->cache.totalCost());
+  LOG("CGAL conversions performed: %1$d, avoided by reuse: %2$d", conversions(), reusedConversions());
 }
 
 CGALCache::cache_entry::cache_entry(const std::shared_ptr<const Geometry>& N) : N(N)
@@ -1,26 +1,39 @@
 #pragma once
 
-#include "Cache.h"
+#include "ShardedCache.h"
+#include <atomic>
 #include <cstddef>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include "geometry/Geometry.h"
 
 class CGALCache
 {
 public:
-  CGALCache(size_t limit = 100ul * 1024ul * 1024ul);
+  // By default, only the global CacheManager budget limits the cache size
+  CGALCache(size_t limit = std::numeric_limits<size_t>::max());
 
-  static CGALCache *instance()
-  {
-    if (!inst) inst = new CGALCache;
-    return inst;
-  }
+  static CGALCache *instance();
   static bool acceptsGeometry(const std::shared_ptr<const Geometry>& geom);
 
   bool contains(const std::string& id) const { return this->cache.contains(id); }
   std::shared_ptr<const Geometry> get(const std::string& id) const;
-  bool insert(const std::string& id, const std::shared_ptr<const Geometry>& N);
+  // recompute_us is the time it took to create N, used to decide what to evict first
+  bool insert(const std::string& id, const std::shared_ptr<const Geometry>& N, double recompute_us = 0);
+  // Geometry converted from another geometry object, e.g. a Nef polyhedron created from a PolySet,
+  // or the Manifold the Manifold backend uses for a cached Nef polyhedron.
+  // Entries are keyed by the identity of the source and only returned while it is still alive.
+  // Entries of destroyed sources are removed as they're found, so they don't take up the budget.
+  std::shared_ptr<const Geometry> getConverted(const std::shared_ptr<const Geometry>& source);
+  bool insertConverted(const std::shared_ptr<const Geometry>& source,
+                       const std::shared_ptr<const Geometry>& N, double recompute_us = 0);
+  // Conversions performed, inserted with insertConverted(), and conversions avoided because
+  // getConverted() returned an earlier one
+  size_t conversions() const { return this->conversionCount; }
+  size_t reusedConversions() const { return this->reusedConversionCount; }
   size_t size() const;
   size_t totalCost() const;
   size_t maxSizeMB() const;
@@ -29,13 +42,21 @@ public:
   void print();
 
 private:
-  static CGALCache *inst;
-
   struct cache_entry {
     std::shared_ptr<const Geometry> N;
     std::string msg;
+    std::weak_ptr<const Geometry> source;
     cache_entry(const std::shared_ptr<const Geometry>& N);
   };
 
-  Cache<std::string, cache_entry> cache;
+  static std::string convertedKey(const std::shared_ptr<const Geometry>& source);
+  void removeDestroyedConversions();
+
+  ShardedCache<cache_entry> cache;
+  // Sources of the conversions inserted since they were last checked for destroyed ones
+  std::mutex convertedMutex;
+  std::unordered_map<std::string, std::weak_ptr<const Geometry>> convertedSources;
+  size_t convertedSourcesChecked = 0;
+  std::atomic<size_t> conversionCount{0};
+  std::atomic<size_t> reusedConversionCount{0};
 };
@@ -13,12 +13,20 @@
 
 // Copy constructor only performs shallow copies, so all modifying functions
 // must reset p3 with a new CGAL_Nef_polyhedron3 object, to prevent cache corruption.
-// This is also partly enforced by p3 pointing to a const object.
+// This is also partly enforced by p3 pointing to a const object. Functions which
+// modify the polyhedron in place use mutableP3(), which copies only if p3 is shared.
 CGALNefGeometry::CGALNefGeometry(const CGALNefGeometry& src) : Geometry(src)
 {
   if (src.p3) this->p3 = src.p3;
 }
 
+CGAL_Nef_polyhedron3& CGALNefGeometry::mutableP3()
+{
+  if (this->p3.use_count() != 1) this->p3 = std::make_shared<CGAL_Nef_polyhedron3>(*this->p3);
+  // We're the only owner, and p3 was created by us or the copy above as a non-const object
+  return const_cast<CGAL_Nef_polyhedron3&>(*this->p3);
+}
+
 std::unique_ptr<Geometry> CGALNefGeometry::copy() const
 {
   return std::make_unique<CGALNefGeometry>(*this);
@@ -104,9 +112,7 @@ void CGALNefGeometry::transform(const Transform3d& matrix)
       LOG(message_group::Warning, "Scaling a 3D object with 0 - removing object");
       this->reset();
     } else {
-      auto N = std::make_shared<CGAL_Nef_polyhedron3>(*this->p3);
-      CGALUtils::transform(*N, matrix);
-      this->p3 = N;
+      CGALUtils::transform(mutableP3(), matrix);
     }
   }
 }
@@ -40,4 +40,7 @@ public:
   void resize(const Vector3d& newsize, const Eigen::Matrix<bool, 3, 1>& autosize) override;
 
   std::shared_ptr<const CGAL_Nef_polyhedron3> p3;
+
+private:
+  CGAL_Nef_polyhedron3& mutableP3();
 };
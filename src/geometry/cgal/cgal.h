@@ -63,4 +63,7 @@ using CGAL_Kernel3Mesh = CGAL::Surface_mesh<CGAL_Point_3>;
 using CGAL_DoubleKernel = CGAL::Simple_cartesian<double>;
 using CGAL_DoubleMesh = CGAL::Surface_mesh<CGAL::Point_3<CGAL_DoubleKernel>>;
 
+// Exact predicates, lazily evaluated exact constructions; used for corefinement
+using CGAL_EpeckMesh = CGAL::Surface_mesh<CGAL::Point_3<CGAL::Epeck>>;
+
 #endif /* ENABLE_CGAL */
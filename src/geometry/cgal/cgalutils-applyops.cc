@@ -104,7 +104,7 @@ std::shared_ptr<const Geometry> applyOperator3D(const Geometry::Geometries& chil
       // Initialize N with first expected geometric object
       if (!foundFirst) {
         if (chN) {
-          // FIXME: Do we need to make a copy here?
+          // Shallow copy, the operators below replace N->p3 rather than modifying it
           N = std::make_shared<CGALNefGeometry>(*chN);
         } else {  // first child geometry might be empty/null
           N = nullptr;
@@ -0,0 +1,184 @@
+#include "geometry/cgal/cgalutils.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <CGAL/boost/graph/helpers.h>
+#include <CGAL/Polygon_mesh_processing/corefinement.h>
+#include <CGAL/Polygon_mesh_processing/orientation.h>
+#include <CGAL/Polygon_mesh_processing/self_intersections.h>
+
+#include "geometry/cgal/cgal.h"
+#include "geometry/Geometry.h"
+#include "geometry/PolySet.h"
+#include "geometry/PolySetUtils.h"
+#include "core/enums.h"
+#include "core/progress.h"
+#include "core/node.h"
+#include "utils/printutils.h"
+
+namespace CGALUtils {
+
+namespace PMP = CGAL::Polygon_mesh_processing;
+
+namespace {
+
+/*!
+   Converts a geometry to a mesh which corefinement can operate on: closed,
+   triangulated, free of self-intersections and bounding a volume.
+   Returns nullptr for anything else, e.g. non-manifold input.
+ */
+std::unique_ptr<CGAL_EpeckMesh> createCorefinableMesh(const std::shared_ptr<const Geometry>& geom)
+{
+  auto ps = PolySetUtils::getGeometryAsPolySet(geom);
+  if (!ps) return nullptr;
+  if (!ps->isTriangular()) ps = PolySetUtils::tessellate_faces(*ps);
+
+  auto mesh = std::make_unique<CGAL_EpeckMesh>();
+  mesh->reserve(ps->vertices.size(), ps->indices.size() * 3, ps->indices.size());
+  for (const auto& v : ps->vertices) {
+    mesh->add_vertex(CGAL_EpeckMesh::Point(v[0], v[1], v[2]));
+  }
+  for (const auto& face : ps->indices) {
+    if (face.size() != 3) return nullptr;
+    const auto f = mesh->add_face(CGAL_EpeckMesh::Vertex_index(face[0]),
+                                  CGAL_EpeckMesh::Vertex_index(face[1]),
+                                  CGAL_EpeckMesh::Vertex_index(face[2]));
+    if (f == CGAL_EpeckMesh::null_face()) return nullptr;
+  }
+  if (!CGAL::is_closed(*mesh) || PMP::does_self_intersect(*mesh) || !PMP::does_bound_a_volume(*mesh)) {
+    return nullptr;
+  }
+  return mesh;
+}
+
+// Corefines a and b, storing the result of op in a. Returns false if the result wouldn't be manifold.
+bool corefineAndCompute(CGAL_EpeckMesh& a, CGAL_EpeckMesh& b, OpenSCADOperator op)
+{
+  switch (op) {
+  case OpenSCADOperator::UNION:        return PMP::corefine_and_compute_union(a, b, a);
+  case OpenSCADOperator::INTERSECTION: return PMP::corefine_and_compute_intersection(a, b, a);
+  case OpenSCADOperator::DIFFERENCE:   return PMP::corefine_and_compute_difference(a, b, a);
+  default:                             return false;
+  }
+}
+
+std::unique_ptr<PolySet> createPolySetFromMesh(const CGAL_EpeckMesh& mesh)
+{
+  if (mesh.is_empty()) return PolySet::createEmpty();
+  return createPolySetFromSurfaceMesh(mesh);
+}
+
+// Unions meshes pairwise, smallest first, like applyUnion3D()
+std::unique_ptr<CGAL_EpeckMesh> unionMeshes(std::vector<std::unique_ptr<CGAL_EpeckMesh>> meshes)
+{
+  struct QueueItem {
+    std::unique_ptr<CGAL_EpeckMesh> mesh;
+    size_t order;
+  };
+  struct QueueItemGreater {
+    bool operator()(const QueueItem& lhs, const QueueItem& rhs) const
+    {
+      const auto l = lhs.mesh->number_of_faces();
+      const auto r = rhs.mesh->number_of_faces();
+      return (l > r) || (l == r && lhs.order > rhs.order);
+    }
+  };
+  // std::priority_queue can't move out of top(), so keep the heap in a vector
+  std::vector<QueueItem> heap;
+  size_t order = 0;
+  for (auto& mesh : meshes) heap.push_back({std::move(mesh), order++});
+  std::make_heap(heap.begin(), heap.end(), QueueItemGreater());
+
+  progress_tick();
+  while (heap.size() > 1) {
+    std::pop_heap(heap.begin(), heap.end(), QueueItemGreater());
+    auto first = std::move(heap.back());
+    heap.pop_back();
+    std::pop_heap(heap.begin(), heap.end(), QueueItemGreater());
+    auto second = std::move(heap.back());
+    heap.pop_back();
+    if (!corefineAndCompute(*first.mesh, *second.mesh, OpenSCADOperator::UNION)) return nullptr;
+    heap.push_back({std::move(first.mesh), order++});
+    std::push_heap(heap.begin(), heap.end(), QueueItemGreater());
+    progress_tick();
+  }
+  return heap.empty() ? nullptr : std::move(heap.front().mesh);
+}
+
+}  // namespace
+
+/*!
+   Applies union, intersection or difference using corefinement on Surface_mesh with an
+   exact predicates, lazily constructed kernel. This avoids the cost of Nef polyhedra,
+   but only works on manifold input, so anything else (including operators corefinement
+   doesn't provide) falls back to the Nef polyhedron implementation.
+
+   The child list should be guaranteed to contain non-NULL 3D or empty Geometry objects.
+ */
+std::shared_ptr<const Geometry> applyOperator3DCorefine(const Geometry::Geometries& children,
+                                                        OpenSCADOperator op)
+{
+  auto fallback = [&]() -> std::shared_ptr<const Geometry> {
+    if (op == OpenSCADOperator::UNION) {
+      Geometry::Geometries actualchildren = children;
+      return applyUnion3D(actualchildren.begin(), actualchildren.end());
+    }
+    return applyOperator3D(children, op);
+  };
+  if (op != OpenSCADOperator::UNION && op != OpenSCADOperator::INTERSECTION &&
+      op != OpenSCADOperator::DIFFERENCE) {
+    return fallback();
+  }
+
+  try {
+    if (op == OpenSCADOperator::UNION) {
+      std::vector<std::unique_ptr<CGAL_EpeckMesh>> meshes;
+      for (const auto& item : children) {
+        if (!item.second || item.second->isEmpty()) continue;
+        auto mesh = createCorefinableMesh(item.second);
+        if (!mesh) return fallback();
+        meshes.push_back(std::move(mesh));
+      }
+      if (meshes.empty()) return nullptr;
+      auto result = unionMeshes(std::move(meshes));
+      if (!result) return fallback();
+      return createPolySetFromMesh(*result);
+    }
+
+    // Same semantics as applyOperator3D(): the first child is the operand, empty children
+    // are ignored by difference and make intersections empty.
+    std::unique_ptr<CGAL_EpeckMesh> result;
+    bool foundFirst = false;
+    for (const auto& item : children) {
+      const bool empty = !item.second || item.second->isEmpty();
+      if (!foundFirst) {
+        foundFirst = true;
+        if (empty) return nullptr;
+        result = createCorefinableMesh(item.second);
+        if (!result) return fallback();
+        continue;
+      }
+      if (empty) {
+        if (op == OpenSCADOperator::INTERSECTION) return nullptr;
+        continue;
+      }
+      auto mesh = createCorefinableMesh(item.second);
+      if (!mesh || !corefineAndCompute(*result, *mesh, op)) return fallback();
+      if (item.first) item.first->progress_report();
+      // empty op <something> => empty
+      if (result->is_empty()) return createPolySetFromMesh(*result);
+    }
+    if (!result) return nullptr;
+    return createPolySetFromMesh(*result);
+  } catch (const CGAL::Failure_exception& e) {
+    LOG(message_group::Warning, "CGAL corefinement failed, falling back to Nef polyhedra: %1$s",
+        e.what());
+  }
+  return fallback();
+}
+
+}  // namespace CGALUtils
@@ -88,6 +88,9 @@ std::unique_ptr<PolySet> createPolySetFromSurfaceMesh(const SurfaceMesh& mesh)
   return builder.build();
 }
 
+template std::unique_ptr<PolySet> createPolySetFromSurfaceMesh(const CGAL_DoubleMesh& mesh);
+template std::unique_ptr<PolySet> createPolySetFromSurfaceMesh(const CGAL_EpeckMesh& mesh);
+
 template <class InputKernel, class OutputKernel>
 void copyMesh(const CGAL::Surface_mesh<CGAL::Point_3<InputKernel>>& input,
               CGAL::Surface_mesh<CGAL::Point_3<OutputKernel>>& output)
@@ -9,10 +9,12 @@
 #include "utils/printutils.h"
 #include "geometry/Polygon2d.h"
 #include "geometry/PolySetUtils.h"
+#include "geometry/cgal/CGALCache.h"
 #include "core/node.h"
 #include "utils/degree_trig.h"
 
 #include <cassert>
+#include <chrono>
 #include <set>
 #include <utility>
 #include <memory>
@@ -259,7 +261,9 @@ bool is_approximately_convex(const PolySet& ps)
   return explored_facets.size() == ps.indices.size();
 }
 
-std::shared_ptr<const CGALNefGeometry> getNefPolyhedronFromGeometry(
+namespace {
+
+std::shared_ptr<const CGALNefGeometry> convertToNefPolyhedron(
   const std::shared_ptr<const Geometry>& geom)
 {
   if (auto ps = std::dynamic_pointer_cast<const PolySet>(geom)) {
@@ -267,8 +271,6 @@ std::shared_ptr<const CGALNefGeometry> getNefPolyhedronFromGeometry(
   } else if (auto poly2d = std::dynamic_pointer_cast<const Polygon2d>(geom)) {
     std::shared_ptr<PolySet> ps(poly2d->tessellate());
     return std::shared_ptr<CGALNefGeometry>(createNefPolyhedronFromPolySet(*ps));
-  } else if (auto nef = std::dynamic_pointer_cast<const CGALNefGeometry>(geom)) {
-    return nef;
 #if ENABLE_MANIFOLD
   } else if (auto mani = std::dynamic_pointer_cast<const ManifoldGeometry>(geom)) {
     return std::shared_ptr<CGALNefGeometry>(createNefPolyhedronFromPolySet(*mani->toPolySet()));
@@ -277,6 +279,31 @@ std::shared_ptr<const CGALNefGeometry> getNefPolyhedronFromGeometry(
   return nullptr;
 }
 
+}  // namespace
+
+/*!
+   Returns geom as a Nef polyhedron. Conversions are memoized in the CGALCache by the
+   identity of geom, so an operand used by many booleans (e.g. the same cylinder
+   subtracted from several bodies) is only converted once.
+ */
+std::shared_ptr<const CGALNefGeometry> getNefPolyhedronFromGeometry(
+  const std::shared_ptr<const Geometry>& geom)
+{
+  if (auto nef = std::dynamic_pointer_cast<const CGALNefGeometry>(geom)) return nef;
+  if (!geom) return nullptr;
+
+  if (auto cached = CGALCache::instance()->getConverted(geom)) {
+    return std::dynamic_pointer_cast<const CGALNefGeometry>(cached);
+  }
+  const auto start = std::chrono::steady_clock::now();
+  auto N = convertToNefPolyhedron(geom);
+  if (N) {
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    CGALCache::instance()->insertConverted(geom, N, elapsed.count());
+  }
+  return N;
+}
+
 /*
    Create a PolySet from a Nef Polyhedron 3. return false on success,
    true on failure. The trick to this is that Nef Polyhedron3 faces have
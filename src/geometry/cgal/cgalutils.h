@@ -35,6 +35,8 @@ std::shared_ptr<const Geometry> applyOperator3D(const Geometry::Geometries& chil
                                                 OpenSCADOperator op);
 std::unique_ptr<const Geometry> applyUnion3D(Geometry::Geometries::iterator chbegin,
                                              Geometry::Geometries::iterator chend);
+std::shared_ptr<const Geometry> applyOperator3DCorefine(const Geometry::Geometries& children,
+                                                        OpenSCADOperator op);
 std::shared_ptr<const Geometry> applyMinkowski3D(const Geometry::Geometries& children);
 
 std::unique_ptr<Polygon2d> project(const CGALNefGeometry& N, bool cut);
@@ -19,14 +19,19 @@
 #endif
 
 #include <algorithm>
-#include <map>
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
 
 #include "geometry/linalg.h"
 #include "geometry/Polygon2d.h"
 #include "geometry/GeometryUtils.h"
 #include "geometry/ClipperUtils.h"
 #include "core/RoofNode.h"
+#include "geometry/PolySet.h"
 #include "geometry/PolySetBuilder.h"
+#include "utils/hash.h"
+#include "utils/parallel.h"
 
 #define RAISE_ROOF_EXCEPTION(message) \
   throw RoofNode::roof_exception(     \
@@ -85,82 +90,106 @@ std::vector<CGAL_Polygon_with_holes_2> polygons_with_holes(const Clipper2Lib::Po
   return ret;
 }
 
-std::unique_ptr<PolySet> straight_skeleton_roof(const Polygon2d& poly)
+// the floor is built from the same coordinates as the roof, so their vertices coincide
+Polygon2d to_polygon2d(const CGAL_Polygon_with_holes_2& shape)
+{
+  Polygon2d poly;
+  auto add_outline = [&poly](const CGAL_Polygon_2& polygon, bool positive) {
+    Outline2d outline;
+    outline.positive = positive;
+    for (auto v = polygon.vertices_begin(); v != polygon.vertices_end(); v++) {
+      outline.vertices.emplace_back(v->x(), v->y());
+    }
+    poly.addOutline(std::move(outline));
+  };
+  add_outline(shape.outer_boundary(), true);
+  for (auto hole = shape.holes_begin(); hole != shape.holes_end(); hole++) add_outline(*hole, false);
+  poly.setSanitized(true);
+  return poly;
+}
+
+// roof and floor over a single polygon with holes
+std::unique_ptr<PolySet> shape_roof(const CGAL_Polygon_with_holes_2& shape)
 {
   PolySetBuilder hatbuilder;
 
-  const int scale_bits = ClipperUtils::scaleBitsFromPrecision();
-  const Clipper2Lib::Paths64 paths = ClipperUtils::fromPolygon2d(poly, scale_bits);
-  const std::unique_ptr<Clipper2Lib::PolyTree64> polytree = ClipperUtils::sanitize(paths);
-  auto poly_sanitized = ClipperUtils::toPolygon2d(*polytree, scale_bits);
-
-  try {
-    // roof
-    const std::vector<CGAL_Polygon_with_holes_2> shapes = polygons_with_holes(*polytree, scale_bits);
-    for (const CGAL_Polygon_with_holes_2& shape : shapes) {
-      const CGAL_SsPtr ss = CGAL::create_interior_straight_skeleton_2(shape);
-      // store heights of vertices
-      auto vector2d_comp = [](const Vector2d& a, const Vector2d& b) {
-        return (a[0] < b[0]) || (a[0] == b[0] && a[1] < b[1]);
-      };
-      std::map<Vector2d, double, decltype(vector2d_comp)> heights(vector2d_comp);
-      for (auto v = ss->vertices_begin(); v != ss->vertices_end(); v++) {
-        const Vector2d p(v->point().x(), v->point().y());
-        heights[p] = v->time();
+  // roof
+  const CGAL_SsPtr ss = CGAL::create_interior_straight_skeleton_2(shape);
+  // store heights of vertices
+  std::unordered_map<Vector2d, double> heights;
+  heights.reserve(ss->size_of_vertices());
+  for (auto v = ss->vertices_begin(); v != ss->vertices_end(); v++) {
+    const Vector2d p(v->point().x(), v->point().y());
+    heights[p] = v->time();
+  }
+
+  for (auto ss_face = ss->faces_begin(); ss_face != ss->faces_end(); ss_face++) {
+    // convert ss_face to cgal polygon
+    CGAL_Polygon_2 face;
+    for (auto h = ss_face->halfedge();;) {
+      const CGAL_Point_2 pp = h->vertex()->point();
+      face.push_back(pp);
+      h = h->next();
+      if (h == ss_face->halfedge()) {
+        break;
       }
+    }
+    if (!face.is_simple()) {
+      RAISE_ROOF_EXCEPTION("A non-simple face in straight skeleton, likely cause is cgal issue #5177");
+    }
+
+    // do convex partition if necessary
+    std::vector<CGAL_PT::Polygon_2> facets;
+    CGAL::approx_convex_partition_2(face.vertices_begin(), face.vertices_end(),
+                                    std::back_inserter(facets));
 
-      for (auto ss_face = ss->faces_begin(); ss_face != ss->faces_end(); ss_face++) {
-        // convert ss_face to cgal polygon
-        CGAL_Polygon_2 face;
-        for (auto h = ss_face->halfedge();;) {
-          const CGAL_Point_2 pp = h->vertex()->point();
-          face.push_back(pp);
-          h = h->next();
-          if (h == ss_face->halfedge()) {
-            break;
-          }
-        }
-        if (!face.is_simple()) {
-          RAISE_ROOF_EXCEPTION(
-            "A non-simple face in straight skeleton, likely cause is cgal issue #5177");
-        }
-
-        // do convex partition if necessary
-        std::vector<CGAL_PT::Polygon_2> facets;
-        CGAL::approx_convex_partition_2(face.vertices_begin(), face.vertices_end(),
-                                        std::back_inserter(facets));
-
-        for (const auto& facet : facets) {
-          std::vector<int> roof;
-          for (auto v = facet.vertices_begin(); v != facet.vertices_end(); v++) {
-            const Vector2d vv(v->x(), v->y());
-            roof.push_back(hatbuilder.vertexIndex(Vector3d(v->x(), v->y(), heights[vv])));
-          }
-          hatbuilder.appendPolygon(roof);
-        }
+    for (const auto& facet : facets) {
+      std::vector<int> roof;
+      for (auto v = facet.vertices_begin(); v != facet.vertices_end(); v++) {
+        const Vector2d vv(v->x(), v->y());
+        roof.push_back(hatbuilder.vertexIndex(Vector3d(v->x(), v->y(), heights[vv])));
       }
+      hatbuilder.appendPolygon(roof);
     }
+  }
 
-    // floor
-    {
-      // poly has to go through clipper just as it does for the roof
-      // because this may change coordinates
-      auto tess = poly_sanitized->tessellate();
-      for (const IndexedFace& triangle : tess->indices) {
-        std::vector<int> floor;
-        for (const int tv : triangle) {
-          floor.push_back(hatbuilder.vertexIndex(tess->vertices[tv]));
-        }
-        // floor has wrong orientation
-        std::reverse(floor.begin(), floor.end());
-        hatbuilder.appendPolygon(floor);
+  // floor
+  {
+    auto tess = to_polygon2d(shape).tessellate();
+    for (const IndexedFace& triangle : tess->indices) {
+      std::vector<int> floor;
+      for (const int tv : triangle) {
+        floor.push_back(hatbuilder.vertexIndex(tess->vertices[tv]));
       }
+      // floor has wrong orientation
+      std::reverse(floor.begin(), floor.end());
+      hatbuilder.appendPolygon(floor);
     }
+  }
+
+  return hatbuilder.build();
+}
+
+std::unique_ptr<PolySet> straight_skeleton_roof(const Polygon2d& poly)
+{
+  const int scale_bits = ClipperUtils::scaleBitsFromPrecision();
+  const Clipper2Lib::Paths64 paths = ClipperUtils::fromPolygon2d(poly, scale_bits);
+  const std::unique_ptr<Clipper2Lib::PolyTree64> polytree = ClipperUtils::sanitize(paths);
+
+  // The skeleton of a polygon with holes doesn't depend on any other, so each shape is roofed
+  // on its own, in parallel. Exceptions are passed on to this thread.
+  const std::vector<CGAL_Polygon_with_holes_2> shapes = polygons_with_holes(*polytree, scale_bits);
+  std::vector<std::unique_ptr<PolySet>> hats(shapes.size());
+  parallelizable_transform(shapes.begin(), shapes.end(), hats.begin(), shape_roof);
 
-    return hatbuilder.build();
-  } catch (RoofNode::roof_exception& e) {
-    throw;
+  size_t num_vertices = 0, num_polygons = 0;
+  for (const auto& hat : hats) {
+    num_vertices += hat->vertices.size();
+    num_polygons += hat->indices.size();
   }
+  PolySetBuilder hatbuilder(num_vertices, num_polygons);
+  for (const auto& hat : hats) hatbuilder.appendPolySet(*hat);
+  return hatbuilder.build();
 }
 
 }  // namespace roof_ss
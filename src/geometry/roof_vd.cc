@@ -9,16 +9,21 @@
 #include <cmath>
 #include <cstddef>
 #include <algorithm>
-#include <map>
+#include <functional>
+#include <unordered_map>
+#include <utility>
 #include <boost/polygon/voronoi.hpp>
 #include <vector>
 #include "geometry/linalg.h"
 #include "geometry/Polygon2d.h"
+#include "geometry/PolySet.h"
 #include "geometry/PolySetBuilder.h"
 
 #include "geometry/GeometryUtils.h"
 #include "geometry/ClipperUtils.h"
 #include "core/RoofNode.h"
+#include "utils/hash.h"
+#include "utils/parallel.h"
 
 #define RAISE_ROOF_EXCEPTION(message) \
   throw RoofNode::roof_exception(     \
@@ -201,14 +206,8 @@ std::vector<Vector2d> discretize_arc(const Point& point, const Segment& segment,
 
 // a structure that saves 2d faces and heights of vertices
 struct Faces_2_plus_1 {
-  struct Vector2d_comp {
-    bool operator()(const Vector2d& lhs, const Vector2d& rhs) const
-    {
-      return (lhs[0] < rhs[0]) || (lhs[0] == rhs[0] && lhs[1] < rhs[1]);
-    }
-  };
   std::vector<std::vector<Vector2d>> faces;
-  std::map<Vector2d, double, Vector2d_comp> heights;
+  std::unordered_map<Vector2d, double> heights;
 };
 
 Faces_2_plus_1 vd_inner_faces(const voronoi_diagram& vd, const std::vector<Segment>& segments,
@@ -340,89 +339,125 @@ Faces_2_plus_1 vd_inner_faces(const voronoi_diagram& vd, const std::vector<Segme
   return ret;
 }
 
-std::unique_ptr<PolySet> voronoi_diagram_roof(const Polygon2d& poly, const CurveDiscretizer& discretizer)
+// break sanitized outlines into polygons with their holes
+std::vector<Clipper2Lib::Paths64> polygons_with_holes(const Clipper2Lib::PolyTree64& polytree)
 {
-  PolySetBuilder hatbuilder = PolySetBuilder();
-
-  try {
-    // input data for voronoi diagram is 32 bit integers
-    // FIXME: Why does this need to be 32 bits? The default we use elsewhere is
-    // scaleBitsFromPrecision(DEFAULT_PRECISION) which is 10^8.
-    const int scale_bits = ClipperUtils::scaleBitsFromBounds(poly.getBoundingBox(), 32);
-    const double scale = std::ldexp(1.0, scale_bits);
+  std::vector<Clipper2Lib::Paths64> ret;
+  std::function<void(const Clipper2Lib::PolyPath64&)> walk = [&](const Clipper2Lib::PolyPath64& c) {
+    Clipper2Lib::Paths64 shape{c.Polygon()};
+    for (const auto& cc : c) {
+      shape.push_back(cc->Polygon());
+      for (const auto& ccc : *cc) walk(*ccc);
+    }
+    ret.push_back(std::move(shape));
+  };
+  for (const auto& root_node : polytree) walk(*root_node);
+  return ret;
+}
 
-    Clipper2Lib::Paths64 paths = ClipperUtils::fromPolygon2d(poly, scale_bits);
-    // sanitize is important e.g. when after converting to 32 bit integers we have double points
-    paths = Clipper2Lib::PolyTreeToPaths64(*ClipperUtils::sanitize(paths));
-    std::vector<Segment> segments;
+// roof and floor over a single polygon with holes
+std::unique_ptr<PolySet> shape_roof(const Clipper2Lib::Paths64& paths, double scale,
+                                    const CurveDiscretizer& discretizer)
+{
+  PolySetBuilder hatbuilder = PolySetBuilder();
 
-    for (auto path : paths) {
-      auto prev = path.back();
-      for (auto p : path) {
-        segments.emplace_back(prev.x, prev.y, p.x, p.y);
-        prev = p;
-      }
+  std::vector<Segment> segments;
+  for (auto path : paths) {
+    auto prev = path.back();
+    for (auto p : path) {
+      segments.emplace_back(prev.x, prev.y, p.x, p.y);
+      prev = p;
     }
+  }
 
-    voronoi_diagram vd;
-    ::boost::polygon::construct_voronoi(segments.begin(), segments.end(), &vd);
-    Faces_2_plus_1 inner_faces = vd_inner_faces(vd, segments, RoofDiscretizer(discretizer, scale));
+  voronoi_diagram vd;
+  ::boost::polygon::construct_voronoi(segments.begin(), segments.end(), &vd);
+  Faces_2_plus_1 inner_faces = vd_inner_faces(vd, segments, RoofDiscretizer(discretizer, scale));
 
-    // roof
-    for (const std::vector<Vector2d>& face : inner_faces.faces) {
-      if (!(face.size() >= 3)) {
-        RAISE_ROOF_EXCEPTION("Voronoi error");
-      }
-      // convex partition (actually a triangulation - maybe do a proper convex partition later)
-      Polygon2d face_poly;
-      Outline2d outline;
-      outline.vertices = face;
-      face_poly.addOutline(outline);
-      auto tess = face_poly.tessellate();
-      for (const IndexedFace& triangle : tess->indices) {
-        std::vector<int> roof;
-        for (int tvind : triangle) {
-          Vector3d tv = tess->vertices[tvind];
-          Vector2d v;
-          v << tv[0], tv[1];
-          if (!(inner_faces.heights.find(v) != inner_faces.heights.end())) {
-            RAISE_ROOF_EXCEPTION("Voronoi error");
-          }
-          roof.push_back(hatbuilder.vertexIndex(
-            Vector3d(v[0] / scale, v[1] / scale, inner_faces.heights[v] / scale)));
+  // roof
+  for (const std::vector<Vector2d>& face : inner_faces.faces) {
+    if (!(face.size() >= 3)) {
+      RAISE_ROOF_EXCEPTION("Voronoi error");
+    }
+    // convex partition (actually a triangulation - maybe do a proper convex partition later)
+    Polygon2d face_poly;
+    Outline2d outline;
+    outline.vertices = face;
+    face_poly.addOutline(outline);
+    auto tess = face_poly.tessellate();
+    for (const IndexedFace& triangle : tess->indices) {
+      std::vector<int> roof;
+      for (int tvind : triangle) {
+        Vector3d tv = tess->vertices[tvind];
+        Vector2d v;
+        v << tv[0], tv[1];
+        const auto height = inner_faces.heights.find(v);
+        if (height == inner_faces.heights.end()) {
+          RAISE_ROOF_EXCEPTION("Voronoi error");
         }
-        hatbuilder.appendPolygon(roof);
+        roof.push_back(
+          hatbuilder.vertexIndex(Vector3d(v[0] / scale, v[1] / scale, height->second / scale)));
       }
+      hatbuilder.appendPolygon(roof);
     }
+  }
 
-    // floor
-    {
-      // poly has to go through clipper just as it does for the roof
-      // because this may change coordinates
-      Polygon2d poly_floor;
-      for (const auto& path : paths) {
-        Outline2d o;
-        for (auto p : path) {
-          o.vertices.push_back({p.x / scale, p.y / scale});
-        }
-        poly_floor.addOutline(o);
+  // floor
+  {
+    // poly has to go through clipper just as it does for the roof
+    // because this may change coordinates
+    Polygon2d poly_floor;
+    for (const auto& path : paths) {
+      Outline2d o;
+      for (auto p : path) {
+        o.vertices.push_back({p.x / scale, p.y / scale});
       }
-      auto tess = poly_floor.tessellate();
-      for (const IndexedFace& triangle : tess->indices) {
-        std::vector<int> floor;
-        for (const int tv : triangle) {
-          floor.push_back(hatbuilder.vertexIndex(tess->vertices[tv]));
-        }
-        // floor has reverse orientation
-        std::reverse(floor.begin(), floor.end());
-        hatbuilder.appendPolygon(floor);
+      poly_floor.addOutline(o);
+    }
+    auto tess = poly_floor.tessellate();
+    for (const IndexedFace& triangle : tess->indices) {
+      std::vector<int> floor;
+      for (const int tv : triangle) {
+        floor.push_back(hatbuilder.vertexIndex(tess->vertices[tv]));
       }
+      // floor has reverse orientation
+      std::reverse(floor.begin(), floor.end());
+      hatbuilder.appendPolygon(floor);
     }
-  } catch (RoofNode::roof_exception& e) {
-    throw;
   }
 
   return hatbuilder.build();
 }
 
+std::unique_ptr<PolySet> voronoi_diagram_roof(const Polygon2d& poly, const CurveDiscretizer& discretizer)
+{
+  // input data for voronoi diagram is 32 bit integers
+  // FIXME: Why does this need to be 32 bits? The default we use elsewhere is
+  // scaleBitsFromPrecision(DEFAULT_PRECISION) which is 10^8.
+  const int scale_bits = ClipperUtils::scaleBitsFromBounds(poly.getBoundingBox(), 32);
+  const double scale = std::ldexp(1.0, scale_bits);
+
+  const Clipper2Lib::Paths64 paths = ClipperUtils::fromPolygon2d(poly, scale_bits);
+  // sanitize is important e.g. when after converting to 32 bit integers we have double points
+  const auto polytree = ClipperUtils::sanitize(paths);
+
+  // Points inside a polygon are closer to its own outlines than to those of any other polygon,
+  // so each polygon with its holes gets its own diagram, in parallel. Exceptions are passed on
+  // to this thread.
+  const std::vector<Clipper2Lib::Paths64> shapes = polygons_with_holes(*polytree);
+  std::vector<std::unique_ptr<PolySet>> hats(shapes.size());
+  parallelizable_transform(shapes.begin(), shapes.end(), hats.begin(), [&](const auto& shape) {
+    return shape_roof(shape, scale, discretizer);
+  });
+
+  size_t num_vertices = 0, num_polygons = 0;
+  for (const auto& hat : hats) {
+    num_vertices += hat->vertices.size();
+    num_polygons += hat->indices.size();
+  }
+  PolySetBuilder hatbuilder(num_vertices, num_polygons);
+  for (const auto& hat : hats) hatbuilder.appendPolySet(*hat);
+  return hatbuilder.build();
+}
+
 }  // namespace roof_vd
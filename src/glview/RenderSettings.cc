@@ -6,9 +6,10 @@
 std::string renderBackend3DToString(RenderBackend3D backend)
 {
   switch (backend) {
-  case RenderBackend3D::CGALBackend:     return "CGAL";
-  case RenderBackend3D::ManifoldBackend: return "Manifold";
-  default:                               throw std::runtime_error("Unknown rendering backend");
+  case RenderBackend3D::CGALBackend:         return "CGAL";
+  case RenderBackend3D::ManifoldBackend:     return "Manifold";
+  case RenderBackend3D::CorefinementBackend: return "Corefinement";
+  default:                                   throw std::runtime_error("Unknown rendering backend");
   }
 }
 
@@ -19,6 +20,8 @@ std::optional<RenderBackend3D> renderBackend3DFromString(std::string backend)
     return RenderBackend3D::CGALBackend;
   } else if (backend == "manifold") {
     return RenderBackend3D::ManifoldBackend;
+  } else if (backend == "corefinement") {
+    return RenderBackend3D::CorefinementBackend;
   } else {
     return {};
   }
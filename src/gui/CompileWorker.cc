@@ -0,0 +1,207 @@
+#include "gui/CompileWorker.h"
+
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <vector>
+#include <QThread>
+
+#include "core/BuiltinContext.h"
+#include "core/Context.h"
+#include "core/CSGNode.h"
+#include "core/EvaluationSession.h"
+#include "core/node.h"
+#include "core/progress.h"
+#include "core/SourceFile.h"
+#include "core/Tree.h"
+#include "geometry/GeometryEvaluator.h"
+#include "glview/preview/CSGTreeNormalizer.h"
+#include "utils/exceptions.h"
+#include "utils/printutils.h"
+#include "utils/StackCheck.h"
+#ifdef ENABLE_OPENCSG
+#include "core/CSGTreeEvaluator.h"
+#endif
+
+#ifdef ENABLE_PYTHON
+#include "python/python_public.h"
+#endif
+
+namespace {
+
+bool sameView(const Camera& a, const Camera& b)
+{
+  return a.getVpr() == b.getVpr() && a.getVpt() == b.getVpt() && a.zoomValue() == b.zoomValue() &&
+         a.fovValue() == b.fovValue();
+}
+
+std::shared_ptr<CSGProducts> normalizeTerms(CSGTreeNormalizer& normalizer,
+                                            const std::vector<std::shared_ptr<CSGNode>>& terms)
+{
+  if (terms.empty()) return nullptr;
+  auto products = std::make_shared<CSGProducts>();
+  for (const auto& term : terms) {
+    if (auto nterm = normalizer.normalize(term)) products->import(nterm);
+  }
+  return products;
+}
+
+}  // namespace
+
+CompileWorker::CompileWorker()
+{
+  this->thread = new QThread();
+  // Evaluation recurses on this thread, so give it the stack size of the main thread
+  this->thread->setStackSize(STACKSIZE);
+  connect(this->thread, &QThread::started, this, &CompileWorker::work);
+  moveToThread(this->thread);
+}
+
+CompileWorker::~CompileWorker()
+{
+  cancel();
+  this->thread->wait();
+  delete this->thread;
+}
+
+bool CompileWorker::isRunning() const { return this->thread->isRunning(); }
+
+void CompileWorker::start(const CompileJob& job)
+{
+#ifdef ENABLE_PYTHON
+  python_unlock();
+#endif
+  this->job = job;
+  this->canceled = false;
+  this->thread->start();
+}
+
+void CompileWorker::report(const std::shared_ptr<const AbstractNode>& node, void *userdata, int mark)
+{
+  auto worker = static_cast<CompileWorker *>(userdata);
+  if (worker->canceled) throw ProgressCancelException();
+  if (worker->job.progress) worker->job.progress(node, worker->job.progressData, mark);
+}
+
+void CompileWorker::instantiate(CompileResult& result)
+{
+  const std::string documentRoot = std::filesystem::path(this->job.documentPath).parent_path().string();
+  result.absoluteRootNode = this->job.absoluteRootNode;
+  if (!result.absoluteRootNode) {
+    AbstractNode::resetIndexCounter();
+
+    EvaluationSession session{documentRoot};
+    session.setCancellationToken(&this->canceled);
+    ContextHandle<BuiltinContext> builtin_context{Context::create<BuiltinContext>(&session)};
+    this->job.renderVariables.applyToContext(builtin_context);
+
+    std::shared_ptr<const FileContext> file_context;
+    result.absoluteRootNode = this->job.rootFile->instantiate(*builtin_context, &file_context);
+    if (file_context) {
+      result.camera = this->job.renderVariables.camera;
+      result.camera.updateView(file_context, false);
+      result.cameraChanged = !sameView(result.camera, this->job.renderVariables.camera);
+    }
+  }
+
+  if (result.absoluteRootNode) {
+    // Do we have an explicit root node (! modifier)?
+    const Location *nextLocation = nullptr;
+    if (!(result.rootNode = find_root_tag(result.absoluteRootNode, &nextLocation))) {
+      result.rootNode = result.absoluteRootNode;
+    }
+    if (nextLocation) {
+      LOG(message_group::NONE, *nextLocation, documentRoot, "More than one Root Modifier (!)");
+    }
+  }
+}
+
+void CompileWorker::buildCSG(CompileResult& result)
+{
+  LOG("Compiling design (CSG Products generation)...");
+
+  // Main CSG evaluation
+  const Tree tree(result.rootNode,
+                  std::filesystem::path(this->job.documentPath).parent_path().string());
+  GeometryEvaluator geomevaluator(tree);
+#ifdef ENABLE_OPENCSG
+  CSGTreeEvaluator csgrenderer(tree, &geomevaluator);
+#endif
+
+  progress_report_prep(result.rootNode, report, this);
+  try {
+#ifdef ENABLE_OPENCSG
+    result.csgRoot = csgrenderer.buildCSGTree(*result.rootNode);
+#endif
+  } catch (const ProgressCancelException&) {
+    if (this->canceled) {
+      progress_report_fin();
+      throw;
+    }
+    LOG("CSG generation cancelled.");
+  } catch (const HardWarningException&) {
+    LOG("CSG generation cancelled due to hardwarning being enabled.");
+  }
+  progress_report_fin();
+
+  LOG("Compiling design (CSG Products normalization)...");
+  CSGTreeNormalizer normalizer(this->job.normalizeLimit);
+  if (result.csgRoot) {
+    result.normalizedRoot = normalizer.normalize(result.csgRoot);
+    if (result.normalizedRoot) {
+      result.rootProduct = std::make_shared<CSGProducts>();
+      result.rootProduct->import(result.normalizedRoot);
+    } else {
+      LOG(message_group::Warning, "CSG normalization resulted in an empty tree");
+    }
+  }
+  if (this->canceled) throw ProgressCancelException();
+
+#ifdef ENABLE_OPENCSG
+  const auto& highlight_terms = csgrenderer.getHighlightNodes();
+  if (!highlight_terms.empty()) {
+    LOG("Compiling highlights (%1$d CSG Trees)...", highlight_terms.size());
+    result.highlightsProducts = normalizeTerms(normalizer, highlight_terms);
+  }
+
+  const auto& background_terms = csgrenderer.getBackgroundNodes();
+  if (!background_terms.empty()) {
+    LOG("Compiling background (%1$d CSG Trees)...", background_terms.size());
+    result.backgroundProducts = normalizeTerms(normalizer, background_terms);
+  }
+#endif
+}
+
+void CompileWorker::work()
+{
+  // this is a worker thread: we don't want any exceptions escaping and crashing the app.
+#ifdef ENABLE_PYTHON
+  python_lock();
+#endif
+  StackCheck::inst().reset(STACKSIZE);
+  auto result = std::make_shared<CompileResult>();
+  result->id = this->job.id;
+  try {
+    if (this->job.rootFile || this->job.absoluteRootNode) instantiate(*result);
+    if (this->canceled) throw ProgressCancelException();
+    if (this->job.buildCSG && result->rootNode) buildCSG(*result);
+  } catch (const ProgressCancelException&) {
+    result->status = CompileResult::Status::Cancelled;
+  } catch (const HardWarningException&) {
+    result->status = CompileResult::Status::HardWarning;
+  } catch (const std::exception& e) {
+    result->status = CompileResult::Status::Error;
+    result->error = e.what();
+  } catch (...) {
+    result->status = CompileResult::Status::Error;
+  }
+  if (result->status != CompileResult::Status::Done) {
+    // Don't hand out half-evaluated designs
+    *result = CompileResult{result->id, result->status, result->error};
+  }
+#ifdef ENABLE_PYTHON
+  python_unlock();
+#endif
+  emit done(result);
+  thread->quit();
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QObject>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "core/RenderVariables.h"
+#include "glview/Camera.h"
+
+class AbstractNode;
+class CSGNode;
+class CSGProducts;
+class SourceFile;
+
+// Everything the worker needs, captured on the UI thread
+struct CompileJob {
+  unsigned int id{0};
+  std::shared_ptr<SourceFile> rootFile;
+  // Set instead of rootFile if the design has already been evaluated, e.g. by Python
+  std::shared_ptr<AbstractNode> absoluteRootNode;
+  std::string documentPath;
+  RenderVariables renderVariables;
+  // Generate CSG products for preview
+  bool buildCSG{false};
+  size_t normalizeLimit{0};
+  void (*progress)(const std::shared_ptr<const AbstractNode>&, void *, int){nullptr};
+  void *progressData{nullptr};
+};
+
+struct CompileResult {
+  enum class Status { Done, Cancelled, HardWarning, Error };
+
+  unsigned int id{0};
+  Status status{Status::Done};
+  std::string error;
+  // Only set if the design changed the camera through $vpr, $vpt etc.
+  bool cameraChanged{false};
+  Camera camera;
+
+  std::shared_ptr<AbstractNode> absoluteRootNode;
+  std::shared_ptr<AbstractNode> rootNode;
+  std::shared_ptr<CSGNode> csgRoot;
+  std::shared_ptr<CSGNode> normalizedRoot;
+  std::shared_ptr<CSGProducts> rootProduct;
+  std::shared_ptr<CSGProducts> highlightsProducts;
+  std::shared_ptr<CSGProducts> backgroundProducts;
+};
+
+/*!
+   Instantiates the parsed design and generates the CSG products for preview on a
+   worker thread, so the editor stays responsive. A running compile can be cancelled,
+   in which case done() is emitted with CompileResult::Status::Cancelled.
+ */
+class CompileWorker : public QObject
+{
+  Q_OBJECT;
+
+public:
+  CompileWorker();
+  ~CompileWorker() override;
+
+  [[nodiscard]] bool isRunning() const;
+  // Asks the running job to stop, thread-safe
+  void cancel() { this->canceled = true; }
+
+public slots:
+  void start(const CompileJob& job);
+
+protected slots:
+  void work();
+
+signals:
+  void done(std::shared_ptr<const CompileResult>);
+
+protected:
+  static void report(const std::shared_ptr<const AbstractNode>& node, void *userdata, int mark);
+  void instantiate(CompileResult& result);
+  void buildCSG(CompileResult& result);
+
+  class QThread *thread;
+  CompileJob job;
+  std::atomic<bool> canceled{false};
+};
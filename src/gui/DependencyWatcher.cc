@@ -0,0 +1,142 @@
+#include "gui/DependencyWatcher.h"
+
+#include <filesystem>
+#include <set>
+#include <string>
+#include <QTimer>
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <QSocketNotifier>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <QFileSystemWatcher>
+#include <QString>
+#include <QStringList>
+#endif
+
+#include "utils/printutils.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Editors and version control tools often touch a file several times in a row
+constexpr int DEBOUNCE_MS = 100;
+
+}  // namespace
+
+DependencyWatcher::DependencyWatcher(QObject *parent) : QObject(parent)
+{
+  this->debounceTimer = new QTimer(this);
+  this->debounceTimer->setSingleShot(true);
+  this->debounceTimer->setInterval(DEBOUNCE_MS);
+  connect(this->debounceTimer, &QTimer::timeout, this, &DependencyWatcher::changed);
+
+#ifdef Q_OS_LINUX
+  this->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (this->fd < 0) {
+    LOG(message_group::Warning, "Unable to watch files for automatic reload: %1$s", strerror(errno));
+    return;
+  }
+  this->notifier = new QSocketNotifier(this->fd, QSocketNotifier::Read, this);
+  connect(this->notifier, &QSocketNotifier::activated, this, &DependencyWatcher::readEvents);
+#else
+  this->watcher = new QFileSystemWatcher(this);
+  connect(this->watcher, &QFileSystemWatcher::fileChanged, this, &DependencyWatcher::fileEvent);
+  connect(this->watcher, &QFileSystemWatcher::directoryChanged, this, &DependencyWatcher::fileEvent);
+#endif
+}
+
+DependencyWatcher::~DependencyWatcher()
+{
+#ifdef Q_OS_LINUX
+  if (this->fd >= 0) close(this->fd);
+#endif
+}
+
+void DependencyWatcher::setFiles(const std::set<std::string>& files)
+{
+  this->files.clear();
+  std::set<std::string> dirs;
+  for (const auto& file : files) {
+    const auto path = fs::path(file).lexically_normal();
+    this->files.insert(path.generic_string());
+    dirs.insert(path.parent_path().generic_string());
+  }
+
+#ifdef Q_OS_LINUX
+  if (this->fd < 0) return;
+  for (auto it = this->watchedDirs.begin(); it != this->watchedDirs.end();) {
+    if (dirs.count(it->second)) {
+      ++it;
+    } else {
+      inotify_rm_watch(this->fd, it->first);
+      this->dirs.erase(it->second);
+      it = this->watchedDirs.erase(it);
+    }
+  }
+  for (const auto& dir : dirs) {
+    if (this->dirs.count(dir)) continue;
+    // Directories which don't exist (yet) are retried with the next set of files
+    const int wd = inotify_add_watch(this->fd, dir.c_str(),
+                                     IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ATTRIB);
+    if (wd < 0) continue;
+    this->watchedDirs[wd] = dir;
+    this->dirs.insert(dir);
+  }
+#else
+  // QFileSystemWatcher doesn't report changes to the content of files in watched directories
+  const auto watched = this->watcher->files() + this->watcher->directories();
+  if (!watched.isEmpty()) this->watcher->removePaths(watched);
+  QStringList paths;
+  for (const auto& path : this->files) {
+    if (fs::exists(path)) paths << QString::fromStdString(path);
+  }
+  this->dirs.clear();
+  for (const auto& dir : dirs) {
+    if (fs::is_directory(dir)) {
+      paths << QString::fromStdString(dir);
+      this->dirs.insert(dir);
+    }
+  }
+  if (!paths.isEmpty()) this->watcher->addPaths(paths);
+#endif
+}
+
+void DependencyWatcher::fileEvent() { this->debounceTimer->start(); }
+
+#ifdef Q_OS_LINUX
+void DependencyWatcher::readEvents()
+{
+  alignas(struct inotify_event) char buffer[4096];
+  bool relevant = false;
+  ssize_t len;
+  while ((len = read(this->fd, buffer, sizeof(buffer))) > 0) {
+    for (const char *ptr = buffer; ptr < buffer + len;) {
+      const auto *event = reinterpret_cast<const struct inotify_event *>(ptr);
+      ptr += sizeof(struct inotify_event) + event->len;
+
+      // Events were lost, so anything could have changed
+      if (event->mask & IN_Q_OVERFLOW) {
+        relevant = true;
+        continue;
+      }
+      const auto dir = this->watchedDirs.find(event->wd);
+      if (dir == this->watchedDirs.end()) continue;
+      // The directory itself was removed
+      if (event->mask & IN_IGNORED) {
+        this->dirs.erase(dir->second);
+        this->watchedDirs.erase(dir);
+        relevant = true;
+        continue;
+      }
+      if (event->len > 0 && this->files.count((fs::path(dir->second) / event->name).generic_string())) {
+        relevant = true;
+      }
+    }
+  }
+  if (relevant) fileEvent();
+}
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QObject>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+class QTimer;
+#ifdef Q_OS_LINUX
+class QSocketNotifier;
+#else
+class QFileSystemWatcher;
+#endif
+
+/*!
+   Watches the files a design depends on and emits changed() once they have settled,
+   so auto-reload doesn't have to poll.
+
+   Files are watched through their parent directories, so files replaced by editors
+   (written to a temporary file and renamed) or appearing later are noticed as well.
+   On Linux, this uses inotify directly and only reacts to the watched files. Elsewhere
+   QFileSystemWatcher is used, which reports any change in the directories.
+ */
+class DependencyWatcher : public QObject
+{
+  Q_OBJECT
+
+public:
+  DependencyWatcher(QObject *parent = nullptr);
+  ~DependencyWatcher() override;
+
+  void setFiles(const std::set<std::string>& files);
+  void clear() { setFiles({}); }
+
+signals:
+  void changed();
+
+private:
+  void fileEvent();
+
+  QTimer *debounceTimer;
+  std::set<std::string> files;
+  std::set<std::string> dirs;
+#ifdef Q_OS_LINUX
+  void readEvents();
+
+  int fd{-1};
+  QSocketNotifier *notifier{nullptr};
+  std::unordered_map<int, std::string> watchedDirs;  // watch descriptor -> directory
+#else
+  QFileSystemWatcher *watcher;
+#endif
+};
@@ -36,6 +36,7 @@
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <set>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -112,6 +113,8 @@
 #include "glview/RenderSettings.h"
 #include "gui/AboutDialog.h"
 #include "gui/CGALWorker.h"
+#include "gui/CompileWorker.h"
+#include "gui/DependencyWatcher.h"
 #include "gui/Editor.h"
 #include "gui/Dock.h"
 #include "gui/Measurement.h"
@@ -200,7 +203,8 @@ QElapsedTimer *MainWindow::progressThrottle = new QElapsedTimer();
 
 namespace {
 
-const int autoReloadPollingPeriodMS = 200;
+// Delay for retrying an auto-reload and for dependency updates to settle
+const int autoReloadRetryPeriodMS = 200;
 const char copyrighttext[] =
   "<p>Copyright (C) 2009-2025 The OpenSCAD Developers</p>"
   "<p>This program is free software; you can redistribute it and/or modify "
@@ -308,6 +312,9 @@ MainWindow::MainWindow(const QStringList& filenames) : rubberBandManager(this)
     connect(recent, &QAction::triggered, this, &MainWindow::actionOpenRecent);
   }
 
+  // Needs to exist before the first tab reports itself as the active editor
+  this->dependencyWatcher = new DependencyWatcher(this);
+
   // Preferences initialization happens on first tab creation, and depends on colorschemes from editor.
   // Any code dependent on Preferences must come after the TabManager instantiation
   tabManager = new TabManager(this, filenames.isEmpty() ? QString() : filenames[0]);
@@ -379,6 +386,8 @@ MainWindow::MainWindow(const QStringList& filenames) : rubberBandManager(this)
 
   this->cgalworker = new CGALWorker();
   connect(this->cgalworker, &CGALWorker::done, this, &MainWindow::actionRenderDone);
+  this->compileWorker = new CompileWorker();
+  connect(this->compileWorker, &CompileWorker::done, this, &MainWindow::compileWorkerDone);
 
   rootNode = nullptr;
 
@@ -392,10 +401,12 @@ MainWindow::MainWindow(const QStringList& filenames) : rubberBandManager(this)
   this->meas.setView(qglview);
   resetMeasurementsState(false, "Render (not preview) to enable measurements");
 
+  // Changes are reported by the dependency watcher, the timer only retries while busy
   autoReloadTimer = new QTimer(this);
-  autoReloadTimer->setSingleShot(false);
-  autoReloadTimer->setInterval(autoReloadPollingPeriodMS);
+  autoReloadTimer->setSingleShot(true);
+  autoReloadTimer->setInterval(autoReloadRetryPeriodMS);
   connect(autoReloadTimer, &QTimer::timeout, this, &MainWindow::checkAutoReload);
+  connect(this->dependencyWatcher, &DependencyWatcher::changed, this, &MainWindow::checkAutoReload);
 
   this->exportFormatMapper = new QSignalMapper(this);
 #if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
@@ -408,7 +419,7 @@ MainWindow::MainWindow(const QStringList& filenames) : rubberBandManager(this)
 
   waitAfterReloadTimer = new QTimer(this);
   waitAfterReloadTimer->setSingleShot(true);
-  waitAfterReloadTimer->setInterval(autoReloadPollingPeriodMS);
+  waitAfterReloadTimer->setInterval(autoReloadRetryPeriodMS);
   connect(waitAfterReloadTimer, &QTimer::timeout, this, &MainWindow::waitAfterReload);
   connect(GlobalPreferences::inst(), &Preferences::ExperimentalChanged, this,
           &MainWindow::changeParameterWidget);
@@ -1329,33 +1340,89 @@ void MainWindow::updateCompileResult()
 void MainWindow::compileDone(bool didchange)
 {
   OpenSCAD::hardwarnings = GlobalPreferences::inst()->getValue("advanced/enableHardwarnings").toBool();
-  try {
-    const char *callslot;
-    if (didchange) {
-      instantiateRoot();
-      updateCompileResult();
-      callslot = afterCompileSlot;
-    } else {
-      callslot = "compileEnded";
-    }
+  if (didchange) {
+    // Continues in compileWorkerDone()
+    instantiateRoot();
+    return;
+  }
+  this->procevents = false;
+  QMetaObject::invokeMethod(this, "compileEnded");
+}
 
-    this->procevents = false;
-    QMetaObject::invokeMethod(this, callslot);
-  } catch (const HardWarningException&) {
+void MainWindow::compileWorkerDone(const std::shared_ptr<const CompileResult>& result)
+{
+#ifdef ENABLE_PYTHON
+  python_lock();
+#endif
+  // Superseded by a newer compile, which will deliver its own result
+  if (result->id != this->compileJobId) return;
+
+  if (this->isPreview) updateStatusBar(nullptr);
+  switch (result->status) {
+  case CompileResult::Status::Done: break;
+  case CompileResult::Status::Cancelled:
+    LOG("Compilation cancelled.");
+    compileEnded();
+    return;
+  case CompileResult::Status::HardWarning:
     exceptionCleanup();
+    return;
+  case CompileResult::Status::Error:
+    UnknownExceptionCleanup(result->error);
+    return;
+  }
+
+  this->absoluteRootNode = result->absoluteRootNode;
+  this->rootNode = result->rootNode;
+  this->tree.setRoot(this->rootNode);
+  this->csgRoot = result->csgRoot;
+  this->normalizedRoot = result->normalizedRoot;
+  this->rootProduct = result->rootProduct;
+  this->highlightsProducts = result->highlightsProducts;
+  this->backgroundProducts = result->backgroundProducts;
+
+  if (result->cameraChanged) {
+    // Only take the $vp* variables, the view may have been resized in the meantime
+    auto& cam = this->qglview->cam;
+    cam.object_trans = result->camera.object_trans;
+    cam.object_rot = result->camera.object_rot;
+    cam.viewer_distance = result->camera.viewer_distance;
+    cam.fov = result->camera.fov;
+    viewportControlWidget->cameraChanged();
+  }
+
+  if (!this->rootNode) {
+    if (parser_error_pos < 0) {
+      LOG(message_group::Error, "Compilation failed! (no top level object found)");
+    } else {
+      LOG(message_group::Error, "Compilation failed!");
+    }
+    LOG(" ");
   }
+
+  updateCompileResult();
+  this->procevents = false;
+  QMetaObject::invokeMethod(this, this->afterCompileSlot);
 }
 
 void MainWindow::compileEnded()
 {
   clearCurrentOutput();
   GuiLocker::unlock();
-  if (designActionAutoReload->isChecked()) autoReloadTimer->start();
+  updateDependencyWatcher();
+  retryRequestedPreview();
 #ifdef ENABLE_GUI_TESTS
   emit compilationDone(this->rootFile);
 #endif
 }
 
+void MainWindow::retryRequestedPreview()
+{
+  // if the preview was requested while the gui was locked, we must request it one more time.
+  // however, it's not possible to call it directly, it must be called from the mainloop
+  if (this->previewRequested) QTimer::singleShot(0, this, &MainWindow::actionRenderPreview);
+}
+
 #ifdef ENABLE_GUI_TESTS
 std::shared_ptr<AbstractNode> MainWindow::instantiateRootFromSource(SourceFile *file)
 {
@@ -1396,144 +1463,39 @@ void MainWindow::instantiateRoot()
 
   renderedEditor = activeEditor;
 
-  if (this->rootFile) {
-    // Evaluate CSG tree
-    LOG("Compiling design (CSG Tree generation)...");
-    this->processEvents();
-
-    AbstractNode::resetIndexCounter();
-
-    EvaluationSession session{doc.parent_path().string()};
-    ContextHandle<BuiltinContext> builtin_context{Context::create<BuiltinContext>(&session)};
-    setRenderVariables(builtin_context);
-
-    std::shared_ptr<const FileContext> file_context;
+  // Evaluation and CSG generation happen in the CompileWorker
+  CompileJob job;
+  job.id = ++this->compileJobId;
+  job.rootFile = this->rootFile;
 #ifdef ENABLE_PYTHON
-    if (python_result_node != NULL && this->python_active) this->absoluteRootNode = python_result_node;
-    else
+  if (python_result_node != NULL && this->python_active) job.absoluteRootNode = python_result_node;
 #endif
-      this->absoluteRootNode = this->rootFile->instantiate(*builtin_context, &file_context);
-    if (file_context) {
-      this->qglview->cam.updateView(file_context, false);
-      viewportControlWidget->cameraChanged();
-    }
-
-    if (this->absoluteRootNode) {
-      // Do we have an explicit root node (! modifier)?
-      const Location *nextLocation = nullptr;
-      if (!(this->rootNode = find_root_tag(this->absoluteRootNode, &nextLocation))) {
-        this->rootNode = this->absoluteRootNode;
-      }
-      if (nextLocation) {
-        LOG(message_group::NONE, *nextLocation, builtin_context->documentRoot(),
-            "More than one Root Modifier (!)");
-      }
-
-      // FIXME: Consider giving away ownership of root_node to the Tree, or use reference counted
-      // pointers
-      this->tree.setRoot(this->rootNode);
-    }
-  }
-
-  if (!this->rootNode) {
-    if (parser_error_pos < 0) {
-      LOG(message_group::Error, "Compilation failed! (no top level object found)");
-    } else {
-      LOG(message_group::Error, "Compilation failed!");
-    }
-    LOG(" ");
-    this->processEvents();
+  job.documentPath = doc.string();
+  job.renderVariables = renderVariables();
+  job.buildCSG = this->isPreview;
+  job.normalizeLimit = 2ul * GlobalPreferences::inst()->getValue("advanced/openCSGLimit").toUInt();
+  if (this->rootFile) LOG("Compiling design (CSG Tree generation)...");
+  if (job.buildCSG) {
+    this->progresswidget = new ProgressWidget(this);
+    connect(this->progresswidget, &ProgressWidget::requestShow, this, &MainWindow::showProgress);
+    job.progress = report_func;
+    job.progressData = this;
   }
+  if (isClosing) return;
+  this->compiledRevision = this->editorRevision;
+  this->compileWorker->start(job);
 }
 
 /*!
-   Generates CSG tree for OpenCSG evaluation.
-   Assumes that the design has been parsed and evaluated (this->root_node is set)
+   Creates the preview renderers for the CSG products.
+   Assumes that the design has been evaluated by the CompileWorker (this->rootNode is set)
  */
 void MainWindow::compileCSG()
 {
   OpenSCAD::hardwarnings = GlobalPreferences::inst()->getValue("advanced/enableHardwarnings").toBool();
   try {
     assert(this->rootNode);
-    LOG("Compiling design (CSG Products generation)...");
-    this->processEvents();
-
-    // Main CSG evaluation
-    this->progresswidget = new ProgressWidget(this);
-    connect(this->progresswidget, &ProgressWidget::requestShow, this, &MainWindow::showProgress);
-
-    GeometryEvaluator geomevaluator(this->tree);
-#ifdef ENABLE_OPENCSG
-    CSGTreeEvaluator csgrenderer(this->tree, &geomevaluator);
-#endif
-
-    if (!isClosing) progress_report_prep(this->rootNode, report_func, this);
-    else return;
-    try {
-#ifdef ENABLE_OPENCSG
-      this->processEvents();
-      this->csgRoot = csgrenderer.buildCSGTree(*rootNode);
-#endif
-      renderStatistic.printCacheStatistic();
-      this->processEvents();
-    } catch (const ProgressCancelException&) {
-      LOG("CSG generation cancelled.");
-    } catch (const HardWarningException&) {
-      LOG("CSG generation cancelled due to hardwarning being enabled.");
-    }
-    progress_report_fin();
-    updateStatusBar(nullptr);
-
-    LOG("Compiling design (CSG Products normalization)...");
-    this->processEvents();
-
-    const size_t normalizelimit =
-      2ul * GlobalPreferences::inst()->getValue("advanced/openCSGLimit").toUInt();
-    CSGTreeNormalizer normalizer(normalizelimit);
-
-    if (this->csgRoot) {
-      this->normalizedRoot = normalizer.normalize(this->csgRoot);
-      if (this->normalizedRoot) {
-        this->rootProduct = std::make_shared<CSGProducts>();
-        this->rootProduct->import(this->normalizedRoot);
-      } else {
-        this->rootProduct.reset();
-        LOG(message_group::Warning, "CSG normalization resulted in an empty tree");
-        this->processEvents();
-      }
-    }
-
-    const std::vector<std::shared_ptr<CSGNode>>& highlight_terms = csgrenderer.getHighlightNodes();
-    if (highlight_terms.size() > 0) {
-      LOG("Compiling highlights (%1$d CSG Trees)...", highlight_terms.size());
-      this->processEvents();
-
-      this->highlightsProducts = std::make_shared<CSGProducts>();
-      for (const auto& highlight_term : highlight_terms) {
-        auto nterm = normalizer.normalize(highlight_term);
-        if (nterm) {
-          this->highlightsProducts->import(nterm);
-        }
-      }
-    } else {
-      this->highlightsProducts.reset();
-    }
-
-    const auto& background_terms = csgrenderer.getBackgroundNodes();
-    if (background_terms.size() > 0) {
-      LOG("Compiling background (%1$d CSG Trees)...", background_terms.size());
-      this->processEvents();
-
-      this->backgroundProducts = std::make_shared<CSGProducts>();
-      for (const auto& background_term : background_terms) {
-        auto nterm = normalizer.normalize(background_term);
-        if (nterm) {
-          this->backgroundProducts->import(nterm);
-        }
-      }
-    } else {
-      this->backgroundProducts.reset();
-    }
+    renderStatistic.printCacheStatistic();
 
     if (this->rootProduct && (this->rootProduct->size() >
                               GlobalPreferences::inst()->getValue("advanced/openCSGLimit").toUInt())) {
@@ -1993,14 +1955,18 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *event)
   return QMainWindow::eventFilter(obj, event);
 }
 
-void MainWindow::setRenderVariables(ContextHandle<BuiltinContext>& context)
+RenderVariables MainWindow::renderVariables()
 {
-  const RenderVariables r = {
+  return {
     .preview = this->isPreview,
     .time = this->animateWidget->getAnimTval(),
     .camera = qglview->cam,
   };
-  r.applyToContext(context);
+}
+
+void MainWindow::setRenderVariables(ContextHandle<BuiltinContext>& context)
+{
+  renderVariables().applyToContext(context);
 }
 
 /*!
@@ -2155,22 +2121,40 @@ void MainWindow::changeParameterWidget() { parameterDock->setVisible(true); }
 
 void MainWindow::checkAutoReload()
 {
-  if (!activeEditor->filepath.isEmpty()) {
-    actionReloadRenderPreview();
-  }
+  if (activeEditor->filepath.isEmpty() || !designActionAutoReload->isChecked()) return;
+  // Don't lose the change if it arrives while compiling
+  if (GuiLocker::isLocked()) autoReloadTimer->start();
+  else actionReloadRenderPreview();
 }
 
 void MainWindow::autoReloadSet(bool on)
 {
   QSettingsCached settings;
   settings.setValue("design/autoReload", designActionAutoReload->isChecked());
+  updateDependencyWatcher();
   if (on) {
-    autoReloadTimer->start(autoReloadPollingPeriodMS);
+    // Pick up anything that changed while auto-reload was off
+    autoReloadTimer->start();
   } else {
     autoReloadTimer->stop();
   }
 }
 
+/*!
+   Watches the file of the active editor and everything it includes or uses,
+   as long as auto-reload is enabled.
+ */
+void MainWindow::updateDependencyWatcher()
+{
+  if (!designActionAutoReload->isChecked() || activeEditor->filepath.isEmpty()) {
+    this->dependencyWatcher->clear();
+    return;
+  }
+  std::set<std::string> files{activeEditor->filepath.toStdString()};
+  if (this->rootFile) this->rootFile->collectDependencies(files);
+  this->dependencyWatcher->setFiles(files);
+}
+
 bool MainWindow::checkEditorModified()
 {
   if (activeEditor->isContentModified()) {
@@ -2229,26 +2213,24 @@ void MainWindow::prepareCompile(const char *afterCompileSlot, bool procevents, b
 
 void MainWindow::actionRenderPreview()
 {
-  static bool preview_requested;
-  preview_requested = true;
+  this->previewRequested = true;
 
-  if (GuiLocker::isLocked()) return;
+  if (GuiLocker::isLocked()) {
+    // A preview of an older revision of the design is of no use anymore, retried in compileEnded()
+    if (this->isPreview && this->compileWorker->isRunning() &&
+        this->compiledRevision != this->editorRevision) {
+      this->compileWorker->cancel();
+    }
+    return;
+  }
 
   GuiLocker::lock();
-  preview_requested = false;
+  this->previewRequested = false;
 
   resetMeasurementsState(false, "Render (not preview) to enable measurements");
 
   prepareCompile("csgRender", !animateDock->isVisible(), true);
   compile(false, false);
-
-  if (preview_requested) {
-    // if the action was called when the gui was locked, we must request it one more time
-    // however, it's not possible to call it directly NOR make the loop
-    // it must be called from the mainloop
-    QTimer::singleShot(0, this, &MainWindow::actionRenderPreview);
-    return;
-  }
 }
 
 void MainWindow::csgRender()
@@ -2704,7 +2686,8 @@ void MainWindow::exceptionCleanup()
   LOG("Execution aborted");
   LOG(" ");
   GuiLocker::unlock();
-  if (designActionAutoReload->isChecked()) autoReloadTimer->start();
+  updateDependencyWatcher();
+  retryRequestedPreview();
 }
 
 void MainWindow::UnknownExceptionCleanup(std::string msg)
@@ -2717,7 +2700,8 @@ void MainWindow::UnknownExceptionCleanup(std::string msg)
   }
   LOG(" ");
   GuiLocker::unlock();
-  if (designActionAutoReload->isChecked()) autoReloadTimer->start();
+  updateDependencyWatcher();
+  retryRequestedPreview();
 }
 
 void MainWindow::showTextInWindow(const QString& type, const QString& content)
@@ -3097,8 +3081,9 @@ bool MainWindow::isEmpty() { return activeEditor->toPlainText().isEmpty(); }
 
 void MainWindow::editorContentChanged()
 {
-  // this slot is called when the content of the active editor changed.
+  // this slot is called when the content of the active editor or its parameters changed.
   // it rely on the activeEditor member to pick the new data.
+  ++this->editorRevision;
 
   auto current_doc = activeEditor->toPlainText();
   if (current_doc != lastCompiledDoc) {
@@ -3450,6 +3435,8 @@ void MainWindow::onTabManagerEditorChanged(EditorInterface *newEditor)
   fontListDock->setNameSuffix(name);
   viewportControlDock->setNameSuffix(name);
 
+  updateDependencyWatcher();
+
   // If there is no renderedEditor we request for a new preview if the
   // auto-reload is enabled.
   if (renderedEditor == nullptr && designActionAutoReload->isChecked()) {
@@ -3631,8 +3618,8 @@ void MainWindow::consoleOutput(const Message& msgObj)
   } else if (msgObj.group == message_group::Error) {
     ++this->compileErrors;
   }
-  // FIXME: scad parsing/evaluation should be done on separate thread so as not to block the gui.
-  // Then processEvents should no longer be needed here.
+  // FIXME: scad parsing should be done on separate thread so as not to block the gui, like the
+  // evaluation in CompileWorker. Then processEvents should no longer be needed here.
   this->processEvents();
   if (consoleUpdater && !consoleUpdater->isActive()) {
     consoleUpdater->start(50);  // Limit console updates to 20 FPS
@@ -34,6 +34,7 @@
 #include <QSignalMapper>
 #include <QShortcut>
 #include "core/Context.h"
+#include "core/RenderVariables.h"
 #include "glview/Renderer.h"
 #include "core/SourceFile.h"
 #ifdef STATIC_QT_SVG_PLUGIN
@@ -43,6 +44,9 @@ Q_IMPORT_PLUGIN(QSvgPlugin)
 
 class BuiltinContext;
 class CGALWorker;
+class CompileWorker;
+class DependencyWatcher;
+struct CompileResult;
 class CSGNode;
 class CSGProducts;
 class FontListDialog;
@@ -83,6 +87,7 @@ public:
   bool isPreview;
 
   QTimer *autoReloadTimer;
+  DependencyWatcher *dependencyWatcher;
   QTimer *waitAfterReloadTimer;
   RenderStatistic renderStatistic;
 
@@ -192,6 +197,7 @@ public:
 private:
   [[nodiscard]] QString getCurrentFileName() const;
 
+  RenderVariables renderVariables();
   void setRenderVariables(ContextHandle<BuiltinContext>& context);
   void updateCompileResult();
   void compile(bool reload, bool forcedone = false);
@@ -252,7 +258,10 @@ private slots:
 
   void instantiateRoot();
   void compileDone(bool didchange);
+  void compileWorkerDone(const std::shared_ptr<const CompileResult>& result);
   void compileEnded();
+  void retryRequestedPreview();
+  void updateDependencyWatcher();
   void changeParameterWidget();
 
 private slots:
@@ -418,6 +427,11 @@ private:
   QTemporaryFile *tempFile{nullptr};
   ProgressWidget *progresswidget{nullptr};
   CGALWorker *cgalworker;
+  CompileWorker *compileWorker;
+  unsigned int compileJobId{0};      // results of older jobs are stale and dropped
+  unsigned int editorRevision{0};    // bumped on every edit of the design or its parameters
+  unsigned int compiledRevision{0};  // editorRevision when the current compile started
+  bool previewRequested{false};      // a preview was requested while the GUI was locked
   QMutex consolemutex;
   EditorInterface *renderedEditor;  // stores pointer to editor which has been most recently rendered
   time_t includesMTime{0};          // latest include mod time
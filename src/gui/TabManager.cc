@@ -170,6 +170,8 @@ void TabManager::createTab(const QString& filename)
   editor = scintillaEditor;
   par->activeEditor = editor;
   editor->parameterWidget = new ParameterWidget(par->parameterDock);
+  connect(editor->parameterWidget, &ParameterWidget::parametersChanged, par,
+          &MainWindow::editorContentChanged);
   connect(editor->parameterWidget, &ParameterWidget::parametersChanged, par,
           &MainWindow::actionRenderPreview);
   par->parameterDock->setWidget(editor->parameterWidget);
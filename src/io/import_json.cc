@@ -25,10 +25,14 @@
  */
 #include "io/import.h"
 
+#include <cstddef>
 #include <exception>
 #include <fstream>
+#include <map>
 #include <string>
 #include <utility>
+#include <variant>
+#include <vector>
 
 #include "json/json.hpp"
 
@@ -41,36 +45,91 @@ using json = nlohmann::json;
 
 namespace {
 
-ObjectType to_obj(const json& j, EvaluationSession *session);
+/*!
+   Builds Values directly from SAX events, so no JSON DOM of the whole file is held in memory
+   next to the result.
 
-Value to_value(const json& j, EvaluationSession *session)
+   Object members are collected in a std::map, which gives them the same order (sorted by key)
+   and the same handling of duplicate keys (last one wins) as the DOM import had.
+ */
+class ValueBuilder : public nlohmann::json_sax<json>
 {
-  if (j.is_string()) {
-    return Value{j.get<std::string>()};
-  } else if (j.is_number()) {
-    return Value{j.get<double>()};
-  } else if (j.is_boolean()) {
-    return Value{j.get<bool>()};
-  } else if (j.is_object()) {
-    return Value{to_obj(j, session)};
-  } else if (j.is_array()) {
-    Value::VectorType vec{session};
-    for (const auto& elem : j) {
-      vec.emplace_back(to_value(elem, session));
-    }
-    return std::move(vec);
+public:
+  explicit ValueBuilder(EvaluationSession *session) : session(session) {}
+
+  bool null() override { return add(Value::undefined.clone()); }
+  bool boolean(bool val) override { return add(Value{val}); }
+  bool number_integer(number_integer_t val) override { return add(Value{static_cast<double>(val)}); }
+  bool number_unsigned(number_unsigned_t val) override { return add(Value{static_cast<double>(val)}); }
+  bool number_float(number_float_t val, const string_t& /*s*/) override { return add(Value{val}); }
+  bool string(string_t& val) override { return add(Value{std::move(val)}); }
+  // Only produced by binary formats
+  bool binary(binary_t& /*val*/) override { return add(Value::undefined.clone()); }
+
+  bool start_object(std::size_t /*elements*/) override
+  {
+    stack.push_back({Members{}, {}});
+    return true;
+  }
+  bool key(string_t& val) override
+  {
+    stack.back().key = std::move(val);
+    return true;
+  }
+  bool end_object() override
+  {
+    ObjectType obj{session};
+    for (auto& [key, value] : std::get<Members>(stack.back().container)) obj.set(key, std::move(value));
+    stack.pop_back();
+    return add(Value{std::move(obj)});
   }
-  return Value::undefined.clone();
-}
 
-ObjectType to_obj(const json& j, EvaluationSession *session)
-{
-  ObjectType obj{session};
-  for (const auto& item : j.items()) {
-    obj.set(item.key(), to_value(item.value(), session));
+  bool start_array(std::size_t /*elements*/) override
+  {
+    stack.push_back({VectorType{session}, {}});
+    return true;
   }
-  return obj;
-}
+  bool end_array() override
+  {
+    auto vec = std::move(std::get<VectorType>(stack.back().container));
+    stack.pop_back();
+    return add(Value{std::move(vec)});
+  }
+
+  bool parse_error(std::size_t /*position*/, const std::string& /*last_token*/,
+                   const nlohmann::detail::exception& ex) override
+  {
+    error = ex.what();
+    return false;
+  }
+
+  Value result = Value::undefined.clone();
+  std::string error;
+
+private:
+  using Members = std::map<std::string, Value>;
+  // An array or object being read, and the key of the next object member
+  struct Container {
+    std::variant<VectorType, Members> container;
+    std::string key;
+  };
+
+  bool add(Value&& value)
+  {
+    if (stack.empty()) {
+      result = std::move(value);
+    } else if (auto *vec = std::get_if<VectorType>(&stack.back().container)) {
+      vec->emplace_back(std::move(value));
+    } else {
+      auto& top = stack.back();
+      std::get<Members>(top.container).insert_or_assign(std::move(top.key), std::move(value));
+    }
+    return true;
+  }
+
+  EvaluationSession *session;
+  std::vector<Container> stack;
+};
 
 }  // namespace
 
@@ -80,9 +139,12 @@ Value import_json(const std::string& filename, EvaluationSession *session, const
 
   try {
     if (i) {
-      json j;
-      i >> j;
-      return Value{to_value(j, session)};
+      ValueBuilder builder(session);
+      // Not strict, like reading into a DOM with operator>>, so trailing content is ignored
+      if (json::sax_parse(i, &builder, json::input_format_t::json, false)) {
+        return std::move(builder.result);
+      }
+      LOG(message_group::Warning, loc, "", "Failed to parse file '%1$s': %s", filename, builder.error);
     } else {
       LOG(message_group::Warning, loc, "", "Could not read file '%1$s'", filename);
     }
@@ -32,12 +32,14 @@
 #include <fcntl.h>
 #endif
 #include <array>
+#include <atomic>
 #include <clocale>
 #include <cstddef>
 #include <cstdlib>
 #include <exception>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <ios>
 #include <iostream>
@@ -76,7 +78,9 @@
 #include <CGAL/assertions_behaviour.h>
 #endif
 
+#include "CacheManager.h"
 #include "core/AST.h"
+#include "core/ASTSnapshot.h"
 #include "core/BuiltinContext.h"
 #include "core/Builtins.h"
 #include "core/Context.h"
@@ -87,6 +91,7 @@
 #include "core/EvaluationSession.h"
 #include "core/node.h"
 #include "core/parsersettings.h"
+#include "core/progress.h"
 #include "core/RenderVariables.h"
 #include "core/ScopeContext.h"
 #include "core/Settings.h"
@@ -95,6 +100,7 @@
 #include "geometry/GeometryEvaluator.h"
 #include "geometry/GeometryUtils.h"
 #include "geometry/PolySet.h"
+#include "geometry/Polygon2d.h"
 #include "glview/Camera.h"
 #include "glview/ColorMap.h"
 #include "glview/OffscreenView.h"
@@ -105,9 +111,12 @@
 #include "openscad_gui.h"
 #include "openscad_mimalloc.h"
 #include "platform/PlatformUtils.h"
+#include "RenderServer.h"
 #include "RenderStatistic.h"
 #include "utils/exceptions.h"
 #include "utils/printutils.h"
+#include "utils/Profiler.h"
+#include "utils/scope_guard.hpp"
 #include "utils/StackCheck.h"
 
 #ifdef ENABLE_PYTHON
@@ -144,6 +153,7 @@ public:
   }
   ~Echostream()
   {
+    set_output_handler(nullptr, nullptr, nullptr);
     if (fstream.is_open()) fstream.close();
   }
 
@@ -158,21 +168,29 @@ struct AnimateArgs {
   unsigned shard = 1;
 };
 
+struct ExportTarget {
+  bool is_stdout;
+  std::string output_file;
+  FileFormat export_format;
+};
+
 struct CommandLine {
   const bool is_stdin;
   const std::string& filename;
-  const bool is_stdout;
-  std::string output_file;
+  std::vector<ExportTarget> targets;
   const fs::path& original_path;
   const std::string& parameterFile;
   const std::string& setName;
   const ViewOptions& viewOptions;
   const Camera& camera;
-  const boost::optional<FileFormat> export_format;
   const CmdLineExportOptions& exportOptions;
   const AnimateArgs animate;
   const std::vector<std::string> summaryOptions;
   const std::string summaryFile;
+  // Source text to use instead of reading stdin (--serve)
+  const std::string *source = nullptr;
+  // Render is aborted once this is set (--serve)
+  const std::atomic<bool> *canceled = nullptr;
 };
 
 namespace {
@@ -193,6 +211,28 @@ bool useGUI()
 }
 #endif  // OPENSCAD_NOGUI
 
+/*!
+   Whether exporters can read geom from several threads at once. Meshes and polygons are plain
+   data, but exporters convert Nef polyhedra and Manifolds, whose lazily evaluated and reference
+   counted internals aren't safe to share between threads.
+ */
+bool isSafeToExportConcurrently(const Geometry& geom)
+{
+  if (const auto *geomlist = dynamic_cast<const GeometryList *>(&geom)) {
+    for (const auto& item : geomlist->getChildren()) {
+      if (item.second && !isSafeToExportConcurrently(*item.second)) return false;
+    }
+    return true;
+  }
+  return dynamic_cast<const PolySet *>(&geom) || dynamic_cast<const Polygon2d *>(&geom);
+}
+
+// Formats whose exporters convert to a Nef polyhedron, shared with other threads through the CGALCache
+bool exportsThroughNef(FileFormat format)
+{
+  return format == FileFormat::AMF || format == FileFormat::NEF3 || format == FileFormat::NEFDBG;
+}
+
 bool checkAndExport(const std::shared_ptr<const Geometry>& root_geom, unsigned dimensions,
                     ExportInfo& exportInfo, const bool is_stdout, const std::string& filename)
 {
@@ -382,10 +422,30 @@ Camera get_camera(const po::variables_map& vm)
   return camera;
 }
 
-int do_export(const CommandLine& cmd, const RenderVariables& render_variables, FileFormat export_format,
-              SourceFile *root_file)
+bool usesPreviewRenderer(const ViewOptions& viewOptions)
+{
+  return viewOptions.renderer == RenderType::OPENCSG ||
+         viewOptions.renderer == RenderType::THROWNTOGETHER;
+}
+
+bool needsGeometry(const CommandLine& cmd, FileFormat export_format)
+{
+  if (export_format == FileFormat::PNG) return !usesPreviewRenderer(cmd.viewOptions);
+  return fileformat::is3D(export_format) || fileformat::is2D(export_format);
+}
+
+// Statistics of all render passes of one command line run, printed once after the last pass
+struct RenderSummary {
+  RenderStatistic statistic;
+  // Geometry and camera of the last pass which rendered any
+  std::shared_ptr<const Geometry> geometry;
+  Camera camera;
+  bool rendered = false;
+};
+
+int do_export(const CommandLine& cmd, const RenderVariables& render_variables,
+              const std::vector<ExportTarget>& targets, SourceFile *root_file, RenderSummary& summary)
 {
-  auto filename_str = fs::path(cmd.output_file).generic_string();
   // Avoid possibility of fs::absolute throwing when passed an empty path
   auto fpath = cmd.filename.empty() ? fs::current_path() : fs::absolute(fs::path(cmd.filename));
   auto fparent = fpath.parent_path();
@@ -394,6 +454,7 @@ int do_export(const CommandLine& cmd, const RenderVariables& render_variables, F
   fs::current_path(fparent);
 
   EvaluationSession session{fparent.string()};
+  session.setCancellationToken(cmd.canceled);
   ContextHandle<BuiltinContext> builtin_context{Context::create<BuiltinContext>(&session)};
   render_variables.applyToContext(builtin_context);
 
@@ -435,148 +496,241 @@ int do_export(const CommandLine& cmd, const RenderVariables& render_variables, F
   }
   Tree tree(root_node, fparent.string());
 
-  if (export_format == FileFormat::CSG) {
-    // https://github.com/openscad/openscad/issues/128
-    // When I use the csg ouptput from the command line the paths in 'import'
-    // statements become relative. But unfortunately they become relative to
-    // the current working dir and neither to the location of the input nor
-    // the output.
-    fs::current_path(fparent);  // Force exported filenames to be relative to document path
-    with_output(cmd.is_stdout, filename_str, [&tree, root_node](std::ostream& stream) {
-      stream << tree.getString(*root_node, "\t") << "\n";
-    });
-    fs::current_path(cmd.original_path);
-  } else if (export_format == FileFormat::AST) {
-    fs::current_path(fparent);  // Force exported filenames to be relative to document path
-    with_output(cmd.is_stdout, filename_str,
-                [root_file](std::ostream& stream) { stream << root_file->dump(""); });
-    fs::current_path(cmd.original_path);
-  } else if (export_format == FileFormat::PARAM) {
-    with_output(cmd.is_stdout, filename_str,
-                [&root_file, &fpath](std::ostream& stream) { export_param(root_file, fpath, stream); });
-  } else if (export_format == FileFormat::TERM) {
-    CSGTreeEvaluator csgRenderer(tree);
-    auto root_raw_term = csgRenderer.buildCSGTree(*root_node);
-    with_output(cmd.is_stdout, filename_str, [root_raw_term](std::ostream& stream) {
-      if (!root_raw_term || root_raw_term->isEmptySet()) {
-        stream << "No top-level CSG object\n";
-      } else {
-        stream << root_raw_term->dump() << "\n";
+  if (cmd.canceled) {
+    if (cmd.canceled->load()) throw ProgressCancelException();
+    progress_report_prep(
+      absolute_root_node,
+      [](const std::shared_ptr<const AbstractNode>&, void *userdata, int) {
+        if (static_cast<const std::atomic<bool> *>(userdata)->load()) throw ProgressCancelException();
+      },
+      const_cast<std::atomic<bool> *>(cmd.canceled));
+  }
+  auto progress_guard = sg::make_scope_guard([&cmd]() {
+    if (cmd.canceled) progress_report_fin();
+  });
+
+  int rc = 0;
+  bool any_render = false;
+  bool any_geometry = false;
+  bool any_preview_png = false;
+  std::shared_ptr<CSGNode> root_raw_term;
+  bool have_raw_term = false;
+
+  // Cheap, tree-based formats are written first; they don't need geometry evaluation.
+  for (const auto& target : targets) {
+    auto filename_str = fs::path(target.output_file).generic_string();
+    if (target.export_format == FileFormat::CSG) {
+      // https://github.com/openscad/openscad/issues/128
+      // When I use the csg ouptput from the command line the paths in 'import'
+      // statements become relative. But unfortunately they become relative to
+      // the current working dir and neither to the location of the input nor
+      // the output.
+      fs::current_path(fparent);  // Force exported filenames to be relative to document path
+      with_output(target.is_stdout, filename_str, [&tree, root_node](std::ostream& stream) {
+        stream << tree.getString(*root_node, "\t") << "\n";
+      });
+      fs::current_path(cmd.original_path);
+    } else if (target.export_format == FileFormat::AST) {
+      fs::current_path(fparent);  // Force exported filenames to be relative to document path
+      with_output(target.is_stdout, filename_str,
+                  [root_file](std::ostream& stream) { stream << root_file->dump(""); });
+      fs::current_path(cmd.original_path);
+    } else if (target.export_format == FileFormat::PARAM) {
+      with_output(target.is_stdout, filename_str, [&root_file, &fpath](std::ostream& stream) {
+        export_param(root_file, fpath, stream);
+      });
+    } else if (target.export_format == FileFormat::TERM) {
+      // The CSG products are shared by all term outputs
+      if (!have_raw_term) {
+        CSGTreeEvaluator csgRenderer(tree);
+        root_raw_term = csgRenderer.buildCSGTree(*root_node);
+        have_raw_term = true;
       }
-    });
-  } else if (export_format == FileFormat::ECHO) {
-    // echo -> don't need to evaluate any geometry
-  } else {
-    // start measuring render time
-    RenderStatistic renderStatistic;
-    GeometryEvaluator geomevaluator(tree);
-    std::unique_ptr<OffscreenView> glview;
-    std::shared_ptr<const Geometry> root_geom;
-    if ((export_format == FileFormat::ECHO || export_format == FileFormat::PNG) &&
-        (cmd.viewOptions.renderer == RenderType::OPENCSG ||
-         cmd.viewOptions.renderer == RenderType::THROWNTOGETHER)) {
-      // OpenCSG or throwntogether png -> just render a preview
-      glview = prepare_preview(tree, cmd.viewOptions, camera);
-      if (!glview) return 1;
+      with_output(target.is_stdout, filename_str, [&root_raw_term](std::ostream& stream) {
+        if (!root_raw_term || root_raw_term->isEmptySet()) {
+          stream << "No top-level CSG object\n";
+        } else {
+          stream << root_raw_term->dump() << "\n";
+        }
+      });
+    } else if (target.export_format == FileFormat::ECHO) {
+      // echo -> don't need to evaluate any geometry
     } else {
-      // Force creation of concrete geometry (mostly for testing)
-      // FIXME: Consider adding MANIFOLD as a valid --render argument and ViewOption, to be able to
-      // distinguish from CGAL
-
-      constexpr bool allownef = true;
-      root_geom = geomevaluator.evaluateGeometry(*tree.root(), allownef);
-      if (!root_geom) root_geom = std::make_shared<PolySet>(3);
-      if (cmd.viewOptions.renderer == RenderType::BACKEND_SPECIFIC && root_geom->getDimension() == 3) {
-        if (auto geomlist = std::dynamic_pointer_cast<const GeometryList>(root_geom)) {
-          auto flatlist = geomlist->flatten();
-          for (auto& child : flatlist) {
-            if (child.second->getDimension() == 3) {
-              child.second = GeometryUtils::getBackendSpecificGeometry(child.second);
-            }
+      any_render = true;
+      any_geometry |= needsGeometry(cmd, target.export_format);
+      any_preview_png |=
+        target.export_format == FileFormat::PNG && !needsGeometry(cmd, target.export_format);
+    }
+  }
+  if (!any_render) return rc;
+
+  // measure render time, adding up all passes
+  auto& renderStatistic = summary.statistic;
+  renderStatistic.resume();
+  auto statistic_guard = sg::make_scope_guard([&renderStatistic]() { renderStatistic.stop(); });
+  summary.rendered = true;
+  summary.camera = camera;
+  GeometryEvaluator geomevaluator(tree);
+  std::unique_ptr<OffscreenView> glview;
+  std::shared_ptr<const Geometry> root_geom;
+  if (any_preview_png) {
+    // OpenCSG or throwntogether png -> just render a preview
+    glview = prepare_preview(tree, cmd.viewOptions, camera);
+    if (!glview) return 1;
+  }
+  if (any_geometry) {
+    // Force creation of concrete geometry (mostly for testing)
+    // FIXME: Consider adding MANIFOLD as a valid --render argument and ViewOption, to be able to
+    // distinguish from CGAL
+
+    constexpr bool allownef = true;
+    root_geom = geomevaluator.evaluateGeometry(*tree.root(), allownef);
+    if (!root_geom) root_geom = std::make_shared<PolySet>(3);
+    if (cmd.viewOptions.renderer == RenderType::BACKEND_SPECIFIC && root_geom->getDimension() == 3) {
+      if (auto geomlist = std::dynamic_pointer_cast<const GeometryList>(root_geom)) {
+        auto flatlist = geomlist->flatten();
+        for (auto& child : flatlist) {
+          if (child.second->getDimension() == 3) {
+            child.second = GeometryUtils::getBackendSpecificGeometry(child.second);
           }
-          root_geom = std::make_shared<GeometryList>(flatlist);
-        } else {
-          root_geom = GeometryUtils::getBackendSpecificGeometry(root_geom);
-          assert(root_geom != nullptr);
         }
-        LOG("Converted to backend-specific geometry");
+        root_geom = std::make_shared<GeometryList>(flatlist);
+      } else {
+        root_geom = GeometryUtils::getBackendSpecificGeometry(root_geom);
+        assert(root_geom != nullptr);
       }
+      LOG("Converted to backend-specific geometry");
     }
-
-    const std::string input_filename = cmd.is_stdin ? "<stdin>" : cmd.filename;
-    const int dim = fileformat::is3D(export_format) ? 3 : fileformat::is2D(export_format) ? 2 : 0;
-    ExportInfo exportInfo = createExportInfo(export_format, fileformat::info(export_format),
-                                             input_filename, &cmd.camera, cmd.exportOptions);
-    if (dim > 0 && !checkAndExport(root_geom, dim, exportInfo, cmd.is_stdout, filename_str)) {
-      return 1;
+    // Populate lazily computed geometry state before exporters share it between threads
+    root_geom->getBoundingBox();
+  }
+
+  const std::string input_filename = cmd.is_stdin ? "<stdin>" : cmd.filename;
+  const bool parallel = getenv("OPENSCAD_NO_PARALLEL") == nullptr &&
+                        (!root_geom || isSafeToExportConcurrently(*root_geom));
+  std::vector<std::future<bool>> pending;
+  std::vector<std::pair<std::string, std::chrono::milliseconds>> export_times(targets.size());
+  std::vector<std::unique_ptr<ExportInfo>> export_infos(targets.size());
+
+  for (size_t i = 0; i < targets.size(); ++i) {
+    const auto& target = targets[i];
+    const int dim = fileformat::is3D(target.export_format)   ? 3
+                    : fileformat::is2D(target.export_format) ? 2
+                                                             : 0;
+    if (dim == 0) continue;
+    export_infos[i] = std::make_unique<ExportInfo>(createExportInfo(
+      target.export_format, fileformat::info(target.export_format), input_filename, &cmd.camera,
+      cmd.exportOptions));
+    auto filename_str = fs::path(target.output_file).generic_string();
+    auto export_task = [&, i, dim, filename_str]() {
+      RenderStatistic exportStatistic;
+      const bool ok =
+        checkAndExport(root_geom, dim, *export_infos[i], targets[i].is_stdout, filename_str);
+      export_times[i] = {filename_str, exportStatistic.ms()};
+      return ok;
+    };
+    // Exporters only read the shared root geometry, so independent files can be written
+    // concurrently if it's a mesh or polygons. Writes to stdout, and exports which convert it,
+    // stay in order on this thread.
+    if (parallel && !target.is_stdout && !exportsThroughNef(target.export_format)) {
+      pending.push_back(std::async(std::launch::async, export_task));
+    } else if (!export_task()) {
+      rc = 1;
     }
-
-    if (export_format == FileFormat::PNG) {
-      bool success = true;
-      bool const wrote = with_output(
-        cmd.is_stdout, filename_str,
-        [&success, &root_geom, &cmd, &camera, &glview](std::ostream& stream) {
-          if (cmd.viewOptions.renderer == RenderType::BACKEND_SPECIFIC ||
-              cmd.viewOptions.renderer == RenderType::GEOMETRY) {
-            success = export_png(root_geom, cmd.viewOptions, camera, stream);
-          } else {
-            success = export_png(*glview, stream);
-          }
-        },
-        std::ios::out | std::ios::binary);
-      if (!success || !wrote) {
-        return 1;
-      }
+  }
+  for (auto& result : pending) {
+    if (!result.get()) rc = 1;
+  }
+
+  for (size_t i = 0; i < targets.size(); ++i) {
+    const auto& target = targets[i];
+    if (target.export_format != FileFormat::PNG) continue;
+    auto filename_str = fs::path(target.output_file).generic_string();
+    RenderStatistic exportStatistic;
+    bool success = true;
+    bool const wrote = with_output(
+      target.is_stdout, filename_str,
+      [&success, &root_geom, &cmd, &camera, &glview](std::ostream& stream) {
+        if (cmd.viewOptions.renderer == RenderType::BACKEND_SPECIFIC ||
+            cmd.viewOptions.renderer == RenderType::GEOMETRY) {
+          success = export_png(root_geom, cmd.viewOptions, camera, stream);
+        } else {
+          success = export_png(*glview, stream);
+        }
+      },
+      std::ios::out | std::ios::binary);
+    export_times[i] = {filename_str, exportStatistic.ms()};
+    if (!success || !wrote) {
+      rc = 1;
     }
+  }
 
-    renderStatistic.printAll(root_geom, camera, cmd.summaryOptions, cmd.summaryFile);
+  for (const auto& [name, ms] : export_times) {
+    if (!name.empty()) renderStatistic.addExportTime(name, ms);
   }
-  return 0;
+  if (root_geom) summary.geometry = root_geom;
+  return rc;
 }
 
-int cmdline(const CommandLine& cmd)
+bool resolveExportTarget(const std::string& filename, const boost::optional<FileFormat>& format,
+                         ExportTarget& target)
 {
-  FileFormat export_format;
+  target.is_stdout = filename == "-";
+  target.output_file = target.is_stdout ? "<stdout>" : filename;
 
   // Determine output file format and assign it to formatName
-  if (cmd.export_format.is_initialized()) {
-    export_format = cmd.export_format.get();
+  if (format.is_initialized()) {
+    target.export_format = format.get();
   } else {
     // else extract format from file extension
-    const auto path = fs::path(cmd.output_file);
+    const auto path = fs::path(target.output_file);
     std::string suffix = path.has_extension() ? path.extension().generic_string().substr(1) : "";
     boost::algorithm::to_lower(suffix);
 
-    if (!fileformat::fromIdentifier(suffix, export_format)) {
+    if (!fileformat::fromIdentifier(suffix, target.export_format)) {
       LOG(
         "Invalid suffix %1$s. Either add a valid suffix or specify one using the --export-format "
         "option.",
         suffix);
-      return 1;
+      return false;
     }
   }
 
   // Do some minimal checking of output directory before rendering (issue #432)
-  auto output_dir = fs::path(cmd.output_file).parent_path();
+  auto output_dir = fs::path(target.output_file).parent_path();
   if (output_dir.empty()) {
     // If output_file_str has no directory prefix, set output directory to current directory.
     output_dir = fs::current_path();
   }
   if (!fs::is_directory(output_dir)) {
     LOG("\n'%1$s' is not a directory for output file %2$s - Skipping\n", output_dir.generic_string(),
-        cmd.output_file);
-    return 1;
+        target.output_file);
+    return false;
   }
+  return true;
+}
 
+/*!
+  Parses the input once and exports it to all targets of \a cmd. Targets which agree on
+  $preview share one instantiation and geometry evaluation.
+ */
+int cmdline(const CommandLine& cmd)
+{
   set_render_color_scheme(arg_colorscheme, true);
 
   std::shared_ptr<Echostream> echostream;
-  if (export_format == FileFormat::ECHO) {
-    echostream.reset(cmd.is_stdout ? new Echostream(std::cout) : new Echostream(cmd.output_file));
+  for (const auto& target : cmd.targets) {
+    if (target.export_format == FileFormat::ECHO) {
+      assert(!echostream && "Only one echo target per command line run");
+      echostream.reset(target.is_stdout ? new Echostream(std::cout)
+                                        : new Echostream(target.output_file));
+    }
   }
 
   std::string text;
-  if (cmd.is_stdin) {
+  if (cmd.source) {
+    text = *cmd.source;
+  } else if (cmd.is_stdin) {
     text = std::string((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
   } else {
     std::ifstream ifs(std::filesystem::u8path(cmd.filename));
@@ -634,18 +788,33 @@ int cmdline(const CommandLine& cmd)
 
   root_file->handleDependencies();
 
-  RenderVariables render_variables = {
-    .preview = fileformat::canPreview(export_format)
-                 ? (cmd.viewOptions.renderer == RenderType::OPENCSG ||
-                    cmd.viewOptions.renderer == RenderType::THROWNTOGETHER)
-                 : false,
-    .camera = cmd.camera,
-  };
-
-  if (cmd.animate.frames == 0) {
-    render_variables.time = 0;
-    return do_export(cmd, render_variables, export_format, root_file);
-  } else {
+  // Group targets by the value of $preview they are evaluated with
+  std::vector<ExportTarget> render_targets;
+  std::vector<ExportTarget> preview_targets;
+  for (const auto& target : cmd.targets) {
+    const bool preview = fileformat::canPreview(target.export_format) &&
+                         usesPreviewRenderer(cmd.viewOptions);
+    (preview ? preview_targets : render_targets).push_back(target);
+  }
+
+  RenderSummary summary;
+  summary.statistic.stop();  // only the render passes count
+  int rc = 0;
+  for (const bool preview : {false, true}) {
+    const auto& targets = preview ? preview_targets : render_targets;
+    if (targets.empty()) continue;
+
+    RenderVariables render_variables = {
+      .preview = preview,
+      .camera = cmd.camera,
+    };
+
+    if (cmd.animate.frames == 0) {
+      render_variables.time = 0;
+      rc |= do_export(cmd, render_variables, targets, root_file, summary);
+      continue;
+    }
+
     // export the requested number of animated frames
     const unsigned start_frame = ((cmd.animate.shard - 1) * cmd.animate.frames) / cmd.animate.num_shards;
     const unsigned limit_frame = (cmd.animate.shard * cmd.animate.frames) / cmd.animate.num_shards;
@@ -655,26 +824,54 @@ int cmdline(const CommandLine& cmd)
       std::ostringstream oss;
       oss << std::setw(5) << std::setfill('0') << frame;
 
-      auto frame_file = fs::path(cmd.output_file);
-      auto extension = frame_file.extension();
-      frame_file.replace_extension();
-      frame_file += oss.str();
-      frame_file.replace_extension(extension);
-      std::string const frame_str = frame_file.generic_string();
+      std::vector<ExportTarget> frame_targets = targets;
+      for (auto& frame_target : frame_targets) {
+        auto frame_file = fs::path(frame_target.output_file);
+        auto extension = frame_file.extension();
+        frame_file.replace_extension();
+        frame_file += oss.str();
+        frame_file.replace_extension(extension);
+        frame_target.output_file = frame_file.generic_string();
+      }
 
       LOG("Exporting %1$s...", cmd.filename);
 
-      CommandLine frame_cmd = cmd;
-      frame_cmd.output_file = frame_str;
-
-      int const r = do_export(frame_cmd, render_variables, export_format, root_file);
-      if (r != 0) {
-        return r;
-      }
+      rc = do_export(cmd, render_variables, frame_targets, root_file, summary);
+      if (rc != 0) break;
     }
+    if (rc != 0) break;
+  }
+
+  if (summary.rendered) {
+    summary.statistic.printAll(summary.geometry, summary.camera, cmd.summaryOptions, cmd.summaryFile);
+  }
+  return rc;
+}
 
-    return 0;
+/*!
+  Resolves the output files and exports them. All outputs share one parse and evaluation,
+  except echo outputs which capture the messages of their own run.
+ */
+template <typename MakeCommandLine>
+int export_outputs(const std::vector<std::string>& output_files,
+                   const boost::optional<FileFormat>& export_format, const MakeCommandLine& make_cmd)
+{
+  int rc = 0;
+  std::vector<ExportTarget> shared_targets;
+  for (const auto& filename : output_files) {
+    ExportTarget target;
+    if (!resolveExportTarget(filename, export_format, target)) {
+      rc |= 1;
+    } else if (target.export_format == FileFormat::ECHO) {
+      rc |= cmdline(make_cmd({target}));
+    } else {
+      shared_targets.push_back(target);
+    }
+  }
+  if (!shared_targets.empty()) {
+    rc |= cmdline(make_cmd(std::move(shared_targets)));
   }
+  return rc;
 }
 
 template <class Seq, typename ToString>
@@ -876,7 +1073,8 @@ int openscad_main(int argc, char **argv)
          "=eye_x,y,z,center_x,y,z")("autocenter", "adjust camera to look at object's center")(
           "viewall", "adjust camera to fit object")(
           "backend", po::value<std::string>(),
-          "3D rendering backend to use: 'CGAL' (old/slow) or 'Manifold' (new/fast) [default]")(
+          "3D rendering backend to use: 'CGAL' (old/slow), 'Corefinement' (CGAL, exact) or "
+          "'Manifold' (new/fast) [default]")(
           "imgsize", po::value<std::string>(), "=width,height of exported png")(
           "render", po::value<std::string>()->implicit_value(""),
           "for full geometry evaluation when exporting png")(
@@ -897,6 +1095,16 @@ int openscad_main(int argc, char **argv)
           "bounding-box | area")(
           "summary-file", po::value<std::string>(),
           "output summary information in JSON format to the given file, using '-' outputs to stdout")(
+          "cache-budget", po::value<unsigned int>(),
+          "=MB -memory budget shared by the geometry caches, default 512")(
+          "ast-cache", po::value<std::string>(),
+          "=dir -store parsed library files in dir and load them from there on later runs")(
+          "profile", po::value<std::string>(),
+          "=file -write per node, module and function timings as Chrome trace JSON, or as folded "
+          "stacks if file ends in .folded")(
+          "serve", po::value<std::string>()->implicit_value(""),
+          "[=socket] run as a render daemon, reading JSON-RPC requests from stdin or the given Unix "
+          "socket")(
           "colorscheme", po::value<std::string>(),
           ("=colorscheme: " +
            str_join(ColorMap::inst()->colorSchemeNames(), " | ",
@@ -984,6 +1192,18 @@ int openscad_main(int argc, char **argv)
     OpenSCAD::hardwarnings = true;
   }
 
+  if (vm.count("profile")) {
+    Profiler::enable();
+  }
+
+  if (vm.count("cache-budget")) {
+    CacheManager::instance()->setBudgetMB(vm["cache-budget"].as<unsigned int>());
+  }
+
+  if (vm.count("ast-cache")) {
+    ASTSnapshot::setDirectory(vm["ast-cache"].as<std::string>());
+  }
+
   if (vm.count("traceDepth")) {
     OpenSCAD::traceDepth = vm["traceDepth"].as<unsigned int>();
   }
@@ -1136,7 +1356,52 @@ int openscad_main(int argc, char **argv)
     if (!inputFiles.size()) help(argv[0], desc, true);
   }
 
-  if (arg_info || cmdlinemode) {
+  const auto export_options = convert_export_options(vm);
+  const auto summary_options =
+    vm.count("summary") ? vm["summary"].as<std::vector<std::string>>() : std::vector<std::string>{};
+  const auto summary_file = vm.count("summary-file") ? vm["summary-file"].as<std::string>() : "";
+
+  if (vm.count("serve")) {
+    const auto socket_path = vm["serve"].as<std::string>();
+    parser_init();
+    localization_init();
+    // Requests are processed one at a time, so per-job -D defines can temporarily extend the
+    // global command line commands.
+    RenderServer server([&](const RenderRequest& request) {
+      const auto saved_commands = commandline_commands;
+      auto restore_commands =
+        sg::make_scope_guard([&saved_commands]() { commandline_commands = saved_commands; });
+      for (const auto& define : request.defines) {
+        commandline_commands += define;
+        commandline_commands += ";\n";
+      }
+      for (const auto& filename : request.outputs) {
+        if (filename == "-") {
+          LOG(message_group::Error, "Exporting to stdout is not supported in --serve mode.");
+          return 1;
+        }
+      }
+      const bool is_source = !request.source.empty();
+      const std::string input_file = is_source ? "<stdin>" : request.file;
+      return export_outputs(request.outputs, export_format, [&](std::vector<ExportTarget> targets) {
+        return CommandLine{is_source,
+                           input_file,
+                           std::move(targets),
+                           original_path,
+                           parameterFile,
+                           parameterSet,
+                           viewOptions,
+                           camera,
+                           export_options,
+                           animate,
+                           {},
+                           "",
+                           is_source ? &request.source : nullptr,
+                           request.canceled.get()};
+      });
+    });
+    rc = socket_path.empty() ? server.serve(std::cin, std::cout) : server.serveSocket(socket_path);
+  } else if (arg_info || cmdlinemode) {
     if (inputFiles.size() > 1) help(argv[0], desc, true);
     try {
       parser_init();
@@ -1144,34 +1409,31 @@ int openscad_main(int argc, char **argv)
       if (arg_info) {
         rc = info();
       } else {
-        for (const auto& filename : output_files) {
-          const bool is_stdin = inputFiles[0] == "-";
-          const std::string input_file = is_stdin ? "<stdin>" : inputFiles[0];
-          const bool is_stdout = filename == "-";
-          const std::string output_file = is_stdout ? "<stdout>" : filename;
-          const auto export_options = convert_export_options(vm);
-          const CommandLine cmd{is_stdin,
-                                input_file,
-                                is_stdout,
-                                output_file,
-                                original_path,
-                                parameterFile,
-                                parameterSet,
-                                viewOptions,
-                                camera,
-                                export_format,
-                                export_options,
-                                animate,
-                                vm.count("summary") ? vm["summary"].as<std::vector<std::string>>()
-                                                    : std::vector<std::string>{},
-                                vm.count("summary-file") ? vm["summary-file"].as<std::string>() : ""};
-          rc |= cmdline(cmd);
-        }
+        const bool is_stdin = inputFiles[0] == "-";
+        const std::string input_file = is_stdin ? "<stdin>" : inputFiles[0];
+        rc = export_outputs(output_files, export_format, [&](std::vector<ExportTarget> targets) {
+          return CommandLine{is_stdin,
+                             input_file,
+                             std::move(targets),
+                             original_path,
+                             parameterFile,
+                             parameterSet,
+                             viewOptions,
+                             camera,
+                             export_options,
+                             animate,
+                             summary_options,
+                             summary_file};
+        });
       }
     } catch (const HardWarningException&) {
       rc = 1;
     }
 
+    if (vm.count("profile") && !Profiler::write(vm["profile"].as<std::string>())) {
+      rc = 1;
+    }
+
     if (deps_output_file) {
       std::string const deps_out(deps_output_file);
       const std::vector<std::string>& geom_out(output_files);
@@ -51,6 +51,7 @@
 #include "FontCache.h"
 #include "geometry/Geometry.h"
 #include "gui/AppleEvents.h"
+#include "gui/CompileWorker.h"
 #include "gui/input/InputDriverManager.h"
 #include "version.h"
 #ifdef ENABLE_HIDAPI
@@ -83,6 +84,7 @@
 
 Q_DECLARE_METATYPE(Message);
 Q_DECLARE_METATYPE(std::shared_ptr<const Geometry>);
+Q_DECLARE_METATYPE(std::shared_ptr<const CompileResult>);
 
 extern std::string arg_colorscheme;
 
@@ -194,6 +196,7 @@ int gui(std::vector<std::string>& inputFiles, const std::filesystem::path& origi
   // Other global settings
   qRegisterMetaType<Message>();
   qRegisterMetaType<std::shared_ptr<const Geometry>>();
+  qRegisterMetaType<std::shared_ptr<const CompileResult>>();
 
   FontCache::registerProgressHandler(dialogInitHandler);
 
@@ -5,6 +5,11 @@
 #include <sys/types.h>
 #include <sys/sysctl.h>
 #include <sys/utsname.h>
+#include <mach/mach.h>
+#include <TargetConditionals.h>
+#if TARGET_OS_IPHONE
+#include <os/proc.h>
+#endif
 #include <boost/lexical_cast.hpp>
 
 #import <Foundation/Foundation.h>
@@ -98,4 +103,22 @@ const std::string PlatformUtils::sysinfo(bool extended)
   return result.str();
 }
 
+uint64_t PlatformUtils::availableMemory()
+{
+#if TARGET_OS_IPHONE
+  // iOS terminates processes at a per-process limit well below the free system memory
+  if (@available(iOS 13.0, *)) {
+    return os_proc_available_memory();
+  }
+#endif
+  vm_statistics64_data_t stats;
+  mach_msg_type_number_t count = HOST_VM_INFO64_COUNT;
+  if (host_statistics64(mach_host_self(), HOST_VM_INFO64, reinterpret_cast<host_info64_t>(&stats),
+                        &count) != KERN_SUCCESS) {
+    return 0;
+  }
+  return static_cast<uint64_t>(stats.free_count + stats.inactive_count + stats.purgeable_count) *
+         vm_page_size;
+}
+
 void PlatformUtils::ensureStdIO(void) {}
@@ -1,4 +1,5 @@
 #include <iterator>
+#include <limits>
 #include <ios>
 #include <mutex>
 #include <string>
@@ -271,4 +272,22 @@ const std::string PlatformUtils::sysinfo(bool extended)
   return result;
 }
 
+uint64_t PlatformUtils::availableMemory()
+{
+  // MemAvailable includes reclaimable page cache, which free pages alone would miss
+  std::ifstream meminfo("/proc/meminfo");
+  std::string key;
+  uint64_t kb;
+  while (meminfo >> key >> kb) {
+    if (key == "MemAvailable:") return kb * 1024;
+    meminfo.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+#ifdef _SC_AVPHYS_PAGES
+  long pages = sysconf(_SC_AVPHYS_PAGES);
+  long pagesize = sysconf(_SC_PAGE_SIZE);
+  if ((pages > 0) && (pagesize > 0)) return static_cast<uint64_t>(pages) * pagesize;
+#endif
+  return 0;
+}
+
 void PlatformUtils::ensureStdIO() {}
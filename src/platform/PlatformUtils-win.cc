@@ -167,6 +167,14 @@ const std::string PlatformUtils::sysinfo(bool extended)
   return result;
 }
 
+uint64_t PlatformUtils::availableMemory()
+{
+  MEMORYSTATUSEX memoryinfo;
+  memoryinfo.dwLength = sizeof(memoryinfo);
+  if (GlobalMemoryStatusEx(&memoryinfo) == 0) return 0;
+  return memoryinfo.ullAvailPhys;
+}
+
 #include <io.h>
 #include <cstdio>
 
@@ -72,6 +72,14 @@ bool createBackupPath();
  */
 const std::string sysinfo(bool extended = true);
 
+/**
+ * Physical memory currently available to the application without
+ * swapping, used to shrink caches under memory pressure.
+ *
+ * @return available memory in bytes, or 0 if unknown.
+ */
+uint64_t availableMemory();
+
 /**
  * Return short text describing the operating system usable as
  * UserAgent string for networking purposes. This is intended
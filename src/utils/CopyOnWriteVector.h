@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/*!
+   A std::vector whose elements are shared between copies and only duplicated when a
+   copy is modified, like Polygon2d's outlines.
+
+   Const access never copies. Any non-const access, including non-const begin() and
+   operator[], first makes the elements unique to this object. References and
+   iterators obtained that way must not be used after the vector has been copied.
+ */
+template <typename T>
+class CopyOnWriteVector
+{
+public:
+  using Vector = std::vector<T>;
+  using value_type = T;
+  using size_type = typename Vector::size_type;
+  using difference_type = typename Vector::difference_type;
+  using reference = T&;
+  using const_reference = const T&;
+  using iterator = typename Vector::iterator;
+  using const_iterator = typename Vector::const_iterator;
+
+  CopyOnWriteVector() = default;
+  CopyOnWriteVector(Vector elements) { *this = std::move(elements); }
+  CopyOnWriteVector(std::initializer_list<T> elements) : CopyOnWriteVector(Vector(elements)) {}
+  CopyOnWriteVector& operator=(Vector elements)
+  {
+    this->elements = elements.empty() ? nullptr : std::make_shared<const Vector>(std::move(elements));
+    return *this;
+  }
+  CopyOnWriteVector& operator=(std::initializer_list<T> elements) { return *this = Vector(elements); }
+
+  [[nodiscard]] const Vector& get() const { return this->elements ? *this->elements : noElements(); }
+  operator const Vector&() const { return get(); }
+  // Returns the elements for modification, copying them first if they're shared
+  Vector& mut()
+  {
+    if (!this->elements) {
+      this->elements = std::make_shared<const Vector>();
+    } else if (this->elements.use_count() != 1) {
+      this->elements = std::make_shared<const Vector>(*this->elements);
+    }
+    // We're the only owner, and the elements were created by us as a non-const object
+    return const_cast<Vector&>(*this->elements);
+  }
+  // True if the elements are shared with another copy, i.e. mut() would copy them
+  [[nodiscard]] bool isShared() const { return this->elements && this->elements.use_count() != 1; }
+  // True if both share the same elements, i.e. neither was modified since one was copied from the other
+  [[nodiscard]] bool sharesWith(const CopyOnWriteVector& other) const
+  {
+    return this->elements && this->elements == other.elements;
+  }
+
+  [[nodiscard]] size_type size() const { return get().size(); }
+  [[nodiscard]] bool empty() const { return get().empty(); }
+  [[nodiscard]] size_type capacity() const { return get().capacity(); }
+  const_reference operator[](size_type i) const { return get()[i]; }
+  const_reference at(size_type i) const { return get().at(i); }
+  const_reference front() const { return get().front(); }
+  const_reference back() const { return get().back(); }
+  const T *data() const { return get().data(); }
+  const_iterator begin() const { return get().begin(); }
+  const_iterator end() const { return get().end(); }
+  const_iterator cbegin() const { return get().cbegin(); }
+  const_iterator cend() const { return get().cend(); }
+
+  reference operator[](size_type i) { return mut()[i]; }
+  reference at(size_type i) { return mut().at(i); }
+  reference front() { return mut().front(); }
+  reference back() { return mut().back(); }
+  T *data() { return mut().data(); }
+  iterator begin() { return mut().begin(); }
+  iterator end() { return mut().end(); }
+
+  void clear() { this->elements.reset(); }
+  void reserve(size_type n) { mut().reserve(n); }
+  void resize(size_type n) { mut().resize(n); }
+  void resize(size_type n, const T& value) { mut().resize(n, value); }
+  void shrink_to_fit() { mut().shrink_to_fit(); }
+  void push_back(const T& value) { mut().push_back(value); }
+  void push_back(T&& value) { mut().push_back(std::move(value)); }
+  template <typename... Args>
+  reference emplace_back(Args&&...args)
+  {
+    return mut().emplace_back(std::forward<Args>(args)...);
+  }
+  void pop_back() { mut().pop_back(); }
+  template <typename... Args>
+  void assign(Args&&...args)
+  {
+    mut().assign(std::forward<Args>(args)...);
+  }
+  template <typename... Args>
+  iterator insert(Args&&...args)
+  {
+    return mut().insert(std::forward<Args>(args)...);
+  }
+  template <typename... Args>
+  iterator erase(Args&&...args)
+  {
+    return mut().erase(std::forward<Args>(args)...);
+  }
+  void swap(CopyOnWriteVector& other) noexcept { this->elements.swap(other.elements); }
+
+  friend bool operator==(const CopyOnWriteVector& a, const CopyOnWriteVector& b)
+  {
+    return a.elements == b.elements || a.get() == b.get();
+  }
+  friend bool operator!=(const CopyOnWriteVector& a, const CopyOnWriteVector& b) { return !(a == b); }
+
+private:
+  static const Vector& noElements()
+  {
+    static const Vector empty;
+    return empty;
+  }
+
+  std::shared_ptr<const Vector> elements;
+};
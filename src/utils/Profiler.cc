@@ -0,0 +1,149 @@
+#include "utils/Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "json/json.hpp"
+
+#include "core/AST.h"
+#include "utils/printutils.h"
+
+bool Profiler::is_enabled = false;
+
+namespace {
+
+std::mutex events_mutex;
+std::vector<ProfileEvent> events;
+
+int64_t wall_us()
+{
+  static const auto epoch = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                               epoch)
+    .count();
+}
+
+int64_t cpu_us() { return static_cast<int64_t>(std::clock()) * 1000000 / CLOCKS_PER_SEC; }
+
+int thread_id()
+{
+  static std::atomic<int> next_id{1};
+  thread_local const int id = next_id++;
+  return id;
+}
+
+std::string location_string(const Location& loc)
+{
+  if (loc.isNone()) return "";
+  return loc.fileName() + ":" + std::to_string(loc.firstLine());
+}
+
+void write_chrome_trace(std::ostream& stream)
+{
+  nlohmann::json trace_events = nlohmann::json::array();
+  for (const auto& event : events) {
+    nlohmann::json args;
+    const auto loc = location_string(event.location);
+    if (!loc.empty()) args["location"] = loc;
+    args["cpu_us"] = event.cpu_us;
+    if (event.cache_hit >= 0) args["cache"] = event.cache_hit ? "hit" : "miss";
+    if (event.facets >= 0) args["facets"] = event.facets;
+    trace_events.push_back({{"name", event.name},
+                            {"cat", event.category},
+                            {"ph", "X"},
+                            {"ts", event.start_us},
+                            {"dur", event.duration_us},
+                            {"pid", 1},
+                            {"tid", event.thread_id},
+                            {"args", args}});
+  }
+  nlohmann::json json;
+  json["traceEvents"] = trace_events;
+  json["displayTimeUnit"] = "ms";
+  stream << json;
+}
+
+// Rebuilds the call nesting of each thread from the event intervals and emits self time per stack.
+void write_folded_stacks(std::ostream& stream)
+{
+  auto sorted = events;
+  std::sort(sorted.begin(), sorted.end(), [](const ProfileEvent& a, const ProfileEvent& b) {
+    if (a.thread_id != b.thread_id) return a.thread_id < b.thread_id;
+    return a.start_us < b.start_us || (a.start_us == b.start_us && a.duration_us > b.duration_us);
+  });
+
+  struct Frame {
+    std::string path;
+    int64_t end_us;
+    int64_t self_us;
+  };
+  std::map<std::string, int64_t> folded;
+  std::vector<Frame> stack;
+  const auto pop = [&]() {
+    folded[stack.back().path] += std::max<int64_t>(0, stack.back().self_us);
+    stack.pop_back();
+  };
+  int thread = 0;
+  for (const auto& event : sorted) {
+    if (event.thread_id != thread) {
+      while (!stack.empty()) pop();
+      thread = event.thread_id;
+    }
+    while (!stack.empty() && stack.back().end_us <= event.start_us) pop();
+    auto frame_name = event.name;
+    const auto loc = location_string(event.location);
+    if (!loc.empty()) frame_name += " (" + loc + ")";
+    std::replace(frame_name.begin(), frame_name.end(), ';', ',');
+    if (!stack.empty()) stack.back().self_us -= event.duration_us;
+    stack.push_back({stack.empty() ? frame_name : stack.back().path + ";" + frame_name,
+                     event.start_us + event.duration_us, event.duration_us});
+  }
+  while (!stack.empty()) pop();
+
+  for (const auto& [path, us] : folded) {
+    stream << path << " " << us << "\n";
+  }
+}
+
+}  // namespace
+
+ProfileEvent Profiler::begin(const char *category, const std::string& name, const Location& loc)
+{
+  return {category, name, loc, wall_us(), 0, cpu_us(), 0, thread_id()};
+}
+
+void Profiler::end(ProfileEvent& event)
+{
+  event.duration_us = wall_us() - event.start_us;
+  event.cpu_us = cpu_us() - event.cpu_start_us;
+  const std::lock_guard<std::mutex> lock(events_mutex);
+  events.push_back(std::move(event));
+}
+
+bool Profiler::write(const std::string& filename)
+{
+  const std::lock_guard<std::mutex> lock(events_mutex);
+  std::ofstream stream(std::filesystem::u8path(filename));
+  if (!stream.is_open()) {
+    LOG(message_group::Error, "Can't open profile output file '%1$s'", filename);
+    return false;
+  }
+  if (boost::algorithm::ends_with(filename, ".folded")) {
+    write_folded_stacks(stream);
+  } else {
+    write_chrome_trace(stream);
+  }
+  return true;
+}
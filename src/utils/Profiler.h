@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "core/AST.h"
+
+/*!
+   A single timed region recorded by the Profiler.
+ */
+struct ProfileEvent {
+  const char *category;
+  std::string name;
+  Location location;
+  int64_t start_us;
+  int64_t duration_us{0};
+  int64_t cpu_start_us;
+  int64_t cpu_us{0};
+  // Small id of the recording thread, numbered from 1 in the order threads first record an event
+  int thread_id;
+  // Geometry evaluation only: 1 for a cache hit, 0 for a miss, -1 if not applicable
+  int cache_hit{-1};
+  // Geometry evaluation only: number of facets in the result, -1 if not applicable
+  int64_t facets{-1};
+};
+
+/*!
+   Collects per node / per module / per function timings for --profile.
+
+   Recording is global and disabled by default; all instrumentation is guarded by
+   Profiler::enabled(), so the cost when profiling is off is a single branch.
+   The result is written either in Chrome trace event format (load in
+   chrome://tracing or https://ui.perfetto.dev) or, for files ending in
+   ".folded", as folded stacks suitable for flamegraph.pl.
+ */
+class Profiler
+{
+public:
+  static bool enabled() { return is_enabled; }
+  static void enable() { is_enabled = true; }
+
+  static ProfileEvent begin(const char *category, const std::string& name, const Location& loc);
+  static void end(ProfileEvent& event);
+
+  static bool write(const std::string& filename);
+
+  /*!
+     Records the lifetime of the scope as one event if profiling is enabled.
+   */
+  class Scope
+  {
+  public:
+    Scope(const char *category, const std::string& name, const Location& loc)
+    {
+      if (is_enabled) event.emplace(Profiler::begin(category, name, loc));
+    }
+    ~Scope()
+    {
+      if (event) Profiler::end(*event);
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    std::optional<ProfileEvent> event;
+  };
+
+private:
+  static bool is_enabled;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdlib>
 #include "platform/PlatformUtils.h"
 
@@ -8,17 +9,31 @@
 #pragma warning(disable : 26486)  // Disable warning for dangling pointers
 #endif                            // defined(_MSC_VER)
 
+/*!
+   Watches the native stack of evaluation, one instance per thread.
+ */
 class StackCheck
 {
 public:
   static StackCheck& inst()
   {
-    static StackCheck instance;
+    thread_local StackCheck instance;
     return instance;
   }
 
   inline bool check() { return size() >= limit; }
 
+  /*!
+     Measures the stack from the caller on, for threads other than the main one, which
+     evaluate on a stack of stack_size bytes.
+   */
+  void reset(size_t stack_size)
+  {
+    unsigned char c;
+    ptr = &c;  // NOLINT(*StackAddressEscape)
+    limit = stack_size > 2 * STACK_BUFFER_SIZE ? stack_size - STACK_BUFFER_SIZE : stack_size / 2;
+  }
+
 private:
   StackCheck() : limit(PlatformUtils::stackLimit())
   {
@@ -8,6 +8,7 @@
 #include "geometry/linalg.h"
 
 namespace std {
+std::size_t hash<Vector2d>::operator()(const Vector2d& s) const { return Eigen::hash_value(s); }
 std::size_t hash<Vector3f>::operator()(const Vector3f& s) const { return Eigen::hash_value(s); }
 std::size_t hash<Vector3d>::operator()(const Vector3d& s) const { return Eigen::hash_value(s); }
 std::size_t hash<Vector3l>::operator()(const Vector3l& s) const { return Eigen::hash_value(s); }
@@ -15,6 +16,13 @@ std::size_t hash<Vector3l>::operator()(const Vector3l& s) const { return Eigen::
 
 namespace Eigen {
 
+size_t hash_value(Vector2d const& v)
+{
+  size_t seed = 0;
+  for (int i = 0; i < 2; ++i) boost::hash_combine(seed, v[i]);
+  return seed;
+}
+
 size_t hash_value(Vector3f const& v)
 {
   size_t seed = 0;
@@ -11,6 +11,10 @@ using Vector3l = Eigen::Matrix<int64_t, 3, 1>;
 
 namespace std {
 template <>
+struct hash<Vector2d> {
+  std::size_t operator()(const Vector2d& s) const;
+};
+template <>
 struct hash<Vector3f> {
   std::size_t operator()(const Vector3f& s) const;
 };
@@ -25,6 +29,7 @@ struct hash<Vector3l> {
 }  // namespace std
 
 namespace Eigen {
+size_t hash_value(Vector2d const& v);
 size_t hash_value(Vector3f const& v);
 size_t hash_value(Vector3d const& v);
 size_t hash_value(Vector3l const& v);
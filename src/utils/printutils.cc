@@ -6,6 +6,7 @@
 #include <filesystem>
 #include <iostream>
 #include <list>
+#include <mutex>
 #include <set>
 #include <string>
 
@@ -39,6 +40,9 @@ boost::circular_buffer<struct Message> lastlogmessages(5);
 bool no_throw;
 bool deferred;
 
+// Exporters may run concurrently (e.g. multiple -o outputs), so serialize message output.
+std::recursive_mutex print_mutex;
+
 }  // namespace
 
 void set_output_handler(OutputHandlerFunc *newhandler, OutputHandlerFunc2 *newhandler2, void *userdata)
@@ -80,6 +84,7 @@ void PRINT(const Message& msgObj)
 {
   if (msgObj.msg.empty() && msgObj.group != message_group::Echo) return;
 
+  const std::lock_guard<std::recursive_mutex> lock(print_mutex);
   if (print_messages_stack.size() > 0) {
     if (!print_messages_stack.back().empty()) {
       print_messages_stack.back() += "\n";
@@ -100,6 +105,7 @@ void PRINT_NOCACHE(const Message& msgObj)
 {
   if (msgObj.msg.empty() && msgObj.group != message_group::Echo) return;
 
+  const std::lock_guard<std::recursive_mutex> lock(print_mutex);
   const auto msg = msgObj.str();
 
   if (msgObj.group == message_group::Warning || msgObj.group == message_group::Error ||
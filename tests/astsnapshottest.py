@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+
+# AST snapshot checker
+#
+# Runs the input with and without --ast-cache and compares the echo output and the
+# dependencies written with -d. The input and the files next to it whose names start
+# like it are copied to a temporary directory first, since --change edits one of them
+# to check that snapshots of libraries including it aren't used anymore afterwards.
+#
+# Usage: <script> <inputfile> --openscad=<executable-path> --change=<file>,<old>,<new> [<openscad args>] tmpfilebasename
+
+import sys, subprocess, os, argparse, shutil
+
+def failquit(*args):
+    print(*args, file=sys.stderr)
+    sys.exit(1)
+
+parser = argparse.ArgumentParser()
+parser.add_argument("--openscad", required=True, help="Specify OpenSCAD executable.")
+parser.add_argument("--change", required=True, help="<file>,<old>,<new>: text to replace in a library file.")
+args, remaining_args = parser.parse_known_args()
+inputfile = remaining_args[0]
+outputfile = remaining_args[-1]
+remaining_args = remaining_args[1:-1]  # Passed on to the OpenSCAD executable
+
+if not os.path.exists(inputfile):
+    failquit("cant find input file named: " + inputfile)
+if not os.path.exists(args.openscad):
+    failquit("cant find openscad executable named: " + args.openscad)
+
+change = args.change.split(",")
+if len(change) != 3:
+    failquit("--change needs a file, the text to replace and its replacement: " + args.change)
+
+inputdir, inputname = os.path.split(inputfile)
+workdir = outputfile + ".dir"
+shutil.rmtree(workdir, ignore_errors=True)
+os.makedirs(workdir)
+prefix = os.path.splitext(inputname)[0]
+for f in os.listdir(inputdir):
+    if f.startswith(prefix) and f.endswith(".scad"):
+        shutil.copy(os.path.join(inputdir, f), workdir)
+mainfile = os.path.join(workdir, inputname)
+snapshotdir = os.path.join(workdir, "snapshots")
+
+def run(name, snapshots):
+    echofile = os.path.join(workdir, name + ".echo")
+    depfile = os.path.join(workdir, name + ".d")
+    cmd = [args.openscad, mainfile, "-o", echofile, "-d", depfile] + remaining_args
+    if snapshots:
+        cmd.append("--ast-cache=" + snapshotdir)
+    print("Running OpenSCAD:", file=sys.stderr)
+    print(" ".join(cmd), file=sys.stderr)
+    sys.stderr.flush()
+    subprocess.check_call(cmd)
+    with open(echofile, encoding="utf-8") as f:
+        echo = f.read()
+    with open(depfile, encoding="utf-8") as f:
+        # Drop the target, which is the echo file
+        deps = [d.strip() for d in f.read().split(":", 1)[1].split("\\\n") if d.strip()]
+    return echo, deps
+
+def snapshot_count():
+    if not os.path.isdir(snapshotdir):
+        return 0
+    return len([f for f in os.listdir(snapshotdir) if f.endswith(".ast")])
+
+def compare(label, result, expected):
+    if result == expected:
+        return label + ": same echo output and dependencies\n"
+    echo, deps = result
+    return label + ": different %s\n" % ("echo output" if echo != expected[0] else "dependencies")
+
+lines = []
+parsed = run("parsed", False)
+lines.append(compare("writing snapshots", run("cold", True), parsed))
+lines.append("snapshots written: %d\n" % snapshot_count())
+lines.append(compare("reading snapshots", run("warm", True), parsed))
+
+changedfile = os.path.join(workdir, change[0])
+with open(changedfile, encoding="utf-8") as f:
+    text = f.read()
+if change[1] not in text:
+    failquit("can't find '%s' in %s" % (change[1], change[0]))
+with open(changedfile, "w", encoding="utf-8") as f:
+    f.write(text.replace(change[1], change[2]))
+
+changed = run("changed-parsed", False)
+if changed[0] == parsed[0]:
+    failquit("changing %s doesn't change the echo output" % change[0])
+lines.append(compare("changed " + change[0] + ", rewriting snapshots", run("changed-cold", True), changed))
+lines.append(compare("changed " + change[0] + ", reading snapshots", run("changed-warm", True), changed))
+
+shutil.rmtree(workdir)
+with open(outputfile, "w") as f:
+    f.writelines(lines)
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+
+# Cache key checker
+#
+# Renders the input twice with two values of one variable and compares the number of
+# geometry cache entries. Models vary a property that must not change the cache keys,
+# e.g. the number of identical subtrees or the nesting depth of plain groups.
+#
+# Usage: <script> <inputfile> --openscad=<executable-path> --vary=<name>=<a>,<b> [<openscad args>] tmpfilebasename
+
+import sys, subprocess, os, argparse, json
+
+def failquit(*args):
+    print(*args, file=sys.stderr)
+    sys.exit(1)
+
+parser = argparse.ArgumentParser()
+parser.add_argument("--openscad", required=True, help="Specify OpenSCAD executable.")
+parser.add_argument("--vary", required=True, help="<name>=<a>,<b>: variable to render the input with.")
+args, remaining_args = parser.parse_known_args()
+inputfile = remaining_args[0]
+outputfile = remaining_args[-1]
+remaining_args = remaining_args[1:-1]  # Passed on to the OpenSCAD executable
+
+if not os.path.exists(inputfile):
+    failquit("cant find input file named: " + inputfile)
+if not os.path.exists(args.openscad):
+    failquit("cant find openscad executable named: " + args.openscad)
+
+name, values = args.vary.split("=", 1)
+values = values.split(",")
+if len(values) != 2:
+    failquit("--vary needs exactly two values: " + args.vary)
+
+def cache_entries(value):
+    stlfile = outputfile + "." + value + ".stl"
+    summaryfile = outputfile + "." + value + ".json"
+    render_cmd = [args.openscad, inputfile, "-o", stlfile, "--render", "-D", name + "=" + value,
+                  "--summary", "cache", "--summary-file", summaryfile] + remaining_args
+    print("Running OpenSCAD:", file=sys.stderr)
+    print(" ".join(render_cmd), file=sys.stderr)
+    sys.stderr.flush()
+    subprocess.check_call(render_cmd)
+    with open(summaryfile) as f:
+        cache = json.load(f)["cache"]
+    os.unlink(stlfile)
+    os.unlink(summaryfile)
+    for c in cache.values():
+        if c.get("evictions", 0) != 0:
+            failquit("cache evictions make the entry count meaningless: " + json.dumps(cache))
+    return sum(c["entries"] for c in cache.values() if "entries" in c)
+
+counts = [cache_entries(v) for v in values]
+with open(outputfile, "w") as f:
+    label = "%s=%s and %s=%s" % (name, values[0], name, values[1])
+    if counts[0] == counts[1]:
+        f.write(label + ": same number of cache entries\n")
+    else:
+        f.write(label + ": %d and %d cache entries\n" % tuple(counts))
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+
+# Geometry equivalence checker
+#
+# Renders a 2D input twice with two values of one variable and compares the geometry
+# summaries (number of contours and bounding box). Models use the variable to build the
+# same geometry in two ways, e.g. through different code paths of an operation.
+#
+# Usage: <script> <inputfile> --openscad=<executable-path> --vary=<name>=<a>,<b> [<openscad args>] tmpfilebasename
+
+import sys, subprocess, os, argparse, json
+
+def failquit(*args):
+    print(*args, file=sys.stderr)
+    sys.exit(1)
+
+parser = argparse.ArgumentParser()
+parser.add_argument("--openscad", required=True, help="Specify OpenSCAD executable.")
+parser.add_argument("--vary", required=True, help="<name>=<a>,<b>: variable to render the input with.")
+args, remaining_args = parser.parse_known_args()
+inputfile = remaining_args[0]
+outputfile = remaining_args[-1]
+remaining_args = remaining_args[1:-1]  # Passed on to the OpenSCAD executable
+
+if not os.path.exists(inputfile):
+    failquit("cant find input file named: " + inputfile)
+if not os.path.exists(args.openscad):
+    failquit("cant find openscad executable named: " + args.openscad)
+
+name, values = args.vary.split("=", 1)
+values = values.split(",")
+if len(values) != 2:
+    failquit("--vary needs exactly two values: " + args.vary)
+
+def geometry_summary(value):
+    exportfile = outputfile + "." + value + ".svg"
+    summaryfile = outputfile + "." + value + ".json"
+    render_cmd = [args.openscad, inputfile, "-o", exportfile, "--render", "-D", name + "=" + value,
+                  "--summary", "geometry", "--summary", "bounding-box",
+                  "--summary-file", summaryfile] + remaining_args
+    print("Running OpenSCAD:", file=sys.stderr)
+    print(" ".join(render_cmd), file=sys.stderr)
+    sys.stderr.flush()
+    subprocess.check_call(render_cmd)
+    with open(summaryfile) as f:
+        geometry = json.load(f)["geometry"]
+    os.unlink(exportfile)
+    os.unlink(summaryfile)
+    return geometry
+
+summaries = [geometry_summary(v) for v in values]
+with open(outputfile, "w") as f:
+    label = "%s=%s and %s=%s" % (name, values[0], name, values[1])
+    if summaries[0] == summaries[1]:
+        f.write("%s: same geometry, %d contours\n" % (label, summaries[0]["contours"]))
+    else:
+        f.write(label + ": different geometry\n")
+        for v, s in zip(values, summaries):
+            f.write("%s=%s: %s\n" % (name, v, json.dumps(s, sort_keys=True)))